@@ -33,6 +33,9 @@
   #include <arpa/inet.h>       // For inet_addr()
   #include <unistd.h>          // For close()
   #include <netinet/in.h>      // For sockaddr_in
+  #include <netinet/tcp.h>     // For TCP_NODELAY
+  #include <sys/un.h>          // For sockaddr_un
+  #include <fcntl.h>           // For fcntl()
   typedef void raw_type;       // Type used for raw data on this platform
 #endif
 
@@ -100,6 +103,13 @@ Socket::Socket(int type, int protocol) throw(SocketException) {
   }
 }
 
+Socket::Socket(int domain, int type, int protocol) throw(SocketException) {
+  // Make a new socket of the given domain (e.g. PF_UNIX)
+  if ((sockDesc = socket(domain, type, protocol)) < 0) {
+    throw SocketException("Socket creation failed (socket())", true);
+  }
+}
+
 Socket::Socket(int sockDesc) {
   this->sockDesc = sockDesc;
 }
@@ -165,6 +175,23 @@ void Socket::cleanUp() throw(SocketException) {
   #endif
 }
 
+int Socket::getDescriptor() const {
+  return sockDesc;
+}
+
+#ifndef WIN32
+void Socket::setBlocking(bool blocking) throw(SocketException) {
+  int flags = fcntl(sockDesc, F_GETFL, 0);
+  if (flags < 0) {
+    throw SocketException("Get of socket flags failed (fcntl())", true);
+  }
+  flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+  if (fcntl(sockDesc, F_SETFL, flags) < 0) {
+    throw SocketException("Set of O_NONBLOCK failed (fcntl())", true);
+  }
+}
+#endif
+
 unsigned short Socket::resolveService(const string &service,
                                       const string &protocol) {
   struct servent *serv;        /* Structure containing service information */
@@ -181,6 +208,10 @@ CommunicatingSocket::CommunicatingSocket(int type, int protocol)
     throw(SocketException) : Socket(type, protocol) {
 }
 
+CommunicatingSocket::CommunicatingSocket(int domain, int type, int protocol)
+    throw(SocketException) : Socket(domain, type, protocol) {
+}
+
 CommunicatingSocket::CommunicatingSocket(int newConnSD) : Socket(newConnSD) {
 }
 
@@ -203,6 +234,59 @@ void CommunicatingSocket::send(const void *buffer, int bufferLen)
   }
 }
 
+#ifndef WIN32
+int CommunicatingSocket::trySend(const void *buffer, int bufferLen)
+    throw(SocketException) {
+  for (;;) {
+    ssize_t rtn = ::send(sockDesc, (raw_type *) buffer, bufferLen, 0);
+    if (rtn >= 0) return (int) rtn;
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+    throw SocketException("Send failed (send())", true);
+  }
+}
+
+int CommunicatingSocket::tryRecv(void *buffer, int bufferLen)
+    throw(SocketException) {
+  for (;;) {
+    ssize_t rtn = ::recv(sockDesc, (raw_type *) buffer, bufferLen, 0);
+    if (rtn >= 0) return (int) rtn;
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return -1;
+    throw SocketException("Receive failed (recv())", true);
+  }
+}
+
+void CommunicatingSocket::startConnect(const string &foreignAddress,
+    unsigned short foreignPort) throw(SocketException) {
+  sockaddr_in destAddr;
+  fillAddr(foreignAddress, foreignPort, destAddr);
+  startConnect((sockaddr *) &destAddr, sizeof(destAddr));
+}
+
+void CommunicatingSocket::startConnect(const struct sockaddr *addr,
+    int addrLen) throw(SocketException) {
+  setBlocking(false);
+  // EINPROGRESS: goes on in the background (also after EINTR)
+  if (::connect(sockDesc, addr, addrLen) < 0 && errno != EINPROGRESS
+      && errno != EINTR) {
+    throw SocketException("Connect failed (connect())", true);
+  }
+}
+
+void CommunicatingSocket::finishConnect() throw(SocketException) {
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(sockDesc, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+    throw SocketException("Connect failed (getsockopt())", true);
+  }
+  if (error != 0) {
+    errno = error;
+    throw SocketException("Connect failed (connect())", true);
+  }
+}
+#endif
+
 int CommunicatingSocket::recv(void *buffer, int bufferLen)
     throw(SocketException) {
   int rtn;
@@ -249,10 +333,19 @@ TCPSocket::TCPSocket(const string &foreignAddress, unsigned short foreignPort)
 TCPSocket::TCPSocket(int newConnSD) : CommunicatingSocket(newConnSD) {
 }
 
+void TCPSocket::setNoDelay(bool noDelay) throw(SocketException) {
+  int flag = noDelay ? 1 : 0;
+  if (setsockopt(sockDesc, IPPROTO_TCP, TCP_NODELAY, (raw_type *) &flag,
+                 sizeof(flag)) < 0) {
+    throw SocketException("Set of TCP_NODELAY failed (setsockopt())", true);
+  }
+}
+
 // TCPServerSocket Code
 
 TCPServerSocket::TCPServerSocket(unsigned short localPort, int queueLen)
     throw(SocketException) : Socket(SOCK_STREAM, IPPROTO_TCP) {
+  setReuseAddress();
   setLocalPort(localPort);
   setListen(queueLen);
 }
@@ -260,10 +353,20 @@ TCPServerSocket::TCPServerSocket(unsigned short localPort, int queueLen)
 TCPServerSocket::TCPServerSocket(const string &localAddress,
     unsigned short localPort, int queueLen)
     throw(SocketException) : Socket(SOCK_STREAM, IPPROTO_TCP) {
+  setReuseAddress();
   setLocalAddressAndPort(localAddress, localPort);
   setListen(queueLen);
 }
 
+// A restarted server can bind while old connections are in TIME_WAIT
+void TCPServerSocket::setReuseAddress() throw(SocketException) {
+  int flag = 1;
+  if (setsockopt(sockDesc, SOL_SOCKET, SO_REUSEADDR, (raw_type *) &flag,
+                 sizeof(flag)) < 0) {
+    throw SocketException("Set of SO_REUSEADDR failed (setsockopt())", true);
+  }
+}
+
 TCPSocket *TCPServerSocket::accept() throw(SocketException) {
   int newConnSD;
   if ((newConnSD = ::accept(sockDesc, NULL, 0)) < 0) {
@@ -381,3 +484,41 @@ void UDPSocket::leaveGroup(const string &multicastGroup) throw(SocketException)
     throw SocketException("Multicast group leave failed (setsockopt())", true);
   }
 }
+
+#ifndef WIN32
+// UnixSocket Code
+
+UnixSocket::UnixSocket() throw(SocketException) :
+    CommunicatingSocket(PF_UNIX, SOCK_SEQPACKET, 0) {
+}
+
+UnixSocket::UnixSocket(const string &path) throw(SocketException) :
+    CommunicatingSocket(PF_UNIX, SOCK_SEQPACKET, 0) {
+  connect(path);
+}
+
+static void fillUnixAddr(const string &path, sockaddr_un &addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw SocketException("Connect failed: socket path too long");
+  }
+  strcpy(addr.sun_path, path.c_str());
+}
+
+void UnixSocket::connect(const string &path) throw(SocketException) {
+  sockaddr_un destAddr;
+  fillUnixAddr(path, destAddr);
+
+  // Try to connect to the given path
+  if (::connect(sockDesc, (sockaddr *) &destAddr, sizeof(destAddr)) < 0) {
+    throw SocketException("Connect failed (connect())", true);
+  }
+}
+
+void UnixSocket::startConnect(const string &path) throw(SocketException) {
+  sockaddr_un destAddr;
+  fillUnixAddr(path, destAddr);
+  CommunicatingSocket::startConnect((sockaddr *) &destAddr, sizeof(destAddr));
+}
+#endif
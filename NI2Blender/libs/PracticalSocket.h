@@ -111,6 +111,21 @@ public:
    */
   static void cleanUp() throw(SocketException);
 
+  /**
+   *   Get the descriptor, e.g. to watch it with select() or epoll
+   *   @return socket descriptor
+   */
+  int getDescriptor() const;
+
+#ifndef WIN32
+  /**
+   *   Switch the socket between blocking and non-blocking mode (O_NONBLOCK)
+   *   @param blocking false for non-blocking mode
+   *   @exception SocketException thrown if unable to change the mode
+   */
+  void setBlocking(bool blocking) throw(SocketException);
+#endif
+
   /**
    *   Resolve the specified service for the specified protocol to the
    *   corresponding port number in host byte order
@@ -128,6 +143,7 @@ private:
 protected:
   int sockDesc;              // Socket descriptor
   Socket(int type, int protocol) throw(SocketException);
+  Socket(int domain, int type, int protocol) throw(SocketException);
   Socket(int sockDesc);
 };
 
@@ -155,6 +171,46 @@ public:
    */
   void send(const void *buffer, int bufferLen) throw(SocketException);
 
+#ifndef WIN32
+  /**
+   *   Write as much of the given buffer as the socket takes without waiting
+   *   (non-blocking mode).  A packet socket takes all of it or nothing
+   *   @param buffer buffer to be written
+   *   @param bufferLen number of bytes from buffer to be written
+   *   @return number of bytes written, 0 if the socket buffer is full
+   *   @exception SocketException thrown if unable to send data
+   */
+  int trySend(const void *buffer, int bufferLen) throw(SocketException);
+
+  /**
+   *   Read what is available into the given buffer without waiting
+   *   (non-blocking mode)
+   *   @param buffer buffer to receive the data
+   *   @param bufferLen maximum number of bytes to read into buffer
+   *   @return number of bytes read, 0 for EOF, and -1 if there is no data yet
+   *   @exception SocketException thrown if unable to receive data
+   */
+  int tryRecv(void *buffer, int bufferLen) throw(SocketException);
+
+  /**
+   *   Start establishing a connection with the given foreign address and
+   *   port without waiting (the socket is switched to non-blocking mode).
+   *   The socket becomes writable when the connection is established or
+   *   has failed, then call finishConnect()
+   *   @param foreignAddress foreign address (IP address or name)
+   *   @param foreignPort foreign port
+   *   @exception SocketException thrown if the connection can't be started
+   */
+  void startConnect(const string &foreignAddress, unsigned short foreignPort)
+    throw(SocketException);
+
+  /**
+   *   Complete a connection started with startConnect()
+   *   @exception SocketException thrown if the connection failed
+   */
+  void finishConnect() throw(SocketException);
+#endif
+
   /**
    *   Read into the given buffer up to bufferLen bytes data from this
    *   socket.  Call connect() before calling recv()
@@ -181,7 +237,13 @@ public:
 
 protected:
   CommunicatingSocket(int type, int protocol) throw(SocketException);
+  CommunicatingSocket(int domain, int type, int protocol)
+      throw(SocketException);
   CommunicatingSocket(int newConnSD);
+#ifndef WIN32
+  void startConnect(const struct sockaddr *addr, int addrLen)
+    throw(SocketException);
+#endif
 };
 
 /**
@@ -205,6 +267,13 @@ public:
   TCPSocket(const string &foreignAddress, unsigned short foreignPort)
       throw(SocketException);
 
+  /**
+   *   Enable or disable Nagle's algorithm (TCP_NODELAY)
+   *   @param noDelay true to send small segments immediately
+   *   @exception SocketException thrown if unable to set the option
+   */
+  void setNoDelay(bool noDelay) throw(SocketException);
+
 private:
   // Access for TCPServerSocket::accept() connection creation
   friend class TCPServerSocket;
@@ -249,6 +318,7 @@ public:
 
 private:
   void setListen(int queueLen) throw(SocketException);
+  void setReuseAddress() throw(SocketException);
 };
 
 /**
@@ -336,4 +406,42 @@ private:
   void setBroadcast();
 };
 
+#ifndef WIN32
+/**
+ *   Unix domain socket (AF_UNIX, SOCK_SEQPACKET) for communication with a
+ *   process on the same machine.  The connection is reliable and ordered,
+ *   and every send() arrives as exactly one message on the other side
+ */
+class UnixSocket : public CommunicatingSocket {
+public:
+  /**
+   *   Construct a Unix domain socket with no connection
+   *   @exception SocketException thrown if unable to create the socket
+   */
+  UnixSocket() throw(SocketException);
+
+  /**
+   *   Construct a Unix domain socket with a connection to the given path
+   *   @param path filesystem path of the server socket
+   *   @exception SocketException thrown if unable to create the socket
+   */
+  UnixSocket(const string &path) throw(SocketException);
+
+  /**
+   *   Establish a connection with the server socket bound to path
+   *   @param path filesystem path of the server socket
+   *   @exception SocketException thrown if unable to establish connection
+   */
+  void connect(const string &path) throw(SocketException);
+
+  /**
+   *   Start establishing a connection with the server socket bound to path
+   *   without waiting, see CommunicatingSocket::finishConnect()
+   *   @param path filesystem path of the server socket
+   *   @exception SocketException thrown if the connection can't be started
+   */
+  void startConnect(const string &path) throw(SocketException);
+};
+#endif
+
 #endif
@@ -0,0 +1,65 @@
+/*
+ * ClockSync.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <string.h>
+#include "ClockSync.h"
+
+ClockSync::ClockSync() {
+	next_ping_id = 1;
+	reset();
+}
+
+void ClockSync::reset() {
+	memset(samples, 0, sizeof(samples));
+	n_samples = 0;
+	next_sample = 0;
+	best = 0;
+	n_pings = 0;
+	n_pongs = 0;
+}
+
+void ClockSync::makePing(Message &m) {
+	initMessage(m, MSG_PING);
+	m.data_id = next_ping_id++;
+	n_pings++;
+}
+
+bool ClockSync::handlePong(const Message &pong, uint64_t receiveTime) {
+	// Only the pings since reset(), older ones would mix two connections
+	if (pong.type != MSG_PONG || pong.data_id >= next_ping_id || pong.data_id
+			< next_ping_id - n_pings)
+		return false;
+	int64_t t0 = (int64_t) pong.sensor_time;
+	int64_t t1 = (int64_t) pong.capture_time;
+	int64_t t2 = (int64_t) pong.send_time;
+	int64_t t3 = (int64_t) receiveTime;
+	Sample s;
+	s.offset = ((t1 - t0) + (t2 - t3)) / 2;
+	s.round_trip = (t3 - t0) - (t2 - t1);
+	if (s.round_trip < 0)
+		s.round_trip = 0; // Clock resolution
+	samples[next_sample] = s;
+	next_sample = (next_sample + 1) % CLOCK_SYNC_SAMPLES;
+	if (n_samples < CLOCK_SYNC_SAMPLES)
+		n_samples++;
+	best = 0;
+	for (int i = 1; i < n_samples; i++) {
+		if (samples[i].round_trip < samples[best].round_trip)
+			best = i;
+	}
+	n_pongs++;
+	return true;
+}
+
+void ClockSync::makePong(const Message &ping, uint64_t receiveTime,
+		Message &pong) {
+	initMessage(pong, MSG_PONG);
+	pong.data_id = ping.data_id;
+	pong.sensor_time = ping.send_time;
+	pong.capture_time = receiveTime;
+	pong.send_time = 0; // When it is encoded
+}
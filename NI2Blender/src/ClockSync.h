@@ -0,0 +1,97 @@
+/*
+ * ClockSync.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef CLOCKSYNC_H_
+#define CLOCKSYNC_H_
+
+#include <stdint.h>
+#include "Protocol.h"
+
+// Pings sent right after connecting, CLOCK_SYNC_BURST_INTERVAL ms apart, and
+// then one every CLOCK_SYNC_INTERVAL ms
+#define CLOCK_SYNC_BURST 4
+#define CLOCK_SYNC_BURST_INTERVAL 100
+#define CLOCK_SYNC_INTERVAL 2000
+
+// Last samples the estimate is chosen from
+#define CLOCK_SYNC_SAMPLES 8
+
+/*NTP-style estimate of the offset between the CLOCK_MONOTONIC of this process
+ * and of the peer, from MSG_PING/MSG_PONG exchanges on the connection. With
+ * t0 the ping sent (local clock), t1 received and t2 answered by the peer,
+ * and t3 the pong received (local clock):
+ *   offset     = ((t1 - t0) + (t2 - t3)) / 2
+ *   round trip = (t3 - t0) - (t2 - t1)
+ * The sample with the smallest round trip among the last CLOCK_SYNC_SAMPLES
+ * is used, its offset is off by at most half of it. Either side may ping;
+ * makePong() is the answer.
+ */
+class ClockSync {
+public:
+	ClockSync();
+
+	// Forgets the samples (new connection)
+	void reset();
+
+	// Fills the next MSG_PING, its send time is set when it is encoded
+	void makePing(Message &m);
+
+	// Takes a MSG_PONG received at receiveTime, returns false if it doesn't
+	// answer one of our pings
+	bool handlePong(const Message &pong, uint64_t receiveTime);
+
+	// Answer to a MSG_PING received at receiveTime
+	static void makePong(const Message &ping, uint64_t receiveTime,
+			Message &pong);
+
+	// At least one pong was received since reset()
+	bool isSynchronized() const {
+		return n_samples > 0;
+	}
+
+	// Peer clock - local clock (us)
+	int64_t offset() const {
+		return samples[best].offset;
+	}
+
+	int64_t roundTrip() const {
+		return samples[best].round_trip;
+	}
+
+	uint64_t toPeer(uint64_t localTime) const {
+		return localTime + offset();
+	}
+
+	uint64_t fromPeer(uint64_t peerTime) const {
+		return peerTime - offset();
+	}
+
+	// Pings sent since reset(), and the ones still without an answer
+	int pings() const {
+		return n_pings;
+	}
+
+	int unanswered() const {
+		return n_pings - n_pongs;
+	}
+
+private:
+	struct Sample {
+		int64_t offset;
+		int64_t round_trip;
+	};
+
+	Sample samples[CLOCK_SYNC_SAMPLES];
+	int n_samples;
+	int next_sample;
+	int best; // Smallest round trip
+	int next_ping_id;
+	int n_pings;
+	int n_pongs;
+};
+
+#endif /* CLOCKSYNC_H_ */
@@ -0,0 +1,140 @@
+/*
+ * ConnectionBuffer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <string.h>
+#include "ConnectionBuffer.h"
+
+// Bytes read from the socket at a time
+#define INPUT_CHUNK 4096
+
+//-----------------------------------------------------------------------------
+// OutputBuffer
+//-----------------------------------------------------------------------------
+
+OutputBuffer::OutputBuffer() {
+	head = 0;
+	tail = 0;
+	written = 0;
+}
+
+char* OutputBuffer::reserve(int maxLen) {
+	if (head == tail) {
+		head = 0;
+		tail = 0;
+	} else if (head > data.size() / 2) {
+		// Moves the unwritten bytes back to the start
+		memmove(&data[0], &data[head], tail - head);
+		tail -= head;
+		head = 0;
+	}
+	if (tail + maxLen > data.size())
+		data.resize(tail + maxLen);
+	return &data[tail];
+}
+
+void OutputBuffer::commit(int len) {
+	tail += len;
+	lengths.push_back(len);
+}
+
+bool OutputBuffer::write(CommunicatingSocket &sock, bool packets)
+		throw(SocketException) {
+	if (packets) {
+		while (!lengths.empty()) {
+			if (sock.trySend(&data[head], lengths.front()) == 0)
+				return false;
+			head += lengths.front();
+			lengths.pop_front();
+		}
+		return true;
+	}
+	while (head < tail) {
+		int n = sock.trySend(&data[head], tail - head);
+		if (n == 0)
+			return false;
+		head += n;
+		written += n;
+		while (!lengths.empty() && written >= lengths.front()) {
+			written -= lengths.front();
+			lengths.pop_front();
+		}
+	}
+	return true;
+}
+
+void OutputBuffer::clear() {
+	head = 0;
+	tail = 0;
+	written = 0;
+	lengths.clear();
+}
+
+//-----------------------------------------------------------------------------
+// InputBuffer
+//-----------------------------------------------------------------------------
+
+InputBuffer::InputBuffer() {
+	head = 0;
+	tail = 0;
+}
+
+char* InputBuffer::space(int len) {
+	if (head == tail) {
+		head = 0;
+		tail = 0;
+	} else if (head > 0) {
+		memmove(&data[0], &data[head], tail - head);
+		tail -= head;
+		head = 0;
+	}
+	if (tail + len > data.size())
+		data.resize(tail + len);
+	return &data[tail];
+}
+
+bool InputBuffer::read(CommunicatingSocket &sock) throw(SocketException) {
+	for (;;) {
+		int n = sock.tryRecv(space(INPUT_CHUNK), INPUT_CHUNK);
+		if (n == 0)
+			return false;
+		if (n < 0)
+			return true;
+		tail += n;
+	}
+}
+
+void InputBuffer::append(const char *bytes, int len) {
+	memcpy(space(len), bytes, len);
+	tail += len;
+}
+
+bool InputBuffer::next(Message &m, MessageDecoder *decoder) {
+	while (head < tail) {
+		const char *p = &data[head];
+		int len = tail - head;
+		int n;
+		if (*p == '#')
+			n = decodeText(p, len, m);
+		else if (decoder != NULL)
+			n = decoder->decode(p, len, m);
+		else
+			n = decodeBinary(p, len, m);
+		if (n == 0)
+			return false; // Incomplete
+		if (n > 0) {
+			head += n;
+			return true;
+		}
+		head++; // Not a message, looks for the next one
+	}
+	return false;
+}
+
+void InputBuffer::clear() {
+	head = 0;
+	tail = 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * ConnectionBuffer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef CONNECTIONBUFFER_H_
+#define CONNECTIONBUFFER_H_
+
+#include <vector>
+#include <deque>
+#include "Protocol.h"
+#include "PracticalSocket.h"
+
+/*Encoded messages waiting to be written to a non-blocking socket. write()
+ * sends as much as the socket takes and keeps the rest, so a partial write
+ * resumes at the right byte. In packet mode (SOCK_SEQPACKET) each message is
+ * written as its own packet.
+ */
+class OutputBuffer {
+public:
+	OutputBuffer();
+
+	// Space for a message of up to maxLen bytes at the end
+	char* reserve(int maxLen);
+
+	// Appends the reserved message with its real length
+	void commit(int len);
+
+	// Writes what the socket takes, returns true if everything was written
+	bool write(CommunicatingSocket &sock, bool packets) throw(SocketException);
+
+	void clear();
+
+	// Bytes not written yet
+	int size() const {
+		return (int) (tail - head);
+	}
+
+	bool isEmpty() const {
+		return head == tail;
+	}
+
+	// Messages not completely written yet
+	int messages() const {
+		return (int) lengths.size();
+	}
+
+private:
+	std::vector<char> data;
+	size_t head; // First byte not written
+	size_t tail; // End of the last message
+	std::deque<int> lengths; // Of the messages not completely written
+	int written; // Bytes of lengths.front() already written
+};
+
+/*Bytes read from a non-blocking socket (or appended, e.g. from a file), split
+ * into messages (binary frames or "#...#" text records) as they become
+ * complete.
+ */
+class InputBuffer {
+public:
+	InputBuffer();
+
+	// Reads what is available, returns false on EOF
+	bool read(CommunicatingSocket &sock) throw(SocketException);
+
+	// Adds bytes received some other way
+	void append(const char *bytes, int len);
+
+	/*Decodes the next complete message, returns false if there is none.
+	 * With a decoder, compact records and skeleton deltas are rebuilt too
+	 * (one that can't be is returned as MSG_NONE).
+	 */
+	bool next(Message &m, MessageDecoder *decoder = NULL);
+
+	void clear();
+
+private:
+	// Room for len more bytes at the end
+	char* space(int len);
+
+	std::vector<char> data;
+	size_t head;
+	size_t tail;
+};
+
+#endif /* CONNECTIONBUFFER_H_ */
@@ -0,0 +1,183 @@
+/*
+ * EventLoop.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "EventLoop.h"
+
+// Events handled in one epoll_wait()
+#define MAX_LOOP_EVENTS 16
+
+EventLoop::EventLoop() {
+	epoll_fd = -1;
+	wakeup_fd = -1;
+	wakeup_handler = NULL;
+	stopping = false;
+}
+
+EventLoop::~EventLoop() {
+	close();
+}
+
+bool EventLoop::open() {
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		printf("\nepoll_create1 failed: %s", strerror(errno));
+		return false;
+	}
+	wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakeup_fd < 0) {
+		printf("\neventfd failed: %s", strerror(errno));
+		close();
+		return false;
+	}
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = wakeup_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev) < 0) {
+		printf("\nepoll_ctl failed: %s", strerror(errno));
+		close();
+		return false;
+	}
+	stopping = false;
+	return true;
+}
+
+void EventLoop::close() {
+	if (wakeup_fd >= 0)
+		::close(wakeup_fd);
+	if (epoll_fd >= 0)
+		::close(epoll_fd);
+	wakeup_fd = -1;
+	epoll_fd = -1;
+	handlers.clear();
+	timers.clear();
+}
+
+void EventLoop::setHandler(int fd, EventHandler *handler) {
+	if ((size_t) fd >= handlers.size()) {
+		handlers.resize(fd + 1, NULL);
+		timers.resize(fd + 1, false);
+	}
+	handlers[fd] = handler;
+	timers[fd] = false;
+}
+
+bool EventLoop::add(int fd, uint32_t events, EventHandler *handler) {
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		printf("\nepoll_ctl(ADD) failed: %s", strerror(errno));
+		return false;
+	}
+	setHandler(fd, handler);
+	return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+	return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::remove(int fd) {
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	setHandler(fd, NULL);
+}
+
+int EventLoop::createTimer(EventHandler *handler) {
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		printf("\ntimerfd_create failed: %s", strerror(errno));
+		return -1;
+	}
+	if (!add(fd, EPOLLIN, handler)) {
+		::close(fd);
+		return -1;
+	}
+	timers[fd] = true;
+	return fd;
+}
+
+void EventLoop::setTimer(int fd, int ms, bool periodic) {
+	itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = ms / 1000;
+	spec.it_value.tv_nsec = (ms % 1000) * 1000000L;
+	if (periodic)
+		spec.it_interval = spec.it_value;
+	timerfd_settime(fd, 0, &spec, NULL);
+}
+
+void EventLoop::deleteTimer(int fd) {
+	if (fd < 0)
+		return;
+	remove(fd);
+	::close(fd);
+}
+
+void EventLoop::setWakeupHandler(EventHandler *handler) {
+	wakeup_handler = handler;
+}
+
+void EventLoop::run() {
+	while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+		if (!poll(-1))
+			break;
+}
+
+bool EventLoop::poll(int timeoutMs) {
+	epoll_event events[MAX_LOOP_EVENTS];
+	int n = epoll_wait(epoll_fd, events, MAX_LOOP_EVENTS, timeoutMs);
+	if (n < 0) {
+		if (errno == EINTR)
+			return true;
+		printf("\nepoll_wait failed: %s", strerror(errno));
+		return false;
+	}
+	for (int i = 0; i < n; i++) {
+		int fd = events[i].data.fd;
+		if (fd == wakeup_fd) {
+			uint64_t count;
+			if (read(wakeup_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+				printf("\neventfd read failed: %s", strerror(errno));
+			if (wakeup_handler != NULL)
+				wakeup_handler->handleEvent(fd, events[i].events);
+			continue;
+		}
+		if (fd >= (int) handlers.size() || handlers[fd] == NULL)
+			continue; // Removed by an earlier handler of this batch
+		if (timers[fd]) {
+			// Read or it stays readable; EAGAIN if it was set again meanwhile
+			uint64_t expirations;
+			if (read(fd, &expirations, sizeof(expirations)) < 0)
+				continue;
+		}
+		handlers[fd]->handleEvent(fd, events[i].events);
+	}
+	return true;
+}
+
+void EventLoop::wakeup() {
+	uint64_t one = 1;
+	if (write(wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		printf("\neventfd write failed: %s", strerror(errno));
+}
+
+void EventLoop::stop() {
+	__atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+	wakeup();
+}
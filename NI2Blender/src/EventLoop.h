@@ -0,0 +1,84 @@
+/*
+ * EventLoop.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef EVENTLOOP_H_
+#define EVENTLOOP_H_
+
+#include <stdint.h>
+#include <vector>
+#include <sys/epoll.h>
+
+// Callback of the descriptors watched by an EventLoop
+class EventHandler {
+public:
+	virtual ~EventHandler() {
+	}
+
+	// events is a mask of EPOLLIN, EPOLLOUT, EPOLLERR, EPOLLHUP...
+	virtual void handleEvent(int fd, uint32_t events) = 0;
+};
+
+/*Single threaded I/O loop on epoll (Linux). Sockets, timers (timerfd) and a
+ * wakeup (eventfd) are dispatched to their handlers by the thread that calls
+ * run(); any other thread talks to it through wakeup().
+ */
+class EventLoop {
+public:
+	EventLoop();
+	~EventLoop();
+
+	// Creates the epoll and wakeup descriptors
+	bool open();
+	void close();
+
+	//-------------------------------------------------------------------------
+	// Loop thread (or before run())
+	//-------------------------------------------------------------------------
+
+	// Watches fd for events (EPOLLIN, EPOLLOUT...)
+	bool add(int fd, uint32_t events, EventHandler *handler);
+	bool modify(int fd, uint32_t events);
+	void remove(int fd);
+
+	// Timer descriptor calling handler when it expires, -1 on error
+	int createTimer(EventHandler *handler);
+
+	// Expires after ms (and then every ms if periodic), 0 disarms it
+	void setTimer(int fd, int ms, bool periodic = false);
+	void deleteTimer(int fd);
+
+	// Called after each wakeup() (several wakeups may be merged in one call)
+	void setWakeupHandler(EventHandler *handler);
+
+	// Dispatches events until stop()
+	void run();
+
+	// Waits up to timeoutMs (-1 forever) and dispatches what is ready,
+	// returns false on error
+	bool poll(int timeoutMs);
+
+	//-------------------------------------------------------------------------
+	// Any thread
+	//-------------------------------------------------------------------------
+
+	void wakeup();
+
+	// run() returns after the events being dispatched
+	void stop();
+
+private:
+	void setHandler(int fd, EventHandler *handler);
+
+	int epoll_fd;
+	int wakeup_fd;
+	EventHandler *wakeup_handler;
+	std::vector<EventHandler*> handlers; // Indexed by descriptor
+	std::vector<bool> timers;
+	bool stopping;
+};
+
+#endif /* EVENTLOOP_H_ */
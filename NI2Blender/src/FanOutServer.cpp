@@ -0,0 +1,246 @@
+/*
+ * FanOutServer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <iostream>
+#include "FanOutServer.h"
+
+FanOutServer::FanOutServer() {
+	server = NULL;
+	loop = NULL;
+	handler = NULL;
+	accept_timer = -1;
+	accept_delay = ACCEPT_MIN_DELAY;
+	next_id = 1;
+	n_subscribers = 0;
+	n_accepted = 0;
+	n_kicked = 0;
+	n_sent = 0;
+	n_dropped = 0;
+}
+
+FanOutServer::~FanOutServer() {
+	stop();
+}
+
+bool FanOutServer::start(unsigned short port) {
+	try {
+		server = new TCPServerSocket(port);
+		server->setBlocking(false);
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		delete server;
+		server = NULL;
+		return false;
+	}
+	signal(SIGPIPE, SIG_IGN); // A closed subscriber must fail with EPIPE
+	printf("\nWaiting for subscribers on port %d", port);
+	return true;
+}
+
+void FanOutServer::stop() {
+	for (size_t i = 0; i < active.size(); i++) {
+		Subscriber *s = active[i];
+		if (!s->output.isEmpty())
+			printf("\nSubscriber %d didn't take the rest", s->id);
+		n_sent += s->n_sent;
+		n_dropped += s->n_dropped;
+		if (loop != NULL)
+			loop->remove(s->sock->getDescriptor());
+		delete s->sock;
+		delete s;
+	}
+	active.clear();
+	__atomic_store_n(&n_subscribers, 0, __ATOMIC_RELAXED);
+	if (loop != NULL && server != NULL) {
+		loop->remove(server->getDescriptor());
+		loop->deleteTimer(accept_timer);
+	}
+	loop = NULL;
+	delete server;
+	server = NULL;
+}
+
+void FanOutServer::attach(EventLoop *loop, EventHandler *handler) {
+	if (server == NULL)
+		return;
+	this->loop = loop;
+	this->handler = handler;
+	accept_timer = loop->createTimer(handler);
+	loop->add(server->getDescriptor(), EPOLLIN, handler);
+}
+
+bool FanOutServer::dispatch(int fd, uint32_t events) {
+	if (loop == NULL)
+		return false;
+	if (fd == accept_timer) {
+		loop->modify(server->getDescriptor(), EPOLLIN); // Try again
+		acceptSubscribers();
+		return true;
+	}
+	if (fd == server->getDescriptor()) {
+		acceptSubscribers();
+		return true;
+	}
+	for (size_t i = 0; i < active.size(); i++) {
+		Subscriber *s = active[i];
+		if (s->closed || fd != s->sock->getDescriptor())
+			continue;
+		if (events & EPOLLIN)
+			readSubscriber(s);
+		if ((events & EPOLLOUT) && !s->closed)
+			writeSubscriber(s);
+		if ((events & (EPOLLERR | EPOLLHUP)) && !(events & EPOLLIN))
+			s->closed = true;
+		removeClosed();
+		return true;
+	}
+	return false;
+}
+
+// New subscribers start with the next message broadcast
+void FanOutServer::acceptSubscribers() {
+	for (;;) {
+		TCPSocket *sock;
+		try {
+			sock = server->accept();
+		} catch (SocketException &e) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				accept_delay = ACCEPT_MIN_DELAY;
+				return; // No more waiting
+			}
+			// e.g. EMFILE: it would fail again right away, stop watching the
+			// listening socket for a while
+			std::cerr << e.what() << std::endl;
+			loop->modify(server->getDescriptor(), 0);
+			loop->setTimer(accept_timer, accept_delay);
+			accept_delay = accept_delay * 2 < ACCEPT_MAX_DELAY ? accept_delay
+					* 2 : ACCEPT_MAX_DELAY;
+			return;
+		}
+		Subscriber *s = new Subscriber();
+		s->sock = sock;
+		s->id = next_id++;
+		s->want_write = false;
+		s->closed = false;
+		s->n_sent = 0;
+		s->n_dropped = 0;
+		try {
+			sock->setBlocking(false);
+			sock->setNoDelay(true); // Writes are already one per frame
+		} catch (SocketException &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		active.push_back(s);
+		loop->add(sock->getDescriptor(), EPOLLIN, handler);
+		printf("\nSubscriber %d connected", s->id);
+		__atomic_add_fetch(&n_accepted, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&n_subscribers, active.size(), __ATOMIC_RELAXED);
+	}
+}
+
+// Subscribers send nothing we use, reading only notices when they close
+void FanOutServer::readSubscriber(Subscriber *s) {
+	char buffer[1024];
+	try {
+		int n;
+		while ((n = s->sock->tryRecv(buffer, sizeof(buffer))) > 0)
+			;
+		if (n == 0) {
+			printf("\nSubscriber %d disconnected", s->id);
+			s->closed = true;
+		}
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		s->closed = true;
+	}
+}
+
+// Writes what the socket takes, EPOLLOUT stays on while something is left
+void FanOutServer::writeSubscriber(Subscriber *s) {
+	int before = s->output.messages();
+	bool empty;
+	try {
+		empty = s->output.write(*s->sock, false);
+	} catch (SocketException &e) {
+		printf("\nSubscriber %d disconnected", s->id);
+		s->closed = true;
+		return;
+	}
+	s->n_sent += before - s->output.messages();
+	if (empty == s->want_write) {
+		s->want_write = !empty;
+		loop->modify(s->sock->getDescriptor(), EPOLLIN | (s->want_write
+				? (uint32_t) EPOLLOUT : 0));
+	}
+}
+
+void FanOutServer::broadcast(const char *data, int len, bool reliable) {
+	for (size_t i = 0; i < active.size(); i++) {
+		Subscriber *s = active[i];
+		if (s->closed)
+			continue;
+		int backlog = s->output.size();
+		if (!reliable && backlog > SUBSCRIBER_MAX_BACKLOG) {
+			s->n_dropped++; // A newer sample will follow
+			continue;
+		}
+		if (reliable && backlog > SUBSCRIBER_MAX_EVENT_BACKLOG) {
+			printf("\nSubscriber %d is too slow, disconnecting it", s->id);
+			s->closed = true;
+			__atomic_add_fetch(&n_kicked, 1, __ATOMIC_RELAXED);
+			continue;
+		}
+		memcpy(s->output.reserve(len), data, len);
+		s->output.commit(len);
+	}
+}
+
+void FanOutServer::publish() {
+	for (size_t i = 0; i < active.size(); i++) {
+		Subscriber *s = active[i];
+		if (!s->closed && !s->want_write) // Else waiting for EPOLLOUT
+			writeSubscriber(s);
+	}
+	removeClosed();
+}
+
+bool FanOutServer::isEmpty() const {
+	for (size_t i = 0; i < active.size(); i++)
+		if (!active[i]->closed && !active[i]->output.isEmpty())
+			return false;
+	return true;
+}
+
+void FanOutServer::removeClosed() {
+	for (size_t i = 0; i < active.size();) {
+		Subscriber *s = active[i];
+		if (!s->closed) {
+			i++;
+			continue;
+		}
+		n_sent += s->n_sent;
+		n_dropped += s->n_dropped;
+		loop->remove(s->sock->getDescriptor());
+		delete s->sock;
+		delete s;
+		active[i] = active.back();
+		active.pop_back();
+	}
+	__atomic_store_n(&n_subscribers, active.size(), __ATOMIC_RELAXED);
+}
+
+void FanOutServer::printStats() const {
+	printf("\nFan-out: %lu subscribers accepted, %lu too slow, %lu messages "
+		"sent, %lu coordinates dropped (too much waiting)", accepted(),
+			kicked(), n_sent, n_dropped);
+}
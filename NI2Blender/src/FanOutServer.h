@@ -0,0 +1,129 @@
+/*
+ * FanOutServer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef FANOUTSERVER_H_
+#define FANOUTSERVER_H_
+
+#include <vector>
+#include "Protocol.h"
+#include "EventLoop.h"
+#include "ConnectionBuffer.h"
+#include "PracticalSocket.h"
+
+// Bytes waiting for a subscriber beyond which its coordinates are dropped
+#define SUBSCRIBER_MAX_BACKLOG (64 * 1024)
+
+// Bytes waiting beyond which a subscriber that gets an event is disconnected
+#define SUBSCRIBER_MAX_EVENT_BACKLOG (256 * 1024)
+
+// Delay between failed accept()s, doubled after each failure (ms)
+#define ACCEPT_MIN_DELAY 10
+#define ACCEPT_MAX_DELAY 1000
+
+/*One connected consumer (Blender, a recorder, a dashboard...). It has its own
+ * output buffer, so a slow one only delays itself.
+ */
+struct Subscriber {
+	TCPSocket *sock;
+	int id;
+	OutputBuffer output;
+	bool want_write; // EPOLLOUT is on
+	bool closed;
+	unsigned long n_sent; // Messages written
+	unsigned long n_dropped; // Coordinates dropped, too much waiting
+};
+
+/*Server mode: instead of connecting to one Blender, listens on a TCP port and
+ * sends every message to all the connected subscribers. It runs on the
+ * NetSender's event loop, which hands it the events of its descriptors
+ * (dispatch()): the listening socket and the subscribers' sockets are
+ * non-blocking, and what a subscriber doesn't take is written when its socket
+ * becomes writable. NetSender encodes each message once and broadcast()s it
+ * into every subscriber's output buffer. The bytes are copied, not shared
+ * (half a kilobyte at most, a full skeleton): with its own contiguous buffer
+ * each subscriber drops coordinates on its own and takes what is waiting
+ * with one send(), where a shared refcounted list would need a read offset
+ * per subscriber and one send() per message. When too much is waiting for a
+ * subscriber its coordinates are dropped, while one that falls even further
+ * behind and gets an event is disconnected (it may connect again). A new
+ * subscriber of the compact format gets deltas it can't decode until the
+ * next keyframe of each stream.
+ */
+class FanOutServer {
+public:
+	FanOutServer();
+	~FanOutServer();
+
+	// Listens on port, subscribers are accepted once attach()ed
+	bool start(unsigned short port);
+
+	// Closes the subscribers and the listening socket. Call after stopping the
+	// sender thread, which lets them take what is waiting first.
+	void stop();
+
+	//-------------------------------------------------------------------------
+	// Sender thread
+	//-------------------------------------------------------------------------
+
+	// Watches the descriptors on loop, their events go to handler, which
+	// must pass them to dispatch() (NetSender::start())
+	void attach(EventLoop *loop, EventHandler *handler);
+
+	// Handles the events of fd, returns false if it isn't one of ours
+	bool dispatch(int fd, uint32_t events);
+
+	// Appends the encoded message to every subscriber's output
+	void broadcast(const char *data, int len, bool reliable);
+
+	// Writes to the subscribers and removes the closed ones
+	void publish();
+
+	// Every subscriber took everything
+	bool isEmpty() const;
+
+	//-------------------------------------------------------------------------
+	// Counters (any thread)
+	//-------------------------------------------------------------------------
+
+	unsigned int subscribers() const {
+		return __atomic_load_n(&n_subscribers, __ATOMIC_RELAXED);
+	}
+
+	unsigned long accepted() const {
+		return __atomic_load_n(&n_accepted, __ATOMIC_RELAXED);
+	}
+
+	// Disconnected because too much was waiting when an event came
+	unsigned long kicked() const {
+		return __atomic_load_n(&n_kicked, __ATOMIC_RELAXED);
+	}
+
+	// After stop()
+	void printStats() const;
+
+private:
+	void acceptSubscribers();
+	void readSubscriber(Subscriber *s);
+	void writeSubscriber(Subscriber *s);
+	void removeClosed();
+
+	TCPServerSocket *server;
+	EventLoop *loop;
+	EventHandler *handler;
+	int accept_timer;
+	int accept_delay;
+	int next_id;
+	std::vector<Subscriber*> active; // Sender thread only
+
+	unsigned int n_subscribers;
+	unsigned long n_accepted;
+	unsigned long n_kicked;
+	unsigned long n_sent; // By the subscribers already closed
+	unsigned long n_dropped;
+};
+
+#endif /* FANOUTSERVER_H_ */
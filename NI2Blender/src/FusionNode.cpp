@@ -0,0 +1,328 @@
+/*
+ * FusionNode.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <iostream>
+#include "FusionNode.h"
+
+FusionNode::FusionNode(SkeletonFusion *fusion, NetSender *sender) {
+	this->fusion = fusion;
+	this->sender = sender;
+	server = NULL;
+	tick_timer = -1;
+	ping_timer = -1;
+	next_source_id = 1;
+	data_id = 1;
+	for (int d = 0; d < MAX_DEVICES; d++)
+		device_owner[d] = 0;
+	running = false;
+	n_received = 0;
+	n_early = 0;
+	n_fused = 0;
+	n_forwarded = 0;
+	n_rejected = 0;
+}
+
+FusionNode::~FusionNode() {
+	stop();
+}
+
+bool FusionNode::start(unsigned short port) {
+	try {
+		server = new TCPServerSocket(port);
+		server->setBlocking(false);
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		delete server;
+		server = NULL;
+		return false;
+	}
+	signal(SIGPIPE, SIG_IGN); // A closed source must fail with EPIPE
+	if (!loop.open())
+		return false;
+	tick_timer = loop.createTimer(this);
+	ping_timer = loop.createTimer(this);
+	if (tick_timer < 0 || ping_timer < 0)
+		return false;
+	loop.add(server->getDescriptor(), EPOLLIN, this);
+	loop.setTimer(tick_timer, FUSION_TICK, true);
+	loop.setTimer(ping_timer, CLOCK_SYNC_BURST_INTERVAL, true);
+	if (pthread_create(&thread, NULL, &FusionNode::run, this) != 0) {
+		printf("\nCouldn't create the fusion thread");
+		return false;
+	}
+	running = true;
+	printf("\nFusion node waiting for sensors on port %d", port);
+	return true;
+}
+
+void FusionNode::stop() {
+	if (!running)
+		return;
+	loop.stop();
+	pthread_join(thread, NULL);
+	running = false;
+	for (size_t i = 0; i < sources.size(); i++) {
+		delete sources[i]->sock;
+		delete sources[i];
+	}
+	sources.clear();
+	loop.deleteTimer(tick_timer);
+	loop.deleteTimer(ping_timer);
+	loop.close();
+	delete server;
+	server = NULL;
+}
+
+void* FusionNode::run(void *arg) {
+	((FusionNode*) arg)->loop.run();
+	return NULL;
+}
+
+void FusionNode::handleEvent(int fd, uint32_t events) {
+	if (fd == tick_timer) {
+		tick();
+	} else if (fd == ping_timer) {
+		pingSources(monotonicMicros());
+	} else if (fd == server->getDescriptor()) {
+		acceptSources();
+	} else {
+		for (size_t i = 0; i < sources.size(); i++) {
+			Source *s = sources[i];
+			if (s->closed || fd != s->sock->getDescriptor())
+				continue;
+			if (events & EPOLLIN)
+				readSource(s);
+			if ((events & EPOLLOUT) && !s->closed)
+				writeSource(s);
+			if ((events & (EPOLLERR | EPOLLHUP)) && !(events & EPOLLIN))
+				s->closed = true;
+			break;
+		}
+	}
+	removeClosed();
+}
+
+void FusionNode::acceptSources() {
+	for (;;) {
+		TCPSocket *sock;
+		try {
+			sock = server->accept();
+		} catch (SocketException &e) {
+			return; // No more waiting
+		}
+		Source *s = new Source();
+		s->sock = sock;
+		s->id = next_source_id++;
+		s->last_ping = 0;
+		s->want_write = false;
+		s->closed = false;
+		try {
+			sock->setBlocking(false);
+			sock->setNoDelay(true);
+		} catch (SocketException &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		sources.push_back(s);
+		loop.add(sock->getDescriptor(), EPOLLIN, this);
+		printf("\nSensor source %d connected", s->id);
+		pingSources(monotonicMicros());
+	}
+}
+
+void FusionNode::readSource(Source *s) {
+	try {
+		if (!s->input.read(*s->sock)) {
+			printf("\nSensor source %d closed the connection", s->id);
+			s->closed = true;
+		}
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		s->closed = true;
+	}
+	uint64_t now = monotonicMicros();
+	Message m;
+	while (s->input.next(m, &s->decoder)) {
+		n_received++;
+		handleMessage(s, m, now);
+	}
+	sender->publish();
+}
+
+// Writes what the socket takes, EPOLLOUT stays on while something is left
+void FusionNode::writeSource(Source *s) {
+	bool empty;
+	try {
+		empty = s->output.write(*s->sock, false);
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		s->closed = true;
+		return;
+	}
+	if (empty == s->want_write) {
+		s->want_write = !empty;
+		loop.modify(s->sock->getDescriptor(), EPOLLIN | (s->want_write
+				? (uint32_t) EPOLLOUT : 0));
+	}
+}
+
+// Pings and pongs, always binary (sources read both formats)
+void FusionNode::sendToSource(Source *s, const Message &m) {
+	char *p = s->output.reserve(MAX_MESSAGE_SIZE);
+	int n = encodeBinary(m, p, MAX_MESSAGE_SIZE);
+	if (n <= 0)
+		return;
+	s->output.commit(n);
+	writeSource(s);
+}
+
+void FusionNode::handleMessage(Source *s, Message &m, uint64_t receiveTime) {
+	switch (m.type) {
+	case MSG_NONE: // A delta without its keyframe
+	case MSG_RESUME:
+		return;
+	case MSG_PING: {
+		Message pong;
+		ClockSync::makePong(m, receiveTime, pong);
+		sendToSource(s, pong);
+		return;
+	}
+	case MSG_PONG:
+		s->clock.handlePong(m, receiveTime);
+		return;
+	case MSG_CLIENT_EXIT:
+		printf("\nSensor source %d exited", s->id);
+		s->closed = true;
+		return;
+	default:
+		break;
+	}
+	if (!claimDevice(s, m.device_id))
+		return;
+	// In the local clock (the time it arrived until the clock is known)
+	bool synced = s->clock.isSynchronized();
+	m.capture_time = synced && m.capture_time != 0 ? s->clock.fromPeer(
+			m.capture_time) : receiveTime;
+	m.send_time = 0;
+	switch (m.type) {
+	case MSG_SKELETON:
+		if (synced)
+			fusion->addSkeleton(m);
+		else
+			n_early++;
+		return;
+	case MSG_NEW_USER_CALIBRATED:
+		return; // The fused users have their own events
+	case MSG_CALIBRATED_USER_LOST:
+	case MSG_CALIBRATED_USER_EXIT:
+		fusion->removeSkeleton(m.device_id, m.player_id);
+		return;
+	case MSG_HAND_COORDINATES:
+	case MSG_HEAD_COORDINATES: {
+		int player = fusion->fusedUser(m.device_id, m.player_id);
+		if (player < 0)
+			return; // Not one of the fused users (yet)
+		float in[3] = { m.coordinates[0], m.coordinates[1], m.coordinates[2] };
+		fusion->toOutput(m.device_id, in, m.coordinates);
+		m.player_id = player;
+		break;
+	}
+	default: { // Session and gestures
+		if (m.player_id < 0)
+			break; // Of nobody
+		int player = fusion->fusedUser(m.device_id, m.player_id);
+		if (player < 0)
+			return; // Not one of the fused users (yet)
+		m.player_id = player;
+		break;
+	}
+	}
+	m.calibrated = fusion->users() > 0;
+	forward(m);
+	n_forwarded++;
+}
+
+// The device id of m must be free or already used by s
+bool FusionNode::claimDevice(Source *s, int device) {
+	if (device < 0 || device >= MAX_DEVICES)
+		return false;
+	if (device_owner[device] == 0) {
+		device_owner[device] = s->id;
+		printf("\nSensor source %d is device %d", s->id, device);
+	} else if (device_owner[device] != s->id) {
+		printf("\nSensor source %d sends device %d, already used by source %d:"
+			" disconnecting it (give each sensor its own --device-id)", s->id,
+				device, device_owner[device]);
+		s->closed = true;
+		n_rejected++;
+		return false;
+	}
+	return true;
+}
+
+void FusionNode::forward(Message &m) {
+	m.data_id = data_id++;
+	sender->enqueue(m);
+}
+
+// A burst right after connecting, then one every CLOCK_SYNC_INTERVAL
+void FusionNode::pingSources(uint64_t now) {
+	for (size_t i = 0; i < sources.size(); i++) {
+		Source *s = sources[i];
+		if (s->closed)
+			continue;
+		bool burst = !s->clock.isSynchronized() && s->clock.pings()
+				< CLOCK_SYNC_BURST;
+		if (!burst && now - s->last_ping < CLOCK_SYNC_INTERVAL * 1000ULL)
+			continue;
+		Message m;
+		s->clock.makePing(m);
+		sendToSource(s, m);
+		s->last_ping = now;
+	}
+}
+
+void FusionNode::removeClosed() {
+	for (size_t i = 0; i < sources.size();) {
+		Source *s = sources[i];
+		if (!s->closed) {
+			i++;
+			continue;
+		}
+		// Its users left the view of its sensors
+		for (int d = 0; d < MAX_DEVICES; d++) {
+			if (device_owner[d] != s->id)
+				continue;
+			device_owner[d] = 0;
+			for (int p = 0; p < SKELETON_MAX_PLAYERS; p++)
+				fusion->removeSkeleton(d, p);
+		}
+		loop.remove(s->sock->getDescriptor());
+		delete s->sock;
+		delete s;
+		sources.erase(sources.begin() + i);
+	}
+}
+
+void FusionNode::tick() {
+	Message out[2 * MAX_USERS];
+	int n = fusion->fuse(monotonicMicros(), out, 2 * MAX_USERS);
+	for (int i = 0; i < n; i++) {
+		if (out[i].type == MSG_SKELETON)
+			n_fused++;
+		forward(out[i]);
+	}
+	if (n > 0)
+		sender->publish();
+}
+
+void FusionNode::printStats() const {
+	printf("\nFusion: %lu messages received, %lu skeletons before clock sync,"
+		" %lu fused skeletons, %lu forwarded, %lu sources rejected (device id"
+		" in use)", n_received, n_early, n_fused, n_forwarded, n_rejected);
+}
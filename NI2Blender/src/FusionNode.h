@@ -0,0 +1,105 @@
+/*
+ * FusionNode.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef FUSIONNODE_H_
+#define FUSIONNODE_H_
+
+#include <pthread.h>
+#include <vector>
+#include "Protocol.h"
+#include "EventLoop.h"
+#include "ConnectionBuffer.h"
+#include "ClockSync.h"
+#include "NetSender.h"
+#include "SkeletonFusion.h"
+#include "PracticalSocket.h"
+
+// Fused skeletons are produced every FUSION_TICK ms (a new one only when a
+// sensor sent something newer)
+#define FUSION_TICK 10
+
+/*Fusion mode (--fusion): NI2Blender instances on other machines (or replays
+ * of recorded streams) connect to it as if it were Blender, each one with
+ * its own --device-id, and the node sends Blender a single stream through
+ * NetSender. For every source it:
+ * - pings it like NetSender pings the server (ClockSync), so its capture
+ *   times can be put in the local clock, and answers its pings;
+ * - decodes its stream (any wire format, with its own MessageDecoder);
+ * - gives the full skeletons to SkeletonFusion, and its lost/exit events;
+ * - forwards its other messages (hands, head, session, gestures) with the
+ *   coordinates in the output projection and the fused player id; the ones
+ *   of a user not fused (yet) are dropped.
+ * When a source closes, the users of its devices are removed from the fusion.
+ * Skeletons are only used once the clock of their source is synchronized.
+ * The calibrations are per device id, so a device id belongs to the first
+ * source that sends it until that source closes: a source sending one that
+ * another source already uses (e.g. two hosts left at --device-id 0) is
+ * disconnected. Everything runs on the node's thread, which is the producer of the
+ * NetSender.
+ */
+class FusionNode: private EventHandler {
+public:
+	FusionNode(SkeletonFusion *fusion, NetSender *sender);
+	~FusionNode();
+
+	// Listens on port and starts the node's thread
+	bool start(unsigned short port);
+
+	// Closes the sources and waits for the thread
+	void stop();
+
+	void printStats() const;
+
+private:
+	// A connected NI2Blender instance
+	struct Source {
+		TCPSocket *sock;
+		int id;
+		InputBuffer input;
+		OutputBuffer output;
+		MessageDecoder decoder;
+		ClockSync clock;
+		uint64_t last_ping;
+		bool want_write;
+		bool closed;
+	};
+
+	static void* run(void *arg);
+	virtual void handleEvent(int fd, uint32_t events);
+	void acceptSources();
+	void readSource(Source *s);
+	void writeSource(Source *s);
+	void sendToSource(Source *s, const Message &m);
+	void handleMessage(Source *s, Message &m, uint64_t receiveTime);
+	bool claimDevice(Source *s, int device);
+	void forward(Message &m);
+	void pingSources(uint64_t now);
+	void removeClosed();
+	void tick();
+
+	SkeletonFusion *fusion;
+	NetSender *sender;
+	EventLoop loop;
+	TCPServerSocket *server;
+	std::vector<Source*> sources;
+	int tick_timer;
+	int ping_timer;
+	int next_source_id;
+	int data_id;
+	int device_owner[MAX_DEVICES]; // Source id using each device id, 0 = none
+
+	pthread_t thread;
+	bool running;
+
+	unsigned long n_received; // From the sources
+	unsigned long n_early; // Skeletons before their clock was synchronized
+	unsigned long n_fused; // Fused skeletons sent
+	unsigned long n_forwarded;
+	unsigned long n_rejected; // Sources using a device id already taken
+};
+
+#endif /* FUSIONNODE_H_ */
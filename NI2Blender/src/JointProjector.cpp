@@ -0,0 +1,40 @@
+/*
+ * JointProjector.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <math.h>
+#include "JointProjector.h"
+
+JointProjector::JointProjector() {
+	count = 0;
+	coeff_x = 0;
+	coeff_y = 0;
+	half_x = 0;
+	half_y = 0;
+}
+
+void JointProjector::setFieldOfView(double hFov, double vFov, int xRes,
+		int yRes) {
+	coeff_x = (float) (xRes / (2 * tan(hFov / 2)));
+	coeff_y = (float) (yRes / (2 * tan(vFov / 2)));
+	half_x = xRes / 2.0f;
+	half_y = yRes / 2.0f;
+}
+
+// No branches or calls in the loop, so it is vectorized (SSE/NEON)
+void JointProjector::project() {
+	int n = (count + 3) & ~3; // Whole vectors, the padding is never read
+	for (int i = count; i < n; i++) {
+		real_x[i] = 0;
+		real_y[i] = 0;
+		div_z[i] = 1;
+	}
+	for (int i = 0; i < n; i++) {
+		float inv_z = 1.0f / div_z[i];
+		proj_x[i] = half_x + coeff_x * real_x[i] * inv_z;
+		proj_y[i] = half_y - coeff_y * real_y[i] * inv_z;
+	}
+}
@@ -0,0 +1,80 @@
+/*
+ * JointProjector.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef JOINTPROJECTOR_H_
+#define JOINTPROJECTOR_H_
+
+// Joints projected at once: 16 users x 15 joints, a multiple of 4
+#define MAX_PROJECTED_JOINTS 240
+
+/*Real world to projective conversion of many joints in one pass, the same
+ * pinhole model as DepthGenerator::ConvertRealWorldToProjective() with the
+ * field of view read once instead of on every call. Points are kept as a
+ * structure of arrays, so the loop of project() is vectorized by the
+ * compiler: add() every joint of the frame, project(), then read them back
+ * by index.
+ */
+class JointProjector {
+public:
+	JointProjector();
+
+	// Intrinsics of the depth map: horizontal and vertical field of view
+	// (radians, DepthGenerator::GetFieldOfView()) and resolution
+	void setFieldOfView(double hFov, double vFov, int xRes, int yRes);
+
+	bool hasFieldOfView() const {
+		return coeff_x != 0;
+	}
+
+	void clear() {
+		count = 0;
+	}
+
+	// Adds a real world point (mm), returns its index or -1 if full
+	int add(float x, float y, float z) {
+		if (count == MAX_PROJECTED_JOINTS)
+			return -1;
+		real_x[count] = x;
+		real_y[count] = y;
+		real_z[count] = z;
+		div_z[count] = z != 0 ? z : 1; // Untracked joints are at 0
+		return count++;
+	}
+
+	// Projects every point added since clear()
+	void project();
+
+	int size() const {
+		return count;
+	}
+
+	// Depth map pixels; z stays in mm
+	float projectiveX(int i) const {
+		return proj_x[i];
+	}
+
+	float projectiveY(int i) const {
+		return proj_y[i];
+	}
+
+	float projectiveZ(int i) const {
+		return real_z[i];
+	}
+
+private:
+	float real_x[MAX_PROJECTED_JOINTS];
+	float real_y[MAX_PROJECTED_JOINTS];
+	float real_z[MAX_PROJECTED_JOINTS];
+	float div_z[MAX_PROJECTED_JOINTS]; // real_z, never 0
+	float proj_x[MAX_PROJECTED_JOINTS];
+	float proj_y[MAX_PROJECTED_JOINTS];
+	int count;
+	float coeff_x, coeff_y; // Pixels per unit of x/z and y/z
+	float half_x, half_y; // Center of the depth map
+};
+
+#endif /* JOINTPROJECTOR_H_ */
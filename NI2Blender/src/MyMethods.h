@@ -7,6 +7,10 @@
 
 #include <XnOpenNI.h>
 #include <XnCppWrapper.h>
+#include "Protocol.h"
+#include "ShmRing.h"
+#include "PracticalSocket.h"
+#include "SkeletonSnapshot.h"
 using namespace std;
 
 #ifndef METHODS_H_
@@ -18,51 +22,75 @@ int getArrayLength(T(&)[size]) {
 	return size;
 }
 
+// Stream socket to the server, for the sender thread (throws SocketException)
+CommunicatingSocket* connectStream();
+
+// Messages sent back by Blender (sender thread)
+void handleServerMessage(const Message &m);
+
 // Client socket initialization and configuration
 void initSocket(string servAddress, unsigned short servPort);
 
-void addListeners();
+// Shared memory initialization, used instead of initSocket
+void initSharedMemory(string name);
+
+// Server mode initialization, used instead of initSocket
+void initFanOut(unsigned short port);
+
+// Queues the message for the sender thread, also the sender of the core
+void sendMessage(const Message &m, void *cookie = NULL);
+
+// Hands the messages of the current frame to the sender thread
+void flushFrame();
+
+// Messages of every sensor, in capture_time order, to the sender
+void mergeDevices();
 
-void removeListeners();
+// Reads the next frame, runs the tracking and sends the data produced by it
+bool updateFrame();
 
-// Create and initialize session manager
-void initSessionManager();
+// RGB stream, only while the preview shows the RGB image
+void updateImageGenerator();
 
-// Registers session manager
-XnVHandle registerSessionManager();
+void setPreviewImage(bool show);
 
-// Unregisters session manager
-void unregisterSessionManager(XnVHandle h);
+// Capture thread (GUI only): updateFrame() until stopCapture()
+void* captureLoop(void *arg);
 
-// Extracts and sends hand position data
-void handleHandPosition(bool fix_coordinates);
+bool startCapture();
 
-// Sends hand coordinates data to socket connection
-void sendHandCoordinates(XnPoint3D h_coordinates, int is_l_hand, int is_r_hand);
+void stopCapture();
 
-void sendHeadCoordinates(XnPoint3D h_coordinates, int is_l_hand, int is_r_hand);
+// End of the playback (--playback) or of the --synthetic-frames
+bool checkPlaybackEnd();
 
-// Fix coordinates
-void fixCoordinates(XnPoint3D *c);
+bool playbackEnded();
 
-// Checks if the new point3d is valid, and stores it if so
-bool checkCoordinates(XnPoint3D *last_point3d, XnPoint3D new_point3d);
+// Sensors after the first one (--all-devices)
+void startDevices();
 
-// Checks if the new point3d is valid, and stores it if so
-void storeCoordinates(XnPoint3D *last_point3d, XnPoint3D new_point3d);
+void stopDevices();
 
-// Initializes variables to control repeated data
-void initLastPoint3d();
+// Copies the RGB image of the current frame for the preview
+void publishPreview();
 
-/*Format of data: #header|data_id|player_id|hand_id,left,right|x,y,z,ftime|gesture,p1,p2,p3#
- Formats the data and send it*/
-void formatData(char header[], int player_id, int hand_id, int l_hand,
-		int r_hand, float coordinates[3], float ftime, char gesture[],
-		float p1, float p2, float p3);
+// Copies the new depth/RGB frames into the frame ring
+void writeFrames(bool depth, bool image);
+
+void writeFrame(ShmRecordType type, const xn::MapMetaData &md,
+		const void *pixels, int bytesPerPixel);
 
 // Clean up
 void cleanUpExit();
 
+// Modes without a sensor (--fusion, --replay)
+int runFusion();
+
+int runReplay();
+
+// Reads the startup options (unknown options are left to GLUT)
+void parseArguments(int argc, char* argv[]);
+
 //-----------------------------------------------------------------------------
 // MyMethods.cpp
 //-----------------------------------------------------------------------------
@@ -77,10 +105,12 @@ void invertFloatArray(float array[], int length);
 // GUI
 //-----------------------------------------------------------------------------
 
-void glutIdle(void);
+void glutTimer(int value);
 
 void glutDisplay(void);
 
+void drawSkeleton(const SkeletonSnapshot &snapshot);
+
 void glutKeyboard (unsigned char key, int x, int y);
 
 void glInit (int * pargc, char ** argv);
@@ -0,0 +1,601 @@
+/*
+ * NetSender.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <iostream>
+#include "NetSender.h"
+
+NetSender::NetSender() {
+	sock = NULL;
+	udp = NULL;
+	ring = NULL;
+	fan_out = NULL;
+	packet_mode = false;
+	connector = NULL;
+	control_handler = NULL;
+	want_write = false;
+	replay_count = 0;
+	connect_index = 0;
+	awaiting_resume = false;
+	retry_delay = RECONNECT_MIN_DELAY;
+	connecting = false;
+	done = false;
+	lingering = false;
+	retry_timer = -1;
+	connect_timer = -1;
+	resume_timer = -1;
+	linger_timer = -1;
+	clock_timer = -1;
+	running = false;
+	stopping = false;
+	send_failed = false;
+	memset(staged, 0, sizeof(staged));
+	max_depth = 0;
+	overflow_size = 0;
+	n_deferred = 0;
+	n_coalesced = 0;
+	n_lost = 0;
+	n_connections = 0;
+	n_replayed = 0;
+	n_received = 0;
+	clock_synced = false;
+	clock_offset = 0;
+	round_trip = 0;
+	n_sent = 0;
+	n_datagrams = 0;
+	n_datagram_errors = 0;
+	datagram_seq = 1;
+}
+
+NetSender::~NetSender() {
+	stop();
+	events.deleteTimer(retry_timer);
+	events.deleteTimer(connect_timer);
+	events.deleteTimer(resume_timer);
+	events.deleteTimer(linger_timer);
+	events.deleteTimer(clock_timer);
+	events.close();
+	if (connector != NULL)
+		delete sock;
+}
+
+bool NetSender::start(CommunicatingSocket *sock, WireFormat format) {
+	if (running)
+		return true;
+	this->sock = sock;
+	encoder.setFormat(format);
+	// Where each record can be lost on its own
+	encoder.setTimePerRecord(udp != NULL || fan_out != NULL || ring != NULL);
+	stopping = false;
+	done = false;
+	lingering = false;
+	if (!events.open())
+		return false;
+	events.setWakeupHandler(this);
+	retry_timer = events.createTimer(this);
+	connect_timer = events.createTimer(this);
+	resume_timer = events.createTimer(this);
+	linger_timer = events.createTimer(this);
+	clock_timer = events.createTimer(this);
+	if (retry_timer < 0 || connect_timer < 0 || resume_timer < 0
+			|| linger_timer < 0 || clock_timer < 0)
+		return false;
+	send_failed = connector != NULL; // Connected by the sender thread
+	if (sock != NULL || connector != NULL) // A closed connection must fail
+		signal(SIGPIPE, SIG_IGN); // with EPIPE
+	if (sock != NULL) {
+		watchSocket();
+		startClockSync();
+	}
+	if (fan_out != NULL)
+		fan_out->attach(&events, this);
+	if (pthread_create(&thread, NULL, &NetSender::run, this) != 0) {
+		printf("\nCouldn't create the sender thread");
+		return false;
+	}
+	running = true;
+	return true;
+}
+
+void NetSender::stop() {
+	if (!running)
+		return;
+	publish();
+	__atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+	events.wakeup();
+	pthread_join(thread, NULL);
+	running = false;
+}
+
+bool NetSender::sendAlone(const Message &m) {
+	if (sock == NULL || failed())
+		return false;
+	char buffer[MAX_MESSAGE_SIZE];
+	int n = encoder.encode(m, buffer, sizeof(buffer));
+	if (n < 0)
+		return false;
+	try {
+		sock->setBlocking(true); // The loop isn't running anymore
+		sock->send(buffer, n);
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void NetSender::setConnector(StreamConnector connector) {
+	this->connector = connector;
+}
+
+void NetSender::setControlHandler(ControlHandler handler) {
+	control_handler = handler;
+}
+
+void NetSender::setDatagramSocket(UDPSocket *udp) {
+	this->udp = udp;
+}
+
+void NetSender::setRing(ShmRing *ring) {
+	this->ring = ring;
+}
+
+void NetSender::setFanOut(FanOutServer *fanOut) {
+	fan_out = fanOut;
+}
+
+void NetSender::setPacketMode(bool packetMode) {
+	packet_mode = packetMode;
+}
+
+// Index of the coordinates stream of the message, -1 for events
+static int coordinateStream(const Message &m) {
+	if (isReliableMessage(m.type) || m.player_id < 0 || m.player_id >= 16
+			|| m.device_id < 0 || m.device_id >= MAX_DEVICES)
+		return -1;
+	int base = m.device_id * 64 + m.player_id * 4;
+	if (m.type == MSG_HEAD_COORDINATES)
+		return base;
+	if (m.type == MSG_SKELETON)
+		return base + 3;
+	return base + (m.l_hand == 1 ? 1 : 2);
+}
+
+void NetSender::enqueue(const Message &m) {
+	int stream = coordinateStream(m);
+	if (stream >= 0) {
+		unsigned long long &mask = staged[stream / 64];
+		unsigned long long bit = 1ULL << (stream % 64);
+		if (mask & bit) // Two samples in the same frame
+			__atomic_add_fetch(&n_coalesced, 1, __ATOMIC_RELAXED);
+		latest[stream].writeBuffer() = m;
+		mask |= bit;
+		return;
+	}
+	// Keeps the order: once something is in the overflow list, so is the rest
+	if (!overflow.empty() || !queue.push(m)) {
+		overflow.push_back(m);
+		__atomic_add_fetch(&n_deferred, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&overflow_size, overflow.size(), __ATOMIC_RELAXED);
+	}
+}
+
+void NetSender::publish() {
+	while (!overflow.empty() && queue.push(overflow.front()))
+		overflow.pop_front();
+	__atomic_store_n(&overflow_size, overflow.size(), __ATOMIC_RELAXED);
+	queue.publish();
+	for (int device = 0; device < MAX_DEVICES; device++) {
+		unsigned long long &mask = staged[device];
+		for (int i = 0; mask != 0; i++) {
+			unsigned long long bit = 1ULL << i;
+			if ((mask & bit) == 0)
+				continue;
+			// The sender didn't get the last one
+			if (latest[device * 64 + i].publish())
+				__atomic_add_fetch(&n_coalesced, 1, __ATOMIC_RELAXED);
+			mask &= ~bit;
+		}
+	}
+	unsigned int depth = queue.size();
+	if (depth > max_depth)
+		__atomic_store_n(&max_depth, depth, __ATOMIC_RELAXED);
+	events.wakeup();
+}
+
+void* NetSender::run(void *arg) {
+	((NetSender*) arg)->loop();
+	return NULL;
+}
+
+void NetSender::loop() {
+	if (connector != NULL)
+		reconnect();
+	while (!done)
+		if (!events.poll(-1))
+			break;
+}
+
+void NetSender::handleEvent(int fd, uint32_t ev) {
+	if (fd == retry_timer) {
+		reconnect();
+	} else if (fd == connect_timer) {
+		if (connecting) {
+			printf("\nConnection to the server timed out");
+			abortConnect();
+		}
+	} else if (fd == resume_timer) {
+		endResumeWait(false, 0); // An old server that doesn't send it
+		writeOutput();
+	} else if (fd == linger_timer) {
+		done = true; // The server didn't take the rest
+	} else if (fd == clock_timer) {
+		sendPing();
+	} else if (sock != NULL && fd == sock->getDescriptor() && connecting) {
+		finishConnect(); // Writable (or failed)
+	} else if (sock != NULL && fd == sock->getDescriptor()) {
+		if (ev & EPOLLIN)
+			readInput();
+		if ((ev & EPOLLOUT) && sock != NULL)
+			writeOutput();
+		if ((ev & (EPOLLERR | EPOLLHUP)) && sock != NULL && !(ev & EPOLLIN))
+			disconnect();
+	} else if (fan_out == NULL || !fan_out->dispatch(fd, ev)) {
+		drain(); // Wakeup: publish() or stop()
+	}
+	checkStopped();
+}
+
+// Sends everything published so far: events first, then the newest sample of
+// each coordinates stream
+void NetSender::drain() {
+	Message *m;
+	while ((m = queue.front()) != NULL) {
+		send(*m);
+		queue.pop();
+	}
+	for (int stream = 0; stream < MAX_COORDINATE_STREAMS; stream++) {
+		if (latest[stream].update())
+			send(latest[stream].readBuffer());
+	}
+	writeOutput();
+	if (fan_out != NULL)
+		fan_out->publish();
+}
+
+// After stop(), leaves the loop once the server and the subscribers have
+// taken everything (or STOP_LINGER_TIME passed)
+void NetSender::checkStopped() {
+	if (done || !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+		return;
+	if (queue.size() != 0)
+		return;
+	if (awaiting_resume) {
+		endResumeWait(false, 0);
+		writeOutput();
+	}
+	bool empty = (sock == NULL || failed() || output.isEmpty()) && (fan_out
+			== NULL || fan_out->isEmpty());
+	if (empty) {
+		done = true;
+	} else if (!lingering) {
+		lingering = true;
+		events.setTimer(linger_timer, STOP_LINGER_TIME);
+	}
+}
+
+void NetSender::send(const Message &m) {
+	if (ring != NULL) {
+		writeRecord(m);
+	} else if (fan_out != NULL) {
+		broadcast(m);
+	} else if (udp != NULL && !isReliableMessage(m.type)) {
+		sendDatagram(m);
+	} else {
+		if (isReliableMessage(m.type)) // Kept even if lost now
+			replay_buffer[replay_count++ & (REPLAY_BUFFER_SIZE - 1)] = m;
+		sendStream(m);
+	}
+}
+
+void NetSender::sendStream(const Message &m) {
+	if (sock == NULL || failed()) {
+		__atomic_add_fetch(&n_lost, 1, __ATOMIC_RELAXED);
+	} else if (awaiting_resume) {
+		// Events wait in the replay buffer, coordinates would be stale
+		if (!isReliableMessage(m.type))
+			__atomic_add_fetch(&n_lost, 1, __ATOMIC_RELAXED);
+	} else if (!isReliableMessage(m.type) && output.size() > MAX_OUTPUT_BACKLOG) {
+		__atomic_add_fetch(&n_lost, 1, __ATOMIC_RELAXED);
+	} else {
+		appendStream(m);
+	}
+}
+
+void NetSender::appendStream(const Message &m) {
+	char *p = output.reserve(MAX_MESSAGE_SIZE);
+	int n = encoder.encode(m, p, MAX_MESSAGE_SIZE);
+	if (n < 0) {
+		printf("\nCouldn't encode message %d", m.data_id);
+		return;
+	}
+	if (n > 0) // 0: nothing changed (skeleton)
+		output.commit(n);
+}
+
+// Writes what the socket takes, EPOLLOUT stays on while something is left
+void NetSender::writeOutput() {
+	if (sock == NULL || failed() || output.isEmpty())
+		return;
+	int before = output.messages();
+	bool empty;
+	try {
+		empty = output.write(*sock, packet_mode);
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		__atomic_add_fetch(&n_sent, before - output.messages(),
+				__ATOMIC_RELAXED);
+		disconnect();
+		return;
+	}
+	__atomic_add_fetch(&n_sent, before - output.messages(), __ATOMIC_RELAXED);
+	if (empty == want_write) {
+		want_write = !empty;
+		events.modify(sock->getDescriptor(), EPOLLIN | (want_write
+				? (uint32_t) EPOLLOUT : 0));
+	}
+}
+
+// Control channel: what the server sends back
+void NetSender::readInput() {
+	try {
+		if (!input.read(*sock)) {
+			printf("\nThe server closed the connection");
+			disconnect();
+			return;
+		}
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		disconnect();
+		return;
+	}
+	uint64_t now = monotonicMicros();
+	Message m;
+	while (sock != NULL && input.next(m)) {
+		__atomic_add_fetch(&n_received, 1, __ATOMIC_RELAXED);
+		handleControl(m, now);
+	}
+}
+
+void NetSender::handleControl(const Message &m, uint64_t receiveTime) {
+	if (m.type == MSG_RESUME) {
+		if (awaiting_resume) {
+			endResumeWait(true, m.data_id);
+			writeOutput();
+		}
+	} else if (m.type == MSG_PING) {
+		Message pong;
+		ClockSync::makePong(m, receiveTime, pong);
+		appendStream(pong);
+		writeOutput();
+	} else if (m.type == MSG_PONG) {
+		if (clock.handlePong(m, receiveTime)) {
+			__atomic_store_n(&clock_offset, clock.offset(), __ATOMIC_RELAXED);
+			__atomic_store_n(&round_trip, clock.roundTrip(), __ATOMIC_RELAXED);
+			__atomic_store_n(&clock_synced, true, __ATOMIC_RELEASE);
+		}
+	} else if (control_handler != NULL) {
+		control_handler(m);
+	}
+}
+
+void NetSender::watchSocket() {
+	try {
+		sock->setBlocking(false);
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+	}
+	want_write = false;
+	events.add(sock->getDescriptor(), EPOLLIN, this);
+}
+
+// A burst of pings right away for a first estimate, then a slower refresh
+void NetSender::startClockSync() {
+	clock.reset();
+	__atomic_store_n(&clock_synced, false, __ATOMIC_RELEASE);
+	sendPing();
+	events.setTimer(clock_timer, CLOCK_SYNC_BURST_INTERVAL, true);
+}
+
+void NetSender::sendPing() {
+	if (sock == NULL || failed())
+		return;
+	if (!clock.isSynchronized() && clock.unanswered() >= CLOCK_SYNC_BURST) {
+		printf("\nThe server doesn't answer pings");
+		events.setTimer(clock_timer, 0);
+		return;
+	}
+	if (clock.pings() == CLOCK_SYNC_BURST)
+		events.setTimer(clock_timer, CLOCK_SYNC_INTERVAL, true);
+	if (output.size() > MAX_OUTPUT_BACKLOG)
+		return; // It would measure the backlog
+	Message m;
+	clock.makePing(m);
+	appendStream(m);
+	writeOutput();
+}
+
+// The connection failed: what wasn't written is lost, and with a connector a
+// new one is tried after the backoff delay
+void NetSender::disconnect() {
+	__atomic_add_fetch(&n_lost, output.messages(), __ATOMIC_RELAXED);
+	__atomic_store_n(&send_failed, true, __ATOMIC_RELEASE);
+	output.clear();
+	input.clear();
+	awaiting_resume = false;
+	events.setTimer(resume_timer, 0);
+	events.setTimer(clock_timer, 0);
+	__atomic_store_n(&clock_synced, false, __ATOMIC_RELEASE);
+	events.remove(sock->getDescriptor());
+	if (connector == NULL)
+		return; // Not ours, it stays failed like before
+	delete sock;
+	sock = NULL;
+	if (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+		events.setTimer(retry_timer, retry_delay);
+}
+
+// Starts a connection, finishConnect() goes on once the socket is writable
+void NetSender::reconnect() {
+	if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+		return;
+	CommunicatingSocket *s;
+	try {
+		s = connector();
+	} catch (SocketException &e) {
+		retryLater();
+		return;
+	}
+	sock = s;
+	connecting = true;
+	events.add(sock->getDescriptor(), EPOLLOUT, this);
+	events.setTimer(connect_timer, CONNECT_TIMEOUT);
+}
+
+// The connection attempt failed (or took too long)
+void NetSender::abortConnect() {
+	connecting = false;
+	events.setTimer(connect_timer, 0);
+	events.remove(sock->getDescriptor());
+	delete sock;
+	sock = NULL;
+	retryLater();
+}
+
+void NetSender::retryLater() {
+	if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+		return;
+	events.setTimer(retry_timer, retry_delay);
+	retry_delay = retry_delay * 2 < RECONNECT_MAX_DELAY ? retry_delay * 2
+			: RECONNECT_MAX_DELAY;
+}
+
+void NetSender::finishConnect() {
+	try {
+		sock->finishConnect();
+	} catch (SocketException &e) {
+		abortConnect();
+		return;
+	}
+	connecting = false;
+	events.setTimer(connect_timer, 0);
+	want_write = false;
+	events.modify(sock->getDescriptor(), EPOLLIN);
+	retry_delay = RECONNECT_MIN_DELAY;
+	encoder.reset(); // Compact deltas start over on a new connection
+	__atomic_add_fetch(&n_connections, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&send_failed, false, __ATOMIC_RELEASE);
+	printf("\nConnected to the server");
+
+	// Events are held until the server says what it already has
+	awaiting_resume = true;
+	connect_index = replay_count;
+	events.setTimer(resume_timer, RESUME_TIMEOUT);
+	startClockSync();
+}
+
+// With the server's MSG_RESUME the events after lastId still in the replay
+// buffer are sent again; without it only the ones held since connecting.
+void NetSender::endResumeWait(bool resumed, int lastId) {
+	awaiting_resume = false;
+	events.setTimer(resume_timer, 0);
+	unsigned int kept = replay_count < REPLAY_BUFFER_SIZE ? replay_count
+			: REPLAY_BUFFER_SIZE;
+	unsigned int held = replay_count - connect_index; // Since connecting
+	unsigned int n = resumed || held > kept ? kept : held;
+	for (unsigned int i = replay_count - n; i != replay_count; i++) {
+		const Message &m = replay_buffer[i & (REPLAY_BUFFER_SIZE - 1)];
+		if (resumed && m.data_id <= lastId)
+			continue;
+		appendStream(m);
+		if (replay_count - i > held) // Produced before this connection
+			__atomic_add_fetch(&n_replayed, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// Encoded once, then copied to every subscriber's output
+void NetSender::broadcast(const Message &m) {
+	char buffer[MAX_MESSAGE_SIZE];
+	int n = encoder.encode(m, buffer, sizeof(buffer));
+	if (n < 0) {
+		printf("\nCouldn't encode message %d", m.data_id);
+	} else if (n > 0) {
+		fan_out->broadcast(buffer, n, isReliableMessage(m.type));
+		__atomic_add_fetch(&n_sent, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// One message per datagram, so a lost datagram never splits a message
+// The data_id of a datagram is its sequence number on the socket, so a gap
+// is a lost datagram (a failed send too), not a coalesced sample
+void NetSender::sendDatagram(const Message &m) {
+	char buffer[MAX_MESSAGE_SIZE];
+	Message d = m;
+	d.data_id = datagram_seq;
+	int n = encoder.encode(d, buffer, sizeof(buffer));
+	if (n < 0) {
+		printf("\nCouldn't encode message %d", m.data_id);
+		return;
+	}
+	if (n == 0)
+		return;
+	datagram_seq++;
+	try {
+		udp->send(buffer, n);
+		__atomic_add_fetch(&n_datagrams, 1, __ATOMIC_RELAXED);
+	} catch (SocketException &e) {
+		// e.g. ECONNREFUSED while nobody listens, the next one may succeed
+		__atomic_add_fetch(&n_datagram_errors, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// Encodes the message in place, a full ring (reader behind) loses it
+void NetSender::writeRecord(const Message &m) {
+	char *record = ring->reserve(MAX_MESSAGE_SIZE);
+	if (record == NULL) {
+		__atomic_add_fetch(&n_lost, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	int n = encoder.encode(m, record, MAX_MESSAGE_SIZE);
+	if (n < 0) {
+		printf("\nCouldn't encode message %d", m.data_id);
+		return;
+	}
+	if (n == 0)
+		return;
+	ring->commit(SHM_RECORD_MESSAGE, n);
+	__atomic_add_fetch(&n_sent, 1, __ATOMIC_RELAXED);
+}
+
+void NetSender::printStats() const {
+	printf("\nSender: %lu sent, %lu coalesced, %lu deferred (queue full), "
+		"%lu lost, queue depth %u (max %u of %u)", sent(), coalesced(),
+			deferred(), lost(), queueDepth(), maxQueueDepth(),
+			queue.capacity());
+	if (connector != NULL)
+		printf("\nSender: %lu connections, %lu events replayed, %lu "
+			"messages received", connections(), replayed(), received());
+	if (udp != NULL)
+		printf("\nSender: %lu datagrams, %lu datagram errors",
+				datagramsSent(), datagramErrors());
+	if (clockSynchronized())
+		printf("\nSender: server clock offset %lld us, round trip %lld us",
+				(long long) clockOffset(), (long long) roundTripTime());
+}
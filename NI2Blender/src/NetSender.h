@@ -0,0 +1,302 @@
+/*
+ * NetSender.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef NETSENDER_H_
+#define NETSENDER_H_
+
+#include <pthread.h>
+#include <deque>
+#include "Protocol.h"
+#include "EventLoop.h"
+#include "ConnectionBuffer.h"
+#include "ClockSync.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "PracticalSocket.h"
+#include "ShmRing.h"
+#include "FanOutServer.h"
+
+// Events waiting to be sent (power of two)
+#define SEND_QUEUE_SIZE 256
+
+// Coordinates streams: MAX_DEVICES x 16 players x (head, left hand, right
+// hand, skeleton), one bit each in a 64 bit mask per device
+#define MAX_COORDINATE_STREAMS (MAX_DEVICES * 64)
+
+// Last events kept to send again after a reconnection (power of two)
+#define REPLAY_BUFFER_SIZE 64
+
+// Delay between connection attempts, doubled after each failure (ms)
+#define RECONNECT_MIN_DELAY 100
+#define RECONNECT_MAX_DELAY 5000
+
+// How long a connection attempt may take before it is given up (ms)
+#define CONNECT_TIMEOUT 2000
+
+// How long to wait for the server's MSG_RESUME after connecting (ms)
+#define RESUME_TIMEOUT 500
+
+// Bytes waiting for a slow server beyond which coordinates are dropped
+#define MAX_OUTPUT_BACKLOG (64 * 1024)
+
+// How long stop() keeps writing what the server (or the fan-out
+// subscribers) hasn't taken yet (ms)
+#define STOP_LINGER_TIME 1000
+
+// Opens a new stream socket and starts connecting it without waiting
+// (CommunicatingSocket::startConnect()), throws SocketException if it can't
+typedef CommunicatingSocket* (*StreamConnector)();
+
+// Called on the sender thread for each message the server sends back
+typedef void (*ControlHandler)(const Message &m);
+
+/*Sends the messages on its own thread, so the capture thread (GLUT/NITE
+ * callbacks) never blocks on the socket. The capture thread is the only
+ * producer: it enqueue()s the messages of a frame and publish()es them at the
+ * end of it. The sender thread is an EventLoop: the stream socket is
+ * non-blocking, what it doesn't take is kept in an OutputBuffer and written
+ * when it becomes writable, and what the server sends back (control channel)
+ * is read in the same loop, along with the reconnection timers.
+ * Messages are scheduled by class:
+ * - events (session, user, gesture) are reliable: they go through the queue
+ *   (or a private overflow list when it is full, never dropped) and are sent
+ *   before any coordinates;
+ * - coordinates are "latest value wins": each hand/head/skeleton stream has a
+ *   triple buffer, and a sample not sent yet is replaced (coalesced) by a
+ *   newer one. A skeleton carries every joint, the encoder leaves out the
+ *   ones that didn't change since the last one it sent, so none is lost.
+ * With a datagram socket, coordinates are sent one per datagram and only
+ * events go to the stream socket. A datagram's data_id is replaced by its
+ * sequence number on the socket, so a gap means a lost datagram: the data_ids
+ * on the stream socket have gaps of their own (coalesced samples, unchanged
+ * skeletons, the coordinates sent as datagrams).
+ * With a shared memory ring every message is encoded straight into it, and
+ * with a fan-out server it is encoded once and its bytes are copied into the
+ * output buffer of every subscriber (see FanOutServer).
+ * With a connector the sender opens the stream socket itself and, when it
+ * fails, keeps trying again with backoff while the capture goes on; the
+ * connection is made without blocking the loop, so the events published
+ * meanwhile keep being taken from the queue (into the replay buffer). After
+ * each connection the server may answer with a MSG_RESUME carrying the last
+ * event it got, and the newer events still in the replay buffer are sent
+ * again; without it nothing is replayed. Events produced while waiting for
+ * the MSG_RESUME are held, so they are sent after the replayed ones.
+ * On the stream socket the sender also pings the server (ClockSync) to
+ * estimate the offset between their clocks and the round trip time, and
+ * answers the server's pings; a server that never answers isn't pinged again
+ * until the next connection.
+ */
+class NetSender: private EventHandler {
+public:
+	NetSender();
+	~NetSender();
+
+	// Starts the sender thread writing to sock (NULL with setRing() or
+	// setConnector())
+	bool start(CommunicatingSocket *sock, WireFormat format);
+
+	// Sends what is still queued and stops the thread
+	void stop();
+
+	// Sends m right away as a write of its own, after stop() (exit flag)
+	bool sendAlone(const Message &m);
+
+	// Messages from the server other than MSG_RESUME go to handler. Call
+	// before start().
+	void setControlHandler(ControlHandler handler);
+
+	// The sender thread connects (and reconnects) the stream socket with
+	// connector, and owns it. Call before start().
+	void setConnector(StreamConnector connector);
+
+	// Sends coordinates through udp (already connected to the receiver or
+	// multicast group) instead of the stream socket. Call before start().
+	void setDatagramSocket(UDPSocket *udp);
+
+	// Writes every message into ring instead of a socket. Call before start().
+	void setRing(ShmRing *ring);
+
+	// Sends every message to the subscribers of fanOut instead of a socket.
+	// Call before start().
+	void setFanOut(FanOutServer *fanOut);
+
+	// The stream socket keeps message boundaries (UnixSocket), so each
+	// message is sent as its own packet. Call before start().
+	void setPacketMode(bool packetMode);
+
+	//-------------------------------------------------------------------------
+	// Capture thread
+	//-------------------------------------------------------------------------
+
+	// Queues the message (events) or replaces the pending sample of its
+	// stream (coordinates)
+	void enqueue(const Message &m);
+
+	// Hands the queued messages to the sender thread
+	void publish();
+
+	//-------------------------------------------------------------------------
+	// Counters (any thread)
+	//-------------------------------------------------------------------------
+
+	// Events waiting, including the ones in the overflow list
+	unsigned int queueDepth() const {
+		return queue.size() + __atomic_load_n(&overflow_size,
+				__ATOMIC_RELAXED);
+	}
+
+	unsigned int maxQueueDepth() const {
+		return __atomic_load_n(&max_depth, __ATOMIC_RELAXED);
+	}
+
+	// Events that waited in the overflow list because the queue was full
+	unsigned long deferred() const {
+		return __atomic_load_n(&n_deferred, __ATOMIC_RELAXED);
+	}
+
+	// Coordinates replaced by a newer sample before being sent
+	unsigned long coalesced() const {
+		return __atomic_load_n(&n_coalesced, __ATOMIC_RELAXED);
+	}
+
+	// Discarded because the socket failed, or coordinates the server was too
+	// slow to take
+	unsigned long lost() const {
+		return __atomic_load_n(&n_lost, __ATOMIC_RELAXED);
+	}
+
+	// Connections opened with the connector, and events sent again
+	unsigned long connections() const {
+		return __atomic_load_n(&n_connections, __ATOMIC_RELAXED);
+	}
+
+	unsigned long replayed() const {
+		return __atomic_load_n(&n_replayed, __ATOMIC_RELAXED);
+	}
+
+	unsigned long sent() const {
+		return __atomic_load_n(&n_sent, __ATOMIC_RELAXED);
+	}
+
+	// Datagrams sent and failed (a failed datagram doesn't stop the sender)
+	unsigned long datagramsSent() const {
+		return __atomic_load_n(&n_datagrams, __ATOMIC_RELAXED);
+	}
+
+	unsigned long datagramErrors() const {
+		return __atomic_load_n(&n_datagram_errors, __ATOMIC_RELAXED);
+	}
+
+	// The stream socket failed (or isn't connected yet)
+	bool failed() const {
+		return __atomic_load_n(&send_failed, __ATOMIC_ACQUIRE);
+	}
+
+	void printStats() const;
+
+	// Messages received from the server
+	unsigned long received() const {
+		return __atomic_load_n(&n_received, __ATOMIC_RELAXED);
+	}
+
+	// The server answered a ping on the current connection
+	bool clockSynchronized() const {
+		return __atomic_load_n(&clock_synced, __ATOMIC_ACQUIRE);
+	}
+
+	// Server clock - our CLOCK_MONOTONIC (us), and round trip time (us)
+	int64_t clockOffset() const {
+		return __atomic_load_n(&clock_offset, __ATOMIC_RELAXED);
+	}
+
+	int64_t roundTripTime() const {
+		return __atomic_load_n(&round_trip, __ATOMIC_RELAXED);
+	}
+
+private:
+	static void* run(void *arg);
+	void loop();
+	void handleEvent(int fd, uint32_t events);
+	void drain();
+	void send(const Message &m);
+	void sendDatagram(const Message &m);
+	void writeRecord(const Message &m);
+	void broadcast(const Message &m);
+	void sendStream(const Message &m);
+	void appendStream(const Message &m);
+	void writeOutput();
+	void readInput();
+	void handleControl(const Message &m, uint64_t receiveTime);
+	void watchSocket();
+	void startClockSync();
+	void sendPing();
+	void disconnect();
+	void reconnect();
+	void finishConnect();
+	void abortConnect();
+	void retryLater();
+	void endResumeWait(bool resumed, int lastId);
+	void checkStopped();
+
+	SpscQueue<Message, SEND_QUEUE_SIZE> queue; // Events
+	std::deque<Message> overflow; // Events, capture thread only
+	TripleBuffer<Message> latest[MAX_COORDINATE_STREAMS]; // Coordinates
+	// Streams written in this frame (capture), one mask per device
+	unsigned long long staged[MAX_DEVICES];
+	CommunicatingSocket *sock;
+	UDPSocket *udp;
+	ShmRing *ring;
+	FanOutServer *fan_out;
+	MessageEncoder encoder; // Used only by the sender thread
+	bool packet_mode;
+
+	// Used only by the sender thread
+	StreamConnector connector;
+	ControlHandler control_handler;
+	OutputBuffer output;
+	InputBuffer input;
+	bool want_write; // EPOLLOUT is on
+	Message replay_buffer[REPLAY_BUFFER_SIZE]; // Last events sent or lost
+	unsigned int replay_count; // Events ever added to replay_buffer
+	unsigned int connect_index; // replay_count when the connection opened
+	bool awaiting_resume;
+	int retry_delay;
+	bool connecting; // sock is being connected, waiting for EPOLLOUT
+	bool done; // Leaves the loop
+	bool lingering; // Writing the rest after stop()
+
+	EventLoop events;
+	int retry_timer;
+	int connect_timer;
+	int resume_timer;
+	int linger_timer;
+	int clock_timer;
+	ClockSync clock;
+
+	pthread_t thread;
+	bool running;
+	bool stopping;
+	bool send_failed;
+
+	unsigned int max_depth;
+	unsigned int overflow_size;
+	unsigned long n_deferred;
+	unsigned long n_coalesced;
+	unsigned long n_lost;
+	unsigned long n_connections;
+	unsigned long n_replayed;
+	unsigned long n_received;
+	bool clock_synced;
+	int64_t clock_offset;
+	int64_t round_trip;
+	unsigned long n_sent;
+	unsigned long n_datagrams;
+	unsigned long n_datagram_errors;
+	uint32_t datagram_seq; // data_id of the next datagram, sender thread
+};
+
+#endif /* NETSENDER_H_ */
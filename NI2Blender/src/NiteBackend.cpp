@@ -0,0 +1,692 @@
+/*
+ * NiteBackend.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "NiteBackend.h"
+#include "UserTable.h"
+
+using namespace xn;
+
+#define CHECK_RC(rc, what)											\
+		if (rc != XN_STATUS_OK)											\
+		{																\
+			printf("%s failed: %s\n", what, xnGetStatusString(rc));		\
+			return rc;													\
+		}
+
+const XnSkeletonJoint NITE_SKELETON_JOINTS[SKELETON_JOINTS] = { XN_SKEL_HEAD,
+		XN_SKEL_NECK, XN_SKEL_TORSO, XN_SKEL_LEFT_SHOULDER, XN_SKEL_LEFT_ELBOW,
+		XN_SKEL_LEFT_HAND, XN_SKEL_RIGHT_SHOULDER, XN_SKEL_RIGHT_ELBOW,
+		XN_SKEL_RIGHT_HAND, XN_SKEL_LEFT_HIP, XN_SKEL_LEFT_KNEE,
+		XN_SKEL_LEFT_FOOT, XN_SKEL_RIGHT_HIP, XN_SKEL_RIGHT_KNEE,
+		XN_SKEL_RIGHT_FOOT };
+
+// For debugging purposes
+static XnBool _printGesture = false;
+static XnBool _printCircle = false;
+static XnBool _printUserTracking = true;
+
+// Resolution of the depth and RGB maps
+static const int res_x = XN_VGA_X_RES;
+static const int res_y = XN_VGA_Y_RES;
+
+NiteBackend::NiteBackend(bool mirror, bool fullSkeleton) {
+	this->mirror = mirror;
+	full_skeleton = fullSkeleton;
+	feature_gesture = true;
+	feature_circle = true;
+	playback_speed = 1.0;
+	device_index = -1;
+	listener = NULL;
+	recording_image = false;
+	session_manager = NULL;
+	broadcaster = NULL;
+	wave_detector = NULL;
+	push_detector = NULL;
+	circle_detector = NULL;
+	swipe_detector = NULL;
+	steady_detector = NULL;
+	session_handle = 0;
+	session_initialized = false;
+	session_registered = false;
+	in_session = false;
+	need_pose = false;
+	pose[0] = '\0';
+	for (int i = 0; i < MAX_USERS; i++)
+		calibrated[i] = false;
+	n_calibrated = 0;
+	last_depth_frame = 0;
+	last_user_frame = 0;
+	last_image_frame = 0;
+	started = false;
+}
+
+NiteBackend::~NiteBackend() {
+	stop();
+}
+
+bool NiteBackend::start(SensorListener *listener) {
+	this->listener = listener;
+	started = true; // stop() releases whatever was created
+	XnStatus rc = context.Init();
+	if (rc != XN_STATUS_OK) {
+		printf("Initialize context failed: %s\n", xnGetStatusString(rc));
+		return false;
+	}
+
+	if (!playback_file.empty()) {
+		// The recording's depth node, already mirrored (or not) and in the
+		// recorded mode
+		if (openPlayback() != XN_STATUS_OK)
+			return false;
+	} else if (device_index >= 0) {
+		context.SetGlobalMirror(mirror);
+		if (openDevice() != XN_STATUS_OK)
+			return false;
+	} else {
+		context.SetGlobalMirror(mirror);
+
+		// Create the depth generator
+		rc = depth.Create(context);
+		if (rc == XN_STATUS_OK) {
+			// Set it to VGA maps at 30 FPS (Depth image)
+			XnMapOutputMode mode;
+			mode.nXRes = res_x;
+			mode.nYRes = res_y;
+			mode.nFPS = 30;
+			rc = depth.SetMapOutputMode(mode);
+		}
+		if (rc != XN_STATUS_OK) {
+			printf("Create depth generator failed: %s\n", xnGetStatusString(
+					rc));
+			return false;
+		}
+	}
+
+	// The image generator is only created for the preview (see setImage)
+
+	if (device_index < 0) {
+		// Create the hands generator
+		rc = hands.Create(context);
+		if (rc == XN_STATUS_OK) // Smoothing hand movements
+			rc = hands.SetSmoothing(KINECT_SMOOTHING_HANDS);
+		// Create the gesture and user generators
+		if (rc == XN_STATUS_OK)
+			rc = gesture.Create(context);
+		if (rc == XN_STATUS_OK)
+			rc = user.Create(context);
+	} else {
+		// The user generator of this sensor's depth map
+		Query query;
+		query.AddNeededNode(depth.GetName());
+		rc = user.Create(context, &query);
+		feature_gesture = false;
+		feature_circle = false;
+	}
+	if (rc != XN_STATUS_OK) {
+		printf("Create NITE generators failed: %s\n", xnGetStatusString(rc));
+		return false;
+	}
+
+	//---------------------------------------------------------------//
+	//------------------------- SETUP FEATURES ---------------------//
+	//--------------------------------------------------------------//
+
+	// Feature Gesture.
+	if (feature_gesture) {
+		// Wave detector.
+		wave_detector = new XnVWaveDetector();//TODO: Check both ways this gesture
+		//wave_detector->SetMinLength(25); // The length (in mm) of the motion before a direction change (a flip)
+		wave_detector->RegisterWave(this, &wave);
+
+		// Push detector.
+		push_detector = new XnVPushDetector();
+		push_detector->SetPushImmediateDuration(400); // Change the time used to detect push (ms)
+		push_detector->SetPushImmediateMinimumVelocity(0.35f); // To test
+		push_detector->RegisterPush(this, &push);
+
+		// Swipe detector.
+		swipe_detector = new XnVSwipeDetector();
+		swipe_detector->SetMotionTime(700); // Minimal duration to recognize as swipe (ms)
+		swipe_detector->SetMotionSpeedThreshold(0.55f); // Minimal speed to recognize as a swipe (m/s)
+		swipe_detector->RegisterSwipeUp(this, &swipeUp);
+		swipe_detector->RegisterSwipeDown(this, &swipeDown);
+		swipe_detector->RegisterSwipeLeft(this, &swipeLeft);
+		swipe_detector->RegisterSwipeRight(this, &swipeRight);
+
+		// Steady detector.
+		steady_detector = new XnVSteadyDetector();
+		steady_detector->SetDetectionDuration(800); // The time it takes to detect steady state (ms) - The previus value was 1000up
+		steady_detector->RegisterSteady(this, &steady);
+	}
+
+	// Feature Circle.
+	if (feature_circle) {
+		// Circle detector.
+		circle_detector = new XnVCircleDetector();
+		circle_detector->SetMinimumPoints(16); // Minimum number of points to consider a circle
+		circle_detector->RegisterCircle(this, &circle);
+		circle_detector->RegisterNoCircle(this, &noCircle);
+	}
+
+	// Feature User Tracking: every user is calibrated and tracked
+	if (!user.IsCapabilitySupported(XN_CAPABILITY_SKELETON)) {
+		printf("\nSupplied user generator doesn't support skeleton");
+		return false;
+	}
+	XnCallbackHandle hUserCallbacks, hCalibrationStart, hCalibrationComplete,
+			hPoseDetected;
+	user.RegisterUserCallbacks(newUser, lostUser, this, hUserCallbacks);
+	user.RegisterToUserExit(userExit, this, hUserCallbacks);
+	user.RegisterToUserReEnter(userReEnter, this, hUserCallbacks);
+	user.GetSkeletonCap().RegisterToCalibrationStart(calibrationStart, this,
+			hCalibrationStart);
+	user.GetSkeletonCap().RegisterToCalibrationComplete(calibrationComplete,
+			this, hCalibrationComplete);
+	if (user.GetSkeletonCap().NeedPoseForCalibration()) {
+		printf("\nPose required!");
+		need_pose = true;
+		if (!user.IsCapabilitySupported(XN_CAPABILITY_POSE_DETECTION)) {
+			printf("\nPose required, but not supported.");
+			return false;
+		}
+		user.GetPoseDetectionCap().RegisterToPoseDetected(poseDetected, this,
+				hPoseDetected);
+		user.GetSkeletonCap().GetCalibrationPose(pose);
+	}
+	user.GetSkeletonCap().SetSkeletonProfile(full_skeleton
+			? XN_SKEL_PROFILE_ALL : XN_SKEL_PROFILE_HEAD_HANDS);
+	user.GetSkeletonCap().SetSmoothing(KINECT_SMOOTHING_SKELETON);
+
+	// Record mode: the frames go to the file as the context reads them
+	if (!record_file.empty() && startRecording() != XN_STATUS_OK)
+		return false;
+
+	// Create the broadcaster manager.
+	broadcaster = new XnVBroadcaster();
+
+	// Start generating all
+	rc = context.StartGeneratingAll();
+	if (rc != XN_STATUS_OK) {
+		printf("Start Generating All failed: %s\n", xnGetStatusString(rc));
+		return false;
+	}
+	return true;
+}
+
+void NiteBackend::stop() {
+	if (!started)
+		return;
+	started = false;
+	if (in_session)
+		removeListeners();
+	in_session = false;
+	if (NULL != session_manager) {
+		if (session_registered)
+			unregisterSessionManager();
+		delete session_manager;
+		session_manager = NULL;
+	}
+	session_initialized = false;
+	delete broadcaster;
+	delete wave_detector;
+	delete push_detector;
+	delete swipe_detector;
+	delete steady_detector;
+	delete circle_detector;
+	broadcaster = NULL;
+	wave_detector = NULL;
+	push_detector = NULL;
+	swipe_detector = NULL;
+	steady_detector = NULL;
+	circle_detector = NULL;
+
+	recorder.Release(); // Closes the file
+	image.Release();
+	depth.Release();
+	hands.Release();
+	gesture.Release();
+	user.Release();
+	player.Release();
+	device.Release();
+	context.Release();
+}
+
+// Returns true if generator has data newer than last (and remembers it)
+static bool isNewFrame(const Generator &generator, XnUInt32 &last) {
+	if (!generator.IsValid())
+		return false;
+	XnUInt32 id = generator.GetFrameID();
+	if (id == last)
+		return false;
+	last = id;
+	return true;
+}
+
+// Reads the next frame and runs NITE on it. WaitAnyUpdateAll() wakes up when
+// any node has new data, the session manager only runs on a new depth frame.
+bool NiteBackend::update(SensorUpdate &u) {
+	XnStatus rc = context.WaitAnyUpdateAll();
+	if (rc != XN_STATUS_OK) {
+		if (!atEnd())
+			printf("Read failed: %s\n", xnGetStatusString(rc));
+		return false;
+	}
+	u.new_depth = isNewFrame(depth, last_depth_frame);
+	u.new_user = isNewFrame(user, last_user_frame);
+	u.new_image = isNewFrame(image, last_image_frame);
+	u.frame_id = depth.GetFrameID();
+	u.sensor_time = depth.GetTimestamp();
+	if (u.new_depth && session_initialized)
+		session_manager->Update(&context);
+	return true;
+}
+
+bool NiteBackend::atEnd() const {
+	return !playback_file.empty() && player.IsEOF();
+}
+
+uint64_t NiteBackend::timestamp() const {
+	return depth.GetTimestamp();
+}
+
+void NiteBackend::getFieldOfView(double &hFov, double &vFov) const {
+	XnFieldOfView fov;
+	XnStatus rc = depth.GetFieldOfView(fov);
+	if (rc != XN_STATUS_OK)
+		printf("Get field of view of depth generator failed: %s\n",
+				xnGetStatusString(rc));
+	hFov = fov.fHFOV;
+	vFov = fov.fVFOV;
+}
+
+void NiteBackend::getResolution(int &xRes, int &yRes) const {
+	xRes = res_x;
+	yRes = res_y;
+}
+
+bool NiteBackend::isTracking(int id) {
+	return user.GetSkeletonCap().IsTracking(id);
+}
+
+void NiteBackend::getJoint(int id, int joint, SensorJoint &j) {
+	XnSkeletonJointTransformation t;
+	user.GetSkeletonCap().GetSkeletonJoint(id, NITE_SKELETON_JOINTS[joint], t);
+	j.position[0] = t.position.position.X;
+	j.position[1] = t.position.position.Y;
+	j.position[2] = t.position.position.Z;
+	j.confidence = t.position.fConfidence;
+	for (int i = 0; i < 9; i++)
+		j.orientation[i] = t.orientation.orientation.elements[i];
+	j.orientation_confidence = t.orientation.fConfidence;
+}
+
+void NiteBackend::endSession() {
+	if (session_initialized)
+		session_manager->EndSession();
+}
+
+//-----------------------------------------------------------------------------
+// RGB stream, recording and playback
+//-----------------------------------------------------------------------------
+
+bool NiteBackend::setImage(bool wanted) {
+	if (!playback_file.empty())
+		return image.IsValid() != 0; // The nodes of a recording are all there is
+	wanted = wanted || recording_image;
+	if (wanted == (image.IsValid() != 0))
+		return true;
+	if (!wanted) {
+		image.Release();
+		return true;
+	}
+	return startImageGenerator() == XN_STATUS_OK;
+}
+
+// Creates the image generator (RGB stream) and starts it
+XnStatus NiteBackend::startImageGenerator() {
+	XnStatus rc = image.Create(context);
+	CHECK_RC(rc, "Create image generator");
+	XnMapOutputMode mode;
+	mode.nXRes = res_x;
+	mode.nYRes = res_y;
+	mode.nFPS = 30;
+	rc = image.SetMapOutputMode(mode);
+	if (rc == XN_STATUS_OK)
+		rc = image.StartGenerating();
+	last_image_frame = 0; // Its frame ids start over
+	if (rc != XN_STATUS_OK) {
+		printf("Start image generator failed: %s\n", xnGetStatusString(rc));
+		image.Release();
+	}
+	return rc;
+}
+
+// Records the depth and RGB streams of the sensor into record_file. The
+// user generator is NITE's, it can't be recorded: on playback NITE finds the
+// users in the recorded depth maps again.
+XnStatus NiteBackend::startRecording() {
+	if (!image.IsValid() && startImageGenerator() != XN_STATUS_OK)
+		printf("\nRecording without the RGB stream");
+	XnStatus rc = recorder.Create(context);
+	CHECK_RC(rc, "Create recorder");
+	rc = recorder.SetDestination(XN_RECORD_MEDIUM_FILE, record_file.c_str());
+	CHECK_RC(rc, "Set recording destination");
+	rc = recorder.AddNodeToRecording(depth, XN_CODEC_16Z_EMB_TABLES);
+	CHECK_RC(rc, "Record depth generator");
+	if (image.IsValid()) {
+		rc = recorder.AddNodeToRecording(image, XN_CODEC_JPEG);
+		CHECK_RC(rc, "Record image generator");
+		recording_image = true;
+	}
+	printf("\nRecording to %s", record_file.c_str());
+	return XN_STATUS_OK;
+}
+
+// Opens the sensor at device_index and its depth generator: the context
+// only uses the sensor it was given
+XnStatus NiteBackend::openDevice() {
+	NodeInfoList devices;
+	XnStatus rc = context.EnumerateProductionTrees(XN_NODE_TYPE_DEVICE, NULL,
+			devices);
+	CHECK_RC(rc, "Enumerate sensors");
+	NodeInfoList::Iterator it = devices.Begin();
+	for (int i = 0; i < device_index && it != devices.End(); i++)
+		++it;
+	if (!(it != devices.End())) {
+		printf("Sensor %d not found\n", device_index);
+		return XN_STATUS_NO_MATCH;
+	}
+	NodeInfo info = *it;
+	rc = context.CreateProductionTree(info, device);
+	CHECK_RC(rc, "Open sensor");
+	Query query;
+	query.AddNeededNode(device.GetName());
+	rc = depth.Create(context, &query);
+	CHECK_RC(rc, "Create depth generator");
+	XnMapOutputMode mode;
+	mode.nXRes = res_x;
+	mode.nYRes = res_y;
+	mode.nFPS = 30;
+	rc = depth.SetMapOutputMode(mode);
+	CHECK_RC(rc, "Set depth output mode");
+	return XN_STATUS_OK;
+}
+
+// Opens playback_file in place of the sensor: its depth (and RGB) nodes are
+// the ones the rest of the pipeline reads, at the recorded frame rate times
+// playback_speed or as fast as they can be processed (0)
+XnStatus NiteBackend::openPlayback() {
+	XnStatus rc = context.OpenFileRecording(playback_file.c_str(), player);
+	CHECK_RC(rc, "Open recording");
+	rc = player.SetRepeat(false);
+	CHECK_RC(rc, "Set repeat off");
+	rc = player.SetPlaybackSpeed(playback_speed == 0
+			? XN_PLAYBACK_SPEED_FASTEST : playback_speed);
+	CHECK_RC(rc, "Set playback speed");
+	rc = context.FindExistingNode(XN_NODE_TYPE_DEPTH, depth);
+	CHECK_RC(rc, "Find depth generator in the recording");
+	if (context.FindExistingNode(XN_NODE_TYPE_IMAGE, image) != XN_STATUS_OK)
+		printf("\nThe recording has no RGB stream");
+	printf("\nPlaying %s", playback_file.c_str());
+	return XN_STATUS_OK;
+}
+
+//-----------------------------------------------------------------------------
+// Session manager
+//-----------------------------------------------------------------------------
+
+void NiteBackend::addListeners() {
+	if (feature_gesture) {
+		broadcaster->AddListener(wave_detector);
+		broadcaster->AddListener(push_detector);
+		broadcaster->AddListener(swipe_detector);
+		broadcaster->AddListener(steady_detector);
+	}
+
+	if (feature_circle)
+		broadcaster->AddListener(circle_detector);
+
+	session_manager->AddListener(broadcaster);
+}
+
+void NiteBackend::removeListeners() {
+	if (feature_gesture) {
+		broadcaster->RemoveListener(wave_detector);
+		broadcaster->RemoveListener(push_detector);
+		broadcaster->RemoveListener(swipe_detector);
+		broadcaster->RemoveListener(steady_detector);
+	}
+
+	if (feature_circle)
+		broadcaster->RemoveListener(circle_detector);
+
+	session_manager->RemoveListener(broadcaster);
+}
+
+// Create and initialize session manager. Without it the users are still
+// tracked, there are no sessions and gestures.
+void NiteBackend::initSessionManager() {
+	// Create and initialize point tracker
+	session_manager = new XnVSessionManager();
+	XnStatus rc = session_manager->Initialize(&context, GESTURE_INIT_SESSION,
+			"RaiseHand", &hands, &gesture, &gesture); // I change here...putting generators on initialize session
+	if (rc != XN_STATUS_OK) {
+		printf("Couldn't initialize the Session Manager: %s\n",
+				xnGetStatusString(rc));
+		delete session_manager;
+		session_manager = NULL;
+		return;
+	}
+	session_manager->SetQuickRefocusTimeout(15000);// Time to finish the session when any movement is detected (ms)
+	session_manager->SetPrimaryStaticTimeout(2.0);// Time to recognize another gesture (s)
+	session_initialized = true;
+}
+
+// Registers session manager, keeping the handle for unregistering
+void NiteBackend::registerSessionManager() {
+	session_handle = session_manager->RegisterSession(this, &sessionStart,
+			&sessionEnd);
+	session_registered = true;
+}
+
+void NiteBackend::unregisterSessionManager() {
+	session_manager->UnregisterSession(session_handle);
+	session_registered = false;
+}
+
+void NiteBackend::calibrate(XnUserID id) {
+	if (!UserTable::isValidId(id) || calibrated[id])
+		return;
+	if (need_pose)
+		user.GetPoseDetectionCap().StartPoseDetection(pose, id);
+	else
+		user.GetSkeletonCap().RequestCalibration(id, true);
+}
+
+// The session manager is unregistered with the last calibrated user
+void NiteBackend::releaseUser(XnUserID id, bool exited) {
+	if (!UserTable::isValidId(id) || !calibrated[id])
+		return;
+	calibrated[id] = false;
+	n_calibrated--;
+	listener->userLost(id, exited);
+	if (n_calibrated == 0 && session_registered)
+		unregisterSessionManager();
+}
+
+//-----------------------------------------------------------------------------
+// Callbacks, run by the capture thread (inside WaitAnyUpdateAll)
+//-----------------------------------------------------------------------------
+
+void XN_CALLBACK_TYPE NiteBackend::sessionStart(const XnPoint3D &focus,
+		void *cookie) {
+	NiteBackend *b = (NiteBackend*) cookie;
+	if (!b->in_session)
+		b->addListeners();
+	b->in_session = true;
+	b->listener->sessionStarted();
+}
+
+void XN_CALLBACK_TYPE NiteBackend::sessionEnd(void *cookie) {
+	NiteBackend *b = (NiteBackend*) cookie;
+	if (b->in_session)
+		b->removeListeners();
+	b->in_session = false;
+	b->listener->sessionEnded();
+}
+
+void XN_CALLBACK_TYPE NiteBackend::circle(XnFloat times, XnBool confident,
+		const XnVCircle *circle, void *cookie) {
+	NiteBackend *b = (NiteBackend*) cookie;
+	if (_printCircle) {
+		float fAngle = fmod((double) times, 1.0) * 2 * XnVMathCommon::PI;
+		printf("\nCircle - Angle:%.2f, Confident:%i, Radius:%.2f", fAngle,
+				(int) confident, circle->fRadius);
+	}
+	b->listener->gestureDetected(GESTURE_CIRCLE, circle->fRadius,
+			(float) confident, 0.0);
+	b->circle_detector->Reset(); // Used to force recognize only one circle gesture
+}
+
+void XN_CALLBACK_TYPE NiteBackend::noCircle(XnFloat lastValue,
+		XnVCircleDetector::XnVNoCircleReason reason, void *cookie) {
+	if (_printCircle)
+		printf("\nNo Circle - Last Value:%.2f, No Circle Reason:%d",
+				lastValue, reason);
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_NO_CIRCLE,
+			lastValue, (int) reason, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::swipeUp(XnFloat velocity, XnFloat angle,
+		void *cookie) {
+	if (_printGesture)
+		printf("\nSwipe Up - Velocity:%.2f, Angle:%.2f", velocity, angle);
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_SWIPE_UP,
+			velocity, angle, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::swipeDown(XnFloat velocity, XnFloat angle,
+		void *cookie) {
+	if (_printGesture)
+		printf("\nSwipe Down - Velocity:%.2f, Angle:%.2f", velocity, angle);
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_SWIPE_DOWN,
+			velocity, angle, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::swipeLeft(XnFloat velocity, XnFloat angle,
+		void *cookie) {
+	if (_printGesture)
+		printf("\nSwipe Left - Velocity:%.2f, Angle:%.2f", velocity, angle);
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_SWIPE_LEFT,
+			velocity, angle, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::swipeRight(XnFloat velocity,
+		XnFloat angle, void *cookie) {
+	if (_printGesture)
+		printf("\nSwipe Right - Velocity:%.2f, Angle:%.2f", velocity, angle);
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_SWIPE_RIGHT,
+			velocity, angle, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::wave(void *cookie) {
+	if (_printGesture)
+		printf("\nWave Occured");
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_ON_WAVE, 0.0,
+			0.0, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::push(XnFloat velocity, XnFloat angle,
+		void *cookie) {
+	if (_printGesture)
+		printf("\nPush Occured - Velocity:%.2f, Angle:%.2f", velocity, angle);
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_ON_PUSH,
+			velocity, angle, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::steady(XnUInt32 id, XnFloat velocity,
+		void *cookie) {
+	if (_printGesture)
+		printf("\nSteady Occured - Id:%d, Velocity:%.2f", id, velocity);
+	((NiteBackend*) cookie)->listener->gestureDetected(GESTURE_ON_STEADY, 0.0,
+			0.0, 0.0);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::newUser(UserGenerator &generator,
+		XnUserID id, void *cookie) {
+	if (_printUserTracking)
+		printf("\nNew User: %d", id);
+	((NiteBackend*) cookie)->calibrate(id);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::lostUser(UserGenerator &generator,
+		XnUserID id, void *cookie) {
+	if (_printUserTracking)
+		printf("\nLost user: %d", id);
+	((NiteBackend*) cookie)->releaseUser(id, false);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::userExit(UserGenerator &generator,
+		XnUserID id, void *cookie) {
+	if (_printUserTracking)
+		printf("\nThe user %d exited from field of view", id);
+	((NiteBackend*) cookie)->releaseUser(id, true);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::userReEnter(UserGenerator &generator,
+		XnUserID id, void *cookie) {
+	if (_printUserTracking)
+		printf("\nUser %d re-entered the scene after exiting", id);
+	((NiteBackend*) cookie)->calibrate(id);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::poseDetected(
+		PoseDetectionCapability &capability, const XnChar *pose, XnUserID id,
+		void *cookie) {
+	NiteBackend *b = (NiteBackend*) cookie;
+	if (_printUserTracking)
+		printf("\nPose %s detected for user: %d", pose, id);
+	b->user.GetPoseDetectionCap().StopPoseDetection(id);
+	b->user.GetSkeletonCap().RequestCalibration(id, true);
+}
+
+void XN_CALLBACK_TYPE NiteBackend::calibrationStart(
+		SkeletonCapability &capability, XnUserID id, void *cookie) {
+	if (_printUserTracking)
+		printf("\nCalibration started for user: %d", id);
+}
+
+// Tracks the user, and starts the session manager with the first one
+void XN_CALLBACK_TYPE NiteBackend::calibrationComplete(
+		SkeletonCapability &capability, XnUserID id,
+		XnCalibrationStatus status, void *cookie) {
+	NiteBackend *b = (NiteBackend*) cookie;
+	if (status != XN_CALIBRATION_STATUS_OK) {
+		if (_printUserTracking)
+			printf("\nCalibration failed for user: %d", id);
+		if (status == XN_CALIBRATION_STATUS_MANUAL_ABORT) {
+			printf("\nManual abort occurred, stop attempting to calibrate!");
+			return;
+		}
+		b->calibrate(id); // Again
+		return;
+	}
+	b->user.GetSkeletonCap().StartTracking(id);
+	if (UserTable::isValidId(id) && !b->calibrated[id]) {
+		b->calibrated[id] = true;
+		b->n_calibrated++;
+		b->listener->userCalibrated(id);
+	}
+	if (b->device_index >= 0)
+		return; // No session on the other sensors
+	if (!b->session_initialized)// Initializes session manager if was not initialized
+		b->initSessionManager();
+	if (b->session_initialized && !b->session_registered)// Add callbacks for session manager
+		b->registerSessionManager();
+}
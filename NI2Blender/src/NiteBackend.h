@@ -0,0 +1,196 @@
+/*
+ * NiteBackend.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef NITEBACKEND_H_
+#define NITEBACKEND_H_
+
+#include <string>
+#include <XnOpenNI.h>
+#include <XnCppWrapper.h>
+#include <XnVNite.h>
+#include "SensorBackend.h"
+#include "SkeletonSnapshot.h"
+
+// NITE joint of each SkeletonJointIndex
+extern const XnSkeletonJoint NITE_SKELETON_JOINTS[SKELETON_JOINTS];
+
+// Definitions
+#define GESTURE_INIT_SESSION "Wave"
+#define KINECT_SMOOTHING_HANDS 0.8
+#define KINECT_SMOOTHING_SKELETON 0.8
+
+/*The sensor (or an .oni recording of it) through OpenNI and NITE: a depth,
+ * user, hands and gesture generator on one context, every user who appears
+ * is calibrated (with the calibration pose if NITE needs one), and the NITE
+ * session manager is started with the first calibrated user, its gesture
+ * detectors listening while the session is open. The RGB stream is only
+ * opened on request (setImage()), for the preview and the frame ring, which
+ * read the generators directly. The sensors after the first one
+ * (--all-devices) are opened with setDevice(), each on its own context.
+ */
+class NiteBackend: public SensorBackend {
+public:
+	NiteBackend(bool mirror, bool fullSkeleton);
+	virtual ~NiteBackend();
+
+	// Gesture detectors (wave, push, swipe, steady) and circle detector
+	void setGestures(bool gestures, bool circle) {
+		feature_gesture = gestures;
+		feature_circle = circle;
+	}
+
+	// Also records the depth and RGB streams into path (--record)
+	void setRecording(const std::string &path) {
+		record_file = path;
+	}
+
+	/*Opens the sensor at index (in the order OpenNI enumerates them) instead
+	 * of the first one found, with only a depth and a user generator: its
+	 * users are calibrated and tracked, the hands, the session and the
+	 * gestures stay on the first sensor
+	 */
+	void setDevice(int index) {
+		device_index = index;
+	}
+
+	// Reads the frames from the recording at path instead of the sensor,
+	// speed times the recorded frame rate or as fast as possible (0)
+	void setPlayback(const std::string &path, double speed) {
+		playback_file = path;
+		playback_speed = speed;
+	}
+
+	// SensorBackend
+	virtual bool start(SensorListener *listener);
+	virtual void stop();
+	virtual bool update(SensorUpdate &u);
+	virtual bool atEnd() const;
+	virtual uint64_t timestamp() const;
+	virtual void getFieldOfView(double &hFov, double &vFov) const;
+	virtual void getResolution(int &xRes, int &yRes) const;
+	virtual bool isTracking(int user);
+	virtual void getJoint(int user, int joint, SensorJoint &j);
+	virtual void endSession();
+
+	/*Creates or releases the RGB stream (capture thread). It stays on while
+	 * it is recorded, and a recording's is always there. Returns false if it
+	 * was wanted and couldn't be started.
+	 */
+	bool setImage(bool wanted);
+
+	// For the other sensors, the preview and the frame ring
+	xn::Context& getContext() {
+		return context;
+	}
+
+	xn::DepthGenerator& getDepth() {
+		return depth;
+	}
+
+	xn::ImageGenerator& getImage() {
+		return image;
+	}
+
+private:
+	XnStatus openDevice();
+	XnStatus startImageGenerator();
+	XnStatus startRecording();
+	XnStatus openPlayback();
+	void initSessionManager();
+	void registerSessionManager();
+	void unregisterSessionManager();
+	void addListeners();
+	void removeListeners();
+	void calibrate(XnUserID id);
+	void releaseUser(XnUserID id, bool exited);
+
+	static void XN_CALLBACK_TYPE sessionStart(const XnPoint3D &focus,
+			void *cookie);
+	static void XN_CALLBACK_TYPE sessionEnd(void *cookie);
+	static void XN_CALLBACK_TYPE circle(XnFloat times, XnBool confident,
+			const XnVCircle *circle, void *cookie);
+	static void XN_CALLBACK_TYPE noCircle(XnFloat lastValue,
+			XnVCircleDetector::XnVNoCircleReason reason, void *cookie);
+	static void XN_CALLBACK_TYPE swipeUp(XnFloat velocity, XnFloat angle,
+			void *cookie);
+	static void XN_CALLBACK_TYPE swipeDown(XnFloat velocity, XnFloat angle,
+			void *cookie);
+	static void XN_CALLBACK_TYPE swipeLeft(XnFloat velocity, XnFloat angle,
+			void *cookie);
+	static void XN_CALLBACK_TYPE swipeRight(XnFloat velocity, XnFloat angle,
+			void *cookie);
+	static void XN_CALLBACK_TYPE wave(void *cookie);
+	static void XN_CALLBACK_TYPE push(XnFloat velocity, XnFloat angle,
+			void *cookie);
+	static void XN_CALLBACK_TYPE steady(XnUInt32 id, XnFloat velocity,
+			void *cookie);
+	static void XN_CALLBACK_TYPE newUser(xn::UserGenerator &generator,
+			XnUserID id, void *cookie);
+	static void XN_CALLBACK_TYPE lostUser(xn::UserGenerator &generator,
+			XnUserID id, void *cookie);
+	static void XN_CALLBACK_TYPE userExit(xn::UserGenerator &generator,
+			XnUserID id, void *cookie);
+	static void XN_CALLBACK_TYPE userReEnter(xn::UserGenerator &generator,
+			XnUserID id, void *cookie);
+	static void XN_CALLBACK_TYPE poseDetected(
+			xn::PoseDetectionCapability &capability, const XnChar *pose,
+			XnUserID id, void *cookie);
+	static void XN_CALLBACK_TYPE calibrationStart(
+			xn::SkeletonCapability &capability, XnUserID id, void *cookie);
+	static void XN_CALLBACK_TYPE calibrationComplete(
+			xn::SkeletonCapability &capability, XnUserID id,
+			XnCalibrationStatus status, void *cookie);
+
+	bool mirror;
+	bool full_skeleton;
+	bool feature_gesture;
+	bool feature_circle;
+	std::string record_file;
+	std::string playback_file;
+	double playback_speed;
+	int device_index; // -1 = the first one, with hands and gestures
+	SensorListener *listener;
+
+	// OpenNI objects
+	xn::Context context;
+	xn::Device device; // With setDevice()
+	xn::DepthGenerator depth;
+	xn::ImageGenerator image;
+	xn::GestureGenerator gesture;
+	xn::HandsGenerator hands;
+	xn::UserGenerator user;
+	xn::Recorder recorder;
+	xn::Player player;
+	bool recording_image; // The RGB stream is in the recording
+
+	// NITE objects
+	XnVSessionManager *session_manager;
+	XnVBroadcaster *broadcaster;
+	XnVWaveDetector *wave_detector;
+	XnVPushDetector *push_detector;
+	XnVCircleDetector *circle_detector;
+	XnVSwipeDetector *swipe_detector;
+	XnVSteadyDetector *steady_detector;
+	XnVHandle session_handle;
+	bool session_initialized;
+	bool session_registered;
+	bool in_session; // The detectors are listening
+
+	// User tracking vars
+	bool need_pose;
+	XnChar pose[20];
+	bool calibrated[MAX_USERS]; // Reported to the listener
+	int n_calibrated;
+
+	// Frame id of the data each stream had on the last update()
+	XnUInt32 last_depth_frame;
+	XnUInt32 last_user_frame;
+	XnUInt32 last_image_frame;
+	bool started;
+};
+
+#endif /* NITEBACKEND_H_ */
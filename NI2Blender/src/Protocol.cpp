@@ -0,0 +1,649 @@
+/*
+ * Protocol.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "Protocol.h"
+
+// Indexed by MessageType
+static const char *message_names[] = { "none", "session_started",
+		"session_ended", "new_user_calibrated", "calibrated_user_lost",
+		"calibrated_user_exit", "gesture", "hand_coordinates",
+		"head_coordinates", "client_exit", "resume", "ping", "pong",
+		"skeleton" };
+
+// Indexed by GestureType
+static const char *gesture_names[] = { "none", "circle", "no_circle",
+		"swipe_up", "swipe_down", "swipe_left", "swipe_right", "on_wave",
+		"on_push", "stabilized_push", "on_steady", "not_steady" };
+
+#define N_MESSAGE_NAMES (int) (sizeof(message_names) / sizeof(message_names[0]))
+#define N_GESTURE_NAMES (int) (sizeof(gesture_names) / sizeof(gesture_names[0]))
+
+const char* messageTypeName(MessageType type) {
+	if (type < 0 || type >= N_MESSAGE_NAMES)
+		return message_names[MSG_NONE];
+	return message_names[type];
+}
+
+MessageType messageTypeFromName(const char *name) {
+	for (int i = 0; i < N_MESSAGE_NAMES; i++) {
+		if (strcmp(name, message_names[i]) == 0)
+			return (MessageType) i;
+	}
+	return MSG_NONE;
+}
+
+const char* gestureName(GestureType gesture) {
+	if (gesture < 0 || gesture >= N_GESTURE_NAMES)
+		return gesture_names[GESTURE_NONE];
+	return gesture_names[gesture];
+}
+
+GestureType gestureFromName(const char *name) {
+	for (int i = 0; i < N_GESTURE_NAMES; i++) {
+		if (strcmp(name, gesture_names[i]) == 0)
+			return (GestureType) i;
+	}
+	return GESTURE_NONE;
+}
+
+bool isReliableMessage(MessageType type) {
+	return type != MSG_HAND_COORDINATES && type != MSG_HEAD_COORDINATES
+			&& type != MSG_SKELETON;
+}
+
+uint64_t monotonicMicros() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t sendTime(const Message &m) {
+	return m.send_time != 0 ? m.send_time : monotonicMicros();
+}
+
+void initMessage(Message &m, MessageType type) {
+	memset(&m, 0, sizeof(m));
+	m.type = type;
+	m.player_id = -1;
+	m.hand_id = -1;
+	m.l_hand = -1;
+	m.r_hand = -1;
+	m.gesture = GESTURE_NONE;
+}
+
+/*Format of data:
+ * #header|data_id|player_id|hand_id,left,right|x,y,z,c_p1|gesture,g_p1,g_p2,g_p3|sensor_time,capture_time,send_time[|device_id]#
+ * Old scripts only read the first six fields. device_id is only written when
+ * it isn't 0, so a single sensor gives the same records as before.
+ */
+int encodeText(const Message &m, char *buffer, int bufferLen) {
+	if (m.type == MSG_CLIENT_EXIT) {
+		if (bufferLen < 2)
+			return -1;
+		memcpy(buffer, "0", 2); // Exit flag expected by old scripts
+		return 2;
+	}
+	int n = snprintf(buffer, bufferLen,
+			"#%s|%i|%i|%i,%i,%i|%.3f,%.3f,%.3f,%.3f|%s,%.2f,%.2f,%.2f|%llu,%llu,%llu#",
+			messageTypeName(m.type), m.data_id, m.player_id, m.hand_id,
+			m.l_hand, m.r_hand, m.coordinates[0], m.coordinates[1],
+			m.coordinates[2], m.c_p1, gestureName(m.gesture), m.g_p1, m.g_p2,
+			m.g_p3, (unsigned long long) m.sensor_time,
+			(unsigned long long) m.capture_time,
+			(unsigned long long) sendTime(m));
+	if (n < 0 || n >= bufferLen)
+		return -1;
+	if (m.device_id != 0) {
+		// Goes in place of the closing '#'
+		int d = snprintf(buffer + n - 1, bufferLen - n + 1, "|%i#",
+				m.device_id);
+		if (d < 0 || d >= bufferLen - n + 1)
+			return -1;
+		n += d - 1;
+	}
+	return n;
+}
+
+int encodeBinary(const Message &m, char *buffer, int bufferLen) {
+	MessageHeader header;
+	header.magic = PROTOCOL_MAGIC;
+	header.version = PROTOCOL_VERSION;
+	header.type = (uint8_t) m.type;
+	header.data_id = (uint32_t) m.data_id;
+	header.player_id = (int8_t) m.player_id;
+	header.device_id = (uint8_t) m.device_id;
+	header.sensor_time = m.sensor_time;
+	header.capture_time = m.capture_time;
+	header.send_time = sendTime(m);
+
+	char *payload = buffer + sizeof(MessageHeader);
+	switch (m.type) {
+	case MSG_HAND_COORDINATES:
+	case MSG_HEAD_COORDINATES: {
+		CoordinatesPayload c;
+		c.hand_id = (int8_t) m.hand_id;
+		c.l_hand = (int8_t) m.l_hand;
+		c.r_hand = (int8_t) m.r_hand;
+		c.reserved = 0;
+		c.x = m.coordinates[0];
+		c.y = m.coordinates[1];
+		c.z = m.coordinates[2];
+		c.c_p1 = m.c_p1;
+		header.payload_len = sizeof(c);
+		if ((int) (sizeof(header) + sizeof(c)) > bufferLen)
+			return -1;
+		memcpy(payload, &c, sizeof(c));
+		break;
+	}
+	case MSG_GESTURE: {
+		GesturePayload g;
+		memset(&g, 0, sizeof(g));
+		g.gesture = (uint8_t) m.gesture;
+		g.p1 = m.g_p1;
+		g.p2 = m.g_p2;
+		g.p3 = m.g_p3;
+		header.payload_len = sizeof(g);
+		if ((int) (sizeof(header) + sizeof(g)) > bufferLen)
+			return -1;
+		memcpy(payload, &g, sizeof(g));
+		break;
+	}
+	case MSG_SKELETON: {
+		SkeletonPayload p;
+		p.joint_mask = m.joint_mask;
+		p.keyframe = m.keyframe;
+		p.ref = m.skeleton_ref;
+		SkeletonJointRecord joints[SKELETON_JOINTS];
+		int n = 0;
+		for (int i = 0; i < SKELETON_JOINTS; i++) {
+			if ((m.joint_mask & (1 << i)) == 0)
+				continue;
+			SkeletonJointRecord &j = joints[n++];
+			j.x = m.skeleton.x[i];
+			j.y = m.skeleton.y[i];
+			j.z = m.skeleton.z[i];
+			j.confidence = m.skeleton.confidence[i];
+			j.qx = m.skeleton.qx[i];
+			j.qy = m.skeleton.qy[i];
+			j.qz = m.skeleton.qz[i];
+			j.qw = m.skeleton.qw[i];
+		}
+		header.payload_len = sizeof(p) + n * sizeof(SkeletonJointRecord);
+		if ((int) (sizeof(header) + header.payload_len) > bufferLen)
+			return -1;
+		memcpy(payload, &p, sizeof(p));
+		memcpy(payload + sizeof(p), joints, n * sizeof(SkeletonJointRecord));
+		break;
+	}
+	default: {
+		SessionPayload s;
+		memset(&s, 0, sizeof(s));
+		s.in_session = m.in_session;
+		s.calibrated = m.calibrated;
+		header.payload_len = sizeof(s);
+		if ((int) (sizeof(header) + sizeof(s)) > bufferLen)
+			return -1;
+		memcpy(payload, &s, sizeof(s));
+		break;
+	}
+	}
+	memcpy(buffer, &header, sizeof(header));
+	return sizeof(header) + header.payload_len;
+}
+
+// Stateless: compact coordinates need a MessageEncoder, here they are binary
+int encodeMessage(WireFormat format, const Message &m, char *buffer,
+		int bufferLen) {
+	if (format == WIRE_FORMAT_BINARY || format == WIRE_FORMAT_COMPACT)
+		return encodeBinary(m, buffer, bufferLen);
+	return encodeText(m, buffer, bufferLen);
+}
+
+int decodeBinary(const char *buffer, int bufferLen, Message &m) {
+	MessageHeader header;
+	if (bufferLen < (int) sizeof(header))
+		return 0;
+	memcpy(&header, buffer, sizeof(header));
+	if (header.magic != PROTOCOL_MAGIC || header.version != PROTOCOL_VERSION)
+		return -1;
+	int total = sizeof(header) + header.payload_len;
+	if (bufferLen < total)
+		return 0;
+
+	initMessage(m, (MessageType) header.type);
+	m.data_id = (int) header.data_id;
+	m.player_id = header.player_id;
+	m.device_id = header.device_id;
+	m.sensor_time = header.sensor_time;
+	m.capture_time = header.capture_time;
+	m.send_time = header.send_time;
+
+	const char *payload = buffer + sizeof(header);
+	switch (m.type) {
+	case MSG_HAND_COORDINATES:
+	case MSG_HEAD_COORDINATES: {
+		CoordinatesPayload c;
+		if (header.payload_len < sizeof(c))
+			return -1;
+		memcpy(&c, payload, sizeof(c));
+		m.hand_id = c.hand_id;
+		m.l_hand = c.l_hand;
+		m.r_hand = c.r_hand;
+		m.coordinates[0] = c.x;
+		m.coordinates[1] = c.y;
+		m.coordinates[2] = c.z;
+		m.c_p1 = c.c_p1;
+		break;
+	}
+	case MSG_GESTURE: {
+		GesturePayload g;
+		if (header.payload_len < sizeof(g))
+			return -1;
+		memcpy(&g, payload, sizeof(g));
+		m.gesture = (GestureType) g.gesture;
+		m.g_p1 = g.p1;
+		m.g_p2 = g.p2;
+		m.g_p3 = g.p3;
+		break;
+	}
+	case MSG_SKELETON: {
+		SkeletonPayload p;
+		if (header.payload_len < sizeof(p))
+			return -1;
+		memcpy(&p, payload, sizeof(p));
+		const char *record = payload + sizeof(p);
+		const char *end = payload + header.payload_len;
+		clearSkeleton(m.skeleton);
+		for (int i = 0; i < SKELETON_JOINTS; i++) {
+			if ((p.joint_mask & (1 << i)) == 0)
+				continue;
+			SkeletonJointRecord j;
+			if (record + sizeof(j) > end)
+				return -1;
+			memcpy(&j, record, sizeof(j));
+			record += sizeof(j);
+			m.skeleton.x[i] = j.x;
+			m.skeleton.y[i] = j.y;
+			m.skeleton.z[i] = j.z;
+			m.skeleton.confidence[i] = j.confidence;
+			m.skeleton.qx[i] = j.qx;
+			m.skeleton.qy[i] = j.qy;
+			m.skeleton.qz[i] = j.qz;
+			m.skeleton.qw[i] = j.qw;
+		}
+		m.joint_mask = p.joint_mask & SKELETON_ALL_JOINTS;
+		m.keyframe = p.keyframe != 0;
+		m.skeleton_ref = p.ref;
+		break;
+	}
+	default: {
+		SessionPayload s;
+		if (header.payload_len >= sizeof(s)) {
+			memcpy(&s, payload, sizeof(s));
+			m.in_session = s.in_session != 0;
+			m.calibrated = s.calibrated != 0;
+		}
+		break;
+	}
+	}
+	return total;
+}
+
+int decodeText(const char *buffer, int bufferLen, Message &m) {
+	if (bufferLen < 1)
+		return 0;
+	if (buffer[0] != '#')
+		return -1;
+	const char *end = (const char*) memchr(buffer + 1, '#', bufferLen - 1);
+	if (end == NULL)
+		return bufferLen < MAX_MESSAGE_SIZE ? 0 : -1;
+	int total = end - buffer + 1;
+	if (total > MAX_MESSAGE_SIZE)
+		return -1;
+	char text[MAX_MESSAGE_SIZE + 1];
+	memcpy(text, buffer, total);
+	text[total] = '\0';
+
+	char header[32], gesture[32];
+	int data_id, player_id, hand_id, l_hand, r_hand, device_id;
+	float x, y, z, c_p1, g_p1, g_p2, g_p3;
+	unsigned long long sensor_time, capture_time, send_time;
+	int n = sscanf(text,
+			"#%31[^|]|%d|%d|%d,%d,%d|%f,%f,%f,%f|%31[^,],%f,%f,%f|%llu,%llu,%llu|%d#",
+			header, &data_id, &player_id, &hand_id, &l_hand, &r_hand, &x, &y,
+			&z, &c_p1, gesture, &g_p1, &g_p2, &g_p3, &sensor_time,
+			&capture_time, &send_time, &device_id);
+	if (n < 2)
+		return -1;
+	MessageType type = messageTypeFromName(header);
+	if (type == MSG_NONE)
+		return -1;
+	initMessage(m, type);
+	m.data_id = data_id;
+	if (n >= 3)
+		m.player_id = player_id;
+	if (n >= 6) {
+		m.hand_id = hand_id;
+		m.l_hand = l_hand;
+		m.r_hand = r_hand;
+	}
+	if (n >= 10) {
+		m.coordinates[0] = x;
+		m.coordinates[1] = y;
+		m.coordinates[2] = z;
+		m.c_p1 = c_p1;
+	}
+	if (n >= 14) {
+		m.gesture = gestureFromName(gesture);
+		m.g_p1 = g_p1;
+		m.g_p2 = g_p2;
+		m.g_p3 = g_p3;
+	}
+	if (n >= 17) {
+		m.sensor_time = sensor_time;
+		m.capture_time = capture_time;
+		m.send_time = send_time;
+	}
+	if (n >= 18 && device_id >= 0 && device_id < MAX_DEVICES)
+		m.device_id = device_id;
+	return total;
+}
+
+//-----------------------------------------------------------------------------
+// Compact coordinates
+//-----------------------------------------------------------------------------
+
+static uint16_t quantize(float value, float scale) {
+	float q = value * scale + 0.5f;
+	if (q < 0)
+		return 0;
+	if (q > 65535)
+		return 65535;
+	return (uint16_t) q;
+}
+
+// Stream index of a coordinates message, -1 if it can't be compacted
+static int compactStream(const Message &m) {
+	if (m.player_id < 0 || m.player_id > 15 || m.device_id < 0 || m.device_id
+			>= MAX_DEVICES)
+		return -1;
+	int kind;
+	if (m.type == MSG_HEAD_COORDINATES)
+		kind = COMPACT_STREAM_HEAD;
+	else if (m.type == MSG_HAND_COORDINATES && m.l_hand == 1)
+		kind = COMPACT_STREAM_LEFT_HAND;
+	else if (m.type == MSG_HAND_COORDINATES && m.r_hand == 1)
+		kind = COMPACT_STREAM_RIGHT_HAND;
+	else
+		return -1;
+	return (m.device_id << 6) | (m.player_id << 2) | kind;
+}
+
+static bool fitsInt8(int value) {
+	return value >= -128 && value <= 127;
+}
+
+MessageEncoder::MessageEncoder(WireFormat format) {
+	this->format = format;
+	time_per_record = false;
+	reset();
+}
+
+void MessageEncoder::setFormat(WireFormat format) {
+	this->format = format;
+	reset();
+}
+
+void MessageEncoder::reset() {
+	memset(last, 0, sizeof(last));
+	last_sensor_time = 0;
+	last_capture_time = 0;
+	memset(skeletons, 0, sizeof(skeletons));
+}
+
+int MessageEncoder::encode(const Message &m, char *buffer, int bufferLen) {
+	if (m.type == MSG_SKELETON && format != WIRE_FORMAT_TEXT)
+		return encodeSkeleton(m, buffer, bufferLen);
+	if (format == WIRE_FORMAT_COMPACT && compactStream(m) >= 0)
+		return encodeCompact(m, buffer, bufferLen);
+	return encodeMessage(format, m, buffer, bufferLen);
+}
+
+int MessageEncoder::encodeCompact(const Message &m, char *buffer,
+		int bufferLen) {
+	// First record of a frame (or every one), its times go in front of it
+	int timeLen = 0;
+	if (time_per_record || m.sensor_time != last_sensor_time
+			|| m.capture_time != last_capture_time) {
+		CompactTime t;
+		memset(&t, 0, sizeof(t));
+		t.kind = COMPACT_TIME;
+		t.sensor_time = m.sensor_time;
+		t.capture_time = m.capture_time;
+		t.send_time = sendTime(m);
+		if ((int) sizeof(t) > bufferLen)
+			return -1;
+		memcpy(buffer, &t, sizeof(t));
+		timeLen = sizeof(t);
+		buffer += timeLen;
+		bufferLen -= timeLen;
+	}
+
+	int stream = compactStream(m);
+	CompactPoint &p = last[stream];
+	uint16_t x = quantize(m.coordinates[0], COMPACT_XY_SCALE);
+	uint16_t y = quantize(m.coordinates[1], COMPACT_XY_SCALE);
+	uint16_t z = quantize(m.coordinates[2], COMPACT_Z_SCALE);
+	int dx = x - p.x, dy = y - p.y, dz = z - p.z;
+
+	CompactHeader header;
+	header.stream = (uint8_t) stream;
+	header.data_id = (uint16_t) m.data_id;
+	int n;
+	if (p.valid && p.samples < COMPACT_KEYFRAME_INTERVAL && fitsInt8(dx)
+			&& fitsInt8(dy) && fitsInt8(dz)) {
+		CompactDelta d;
+		d.ref = (uint8_t) p.data_id;
+		d.dx = (int8_t) dx;
+		d.dy = (int8_t) dy;
+		d.dz = (int8_t) dz;
+		n = sizeof(header) + sizeof(d);
+		if (n > bufferLen)
+			return -1;
+		header.kind = COMPACT_DELTA;
+		memcpy(buffer + sizeof(header), &d, sizeof(d));
+		p.samples++;
+	} else {
+		CompactKeyframe k;
+		k.x = x;
+		k.y = y;
+		k.z = z;
+		n = sizeof(header) + sizeof(k);
+		if (n > bufferLen)
+			return -1;
+		header.kind = COMPACT_KEYFRAME;
+		memcpy(buffer + sizeof(header), &k, sizeof(k));
+		p.samples = 0;
+	}
+	memcpy(buffer, &header, sizeof(header));
+	p.x = x;
+	p.y = y;
+	p.z = z;
+	p.data_id = m.data_id;
+	p.valid = true;
+	last_sensor_time = m.sensor_time;
+	last_capture_time = m.capture_time;
+	return timeLen + n;
+}
+
+int MessageEncoder::encodeSkeleton(const Message &m, char *buffer,
+		int bufferLen) {
+	if (m.player_id < 0 || m.player_id >= SKELETON_MAX_PLAYERS
+			|| m.device_id < 0 || m.device_id >= MAX_DEVICES)
+		return encodeBinary(m, buffer, bufferLen); // Nothing to compare with
+	SkeletonState &s = skeletons[m.device_id][m.player_id];
+	Message changes = m;
+	if (!s.valid || s.samples >= SKELETON_KEYFRAME_INTERVAL) {
+		changes.joint_mask = SKELETON_ALL_JOINTS;
+		changes.keyframe = true;
+	} else {
+		changes.joint_mask = changedJoints(s.joints, m.skeleton);
+		changes.keyframe = false;
+		changes.skeleton_ref = (uint8_t) s.data_id;
+		if (changes.joint_mask == 0) {
+			s.samples++; // Keyframes go on, for a datagram that got lost
+			return 0;
+		}
+	}
+	int n = encodeBinary(changes, buffer, bufferLen);
+	if (n < 0)
+		return -1;
+	// Only what was sent, so slow drifts add up until they are sent too
+	copyJoints(s.joints, m.skeleton, changes.joint_mask);
+	s.data_id = m.data_id;
+	s.samples = changes.keyframe ? 0 : s.samples + 1;
+	s.valid = true;
+	return n;
+}
+
+MessageDecoder::MessageDecoder() {
+	reset();
+}
+
+void MessageDecoder::reset() {
+	last_data_id = 0;
+	memset(last, 0, sizeof(last));
+	memset(&last_time, 0, sizeof(last_time));
+	has_sensor_offset = false;
+	sensor_offset = 0;
+	memset(skeletons, 0, sizeof(skeletons));
+}
+
+int MessageDecoder::decode(const char *buffer, int bufferLen, Message &m) {
+	if (bufferLen < 1)
+		return 0;
+	uint8_t kind = (uint8_t) buffer[0];
+	if (kind == COMPACT_TIME) {
+		// Always followed by the compact record it belongs to
+		if (bufferLen < (int) sizeof(CompactTime))
+			return 0;
+		memcpy(&last_time, buffer, sizeof(last_time));
+		int n = decode(buffer + sizeof(CompactTime), bufferLen
+				- sizeof(CompactTime), m);
+		return n > 0 ? (int) sizeof(CompactTime) + n : n;
+	}
+	if (kind == COMPACT_KEYFRAME || kind == COMPACT_DELTA)
+		return decodeCompact(buffer, bufferLen, m);
+	int n = decodeBinary(buffer, bufferLen, m);
+	if (n > 0) {
+		last_data_id = m.data_id;
+		updateSensorOffset(m);
+		if (m.type == MSG_SKELETON)
+			applySkeleton(m);
+	}
+	return n;
+}
+
+// Fills in the joints m leaves out with the ones received before
+void MessageDecoder::applySkeleton(Message &m) {
+	if (m.player_id < 0 || m.player_id >= SKELETON_MAX_PLAYERS
+			|| m.device_id >= MAX_DEVICES)
+		return;
+	SkeletonState &s = skeletons[m.device_id][m.player_id];
+	if (m.keyframe) {
+		s.joints = m.skeleton;
+		s.samples = 0;
+		s.valid = true;
+	} else if (!s.valid || m.skeleton_ref != (uint8_t) s.data_id) {
+		s.valid = false; // Lost one, wait for a keyframe
+		initMessage(m, MSG_NONE);
+		return;
+	} else {
+		copyJoints(s.joints, m.skeleton, m.joint_mask);
+		s.samples++;
+	}
+	s.data_id = m.data_id;
+	m.skeleton = s.joints;
+}
+
+void MessageDecoder::updateSensorOffset(const Message &m) {
+	if (m.sensor_time == 0 || m.capture_time == 0)
+		return;
+	int64_t offset = (int64_t) (m.capture_time - m.sensor_time);
+	if (!has_sensor_offset || offset < sensor_offset) {
+		sensor_offset = offset;
+		has_sensor_offset = true;
+	}
+}
+
+int64_t MessageDecoder::sensorLatency(const Message &m,
+		uint64_t applyTime) const {
+	if (!has_sensor_offset || m.sensor_time == 0)
+		return -1;
+	return (int64_t) (applyTime - m.sensor_time) - sensor_offset;
+}
+
+int MessageDecoder::decodeCompact(const char *buffer, int bufferLen,
+		Message &m) {
+	CompactHeader header;
+	int n = sizeof(header) + (buffer[0] == (char) COMPACT_KEYFRAME ? sizeof(
+			CompactKeyframe) : sizeof(CompactDelta));
+	if (bufferLen < n)
+		return 0;
+	memcpy(&header, buffer, sizeof(header));
+	CompactPoint &p = last[header.stream];
+
+	// Rebuild the 32 bit data_id from the closest full one
+	int data_id = (last_data_id & ~0xFFFF) | header.data_id;
+	if (data_id < last_data_id - 0x8000)
+		data_id += 0x10000;
+	else if (data_id > last_data_id + 0x8000 && data_id >= 0x10000)
+		data_id -= 0x10000;
+
+	initMessage(m, MSG_NONE);
+	if (header.kind == COMPACT_KEYFRAME) {
+		CompactKeyframe k;
+		memcpy(&k, buffer + sizeof(header), sizeof(k));
+		p.x = k.x;
+		p.y = k.y;
+		p.z = k.z;
+	} else {
+		CompactDelta d;
+		memcpy(&d, buffer + sizeof(header), sizeof(d));
+		if (!p.valid || d.ref != (uint8_t) p.data_id) {
+			p.valid = false; // Lost a sample, wait for a keyframe
+			return n;
+		}
+		p.x += d.dx;
+		p.y += d.dy;
+		p.z += d.dz;
+	}
+	p.data_id = data_id;
+	p.valid = true;
+	last_data_id = data_id;
+
+	int kindOfStream = header.stream & 3;
+	m.type = kindOfStream == COMPACT_STREAM_HEAD ? MSG_HEAD_COORDINATES
+			: MSG_HAND_COORDINATES;
+	m.data_id = data_id;
+	m.player_id = (header.stream >> 2) & 15;
+	m.device_id = header.stream >> 6;
+	m.hand_id = 0;
+	m.l_hand = kindOfStream == COMPACT_STREAM_LEFT_HAND ? 1 : 0;
+	m.r_hand = kindOfStream == COMPACT_STREAM_RIGHT_HAND ? 1 : 0;
+	m.coordinates[0] = p.x / COMPACT_XY_SCALE;
+	m.coordinates[1] = p.y / COMPACT_XY_SCALE;
+	m.coordinates[2] = p.z / COMPACT_Z_SCALE;
+	m.sensor_time = last_time.sensor_time;
+	m.capture_time = last_time.capture_time;
+	m.send_time = last_time.send_time;
+	updateSensorOffset(m);
+	return n;
+}
@@ -0,0 +1,351 @@
+/*
+ * Protocol.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include <stdint.h>
+#include "SkeletonJoints.h"
+
+// Wire format used to send data to Blender, chosen at startup
+enum WireFormat {
+	WIRE_FORMAT_TEXT = 0, // #header|data_id|...|times# (old Blender scripts)
+	WIRE_FORMAT_BINARY = 1, // Packed header + typed payload
+	WIRE_FORMAT_COMPACT = 2 // Binary, with quantized/delta coordinates
+};
+
+#define PROTOCOL_MAGIC 0x424E // "NB" on the wire (little endian)
+#define PROTOCOL_VERSION 3 // 3: device_id in the header
+
+// Sensors in one stream (device_id 0 to MAX_DEVICES - 1)
+#define MAX_DEVICES 4
+
+// Largest encoded message (text or binary), a MSG_SKELETON with every joint
+#define MAX_MESSAGE_SIZE 520
+
+// Message types, one for each header of the text format
+enum MessageType {
+	MSG_NONE = 0,
+	MSG_SESSION_STARTED = 1,
+	MSG_SESSION_ENDED = 2,
+	MSG_NEW_USER_CALIBRATED = 3,
+	MSG_CALIBRATED_USER_LOST = 4,
+	MSG_CALIBRATED_USER_EXIT = 5,
+	MSG_GESTURE = 6,
+	MSG_HAND_COORDINATES = 7,
+	MSG_HEAD_COORDINATES = 8,
+	MSG_CLIENT_EXIT = 9, // Replaces the "0" exit flag
+	MSG_RESUME = 10, // Server to client, data_id = last event received
+	MSG_PING = 11, // Either way, see ClockSync.h
+	MSG_PONG = 12,
+	MSG_SKELETON = 13 // Binary only, see SkeletonPayload
+};
+
+/*Clock synchronization reuses the time fields:
+ *   MSG_PING  data_id = sequence, send_time = t0 (sent)
+ *   MSG_PONG  data_id = sequence of the ping, sensor_time = t0 (copied from
+ *             the ping), capture_time = t1 (ping received), send_time = t2
+ */
+
+// Gestures, one for each gesture string of the text format
+enum GestureType {
+	GESTURE_NONE = 0,
+	GESTURE_CIRCLE = 1,
+	GESTURE_NO_CIRCLE = 2,
+	GESTURE_SWIPE_UP = 3,
+	GESTURE_SWIPE_DOWN = 4,
+	GESTURE_SWIPE_LEFT = 5,
+	GESTURE_SWIPE_RIGHT = 6,
+	GESTURE_ON_WAVE = 7,
+	GESTURE_ON_PUSH = 8,
+	GESTURE_STABILIZED_PUSH = 9,
+	GESTURE_ON_STEADY = 10,
+	GESTURE_NOT_STEADY = 11
+};
+
+/*Binary frame: header followed by payload_len bytes of payload.
+ * All fields are little endian and packed, so on the Blender side they can be
+ * read with struct.unpack:
+ *   header      '<HBBIbBHQQQ' (36 bytes)
+ *   coordinates '<bbbxffff'  (20 bytes)
+ *   gesture     '<Bxxxfff'   (16 bytes)
+ *   session     '<BBxx'      (4 bytes)
+ *   skeleton    '<HBB'       (4 bytes) + '<8f' (32 bytes) per joint
+ * Times are in microseconds. sensor_time is the timestamp of the depth frame
+ * the message comes from (sensor clock), capture_time and send_time are
+ * CLOCK_MONOTONIC on the client when that frame was read and when the message
+ * was encoded. device_id is the sensor the data comes from (0 for events of
+ * the client and with a single sensor).
+ */
+#pragma pack(push, 1)
+struct MessageHeader {
+	uint16_t magic; // PROTOCOL_MAGIC
+	uint8_t version; // PROTOCOL_VERSION
+	uint8_t type; // MessageType
+	uint32_t data_id;
+	int8_t player_id;
+	uint8_t device_id;
+	uint16_t payload_len;
+	uint64_t sensor_time;
+	uint64_t capture_time;
+	uint64_t send_time;
+};
+
+// MSG_HAND_COORDINATES and MSG_HEAD_COORDINATES
+struct CoordinatesPayload {
+	int8_t hand_id;
+	int8_t l_hand;
+	int8_t r_hand;
+	int8_t reserved;
+	float x, y, z;
+	float c_p1;
+};
+
+// MSG_GESTURE
+struct GesturePayload {
+	uint8_t gesture; // GestureType
+	uint8_t reserved[3];
+	float p1, p2, p3;
+};
+
+// MSG_SESSION_*, MSG_*_USER_* and MSG_CLIENT_EXIT
+struct SessionPayload {
+	uint8_t in_session; // Session state after the event
+	uint8_t calibrated; // 1 if a calibrated user is being tracked
+	uint8_t reserved[2];
+};
+
+/*MSG_SKELETON, the full skeleton of player_id on device_id: joint_mask tells which joints
+ * follow (bit i = SkeletonJointIndex i, in that order), the others didn't
+ * change since the last one sent. A keyframe has every joint and replaces the
+ * skeleton kept by the receiver, which must ignore the others until it gets
+ * one. Like a compact delta, the others are only valid if ref matches the low
+ * byte of the data_id of the last skeleton received for the player, otherwise
+ * one was lost and the receiver waits for the next keyframe.
+ * Positions are projective (pixels, z in mm), see SkeletonJoints.h.
+ */
+#define SKELETON_KEYFRAME_INTERVAL 30 // Frames between keyframes
+#define SKELETON_MAX_PLAYERS 16
+
+struct SkeletonPayload {
+	uint16_t joint_mask;
+	uint8_t keyframe;
+	uint8_t ref; // Low byte of the data_id the delta applies to
+};
+
+struct SkeletonJointRecord {
+	float x, y, z;
+	float confidence;
+	float qx, qy, qz, qw;
+};
+
+/*Compact coordinates (WIRE_FORMAT_COMPACT), sent instead of a full
+ * MSG_HAND_COORDINATES/MSG_HEAD_COORDINATES frame. The first byte tells them
+ * apart from a full header (whose first byte is 'N').
+ *   header   '<BBH' (4 bytes)
+ *   keyframe '<HHH' (6 bytes): x, y in 1/4 pixel, z in mm
+ *   delta    '<Bbbb' (4 bytes): difference from the last point of the stream
+ * A delta is only valid if ref matches the low byte of the data_id of the
+ * last decoded point of its stream, otherwise wait for the next keyframe.
+ * The times of the frame come once, as a '<BxxxQQQ' (28 bytes) time record in
+ * front of its first compact record; the following ones share them. Where a
+ * record may be lost alone (datagrams, a full subscriber queue or ring),
+ * every record has its own time record in front.
+ */
+#define COMPACT_KEYFRAME 0xC1
+#define COMPACT_DELTA 0xC2
+#define COMPACT_TIME 0xC3
+#define COMPACT_XY_SCALE 4.0f // Units per pixel
+#define COMPACT_Z_SCALE 1.0f // Units per mm
+#define COMPACT_KEYFRAME_INTERVAL 30 // Samples between keyframes of a stream
+
+// Low 2 bits of CompactHeader.stream, then 4 bits of player id and 2 of
+// device id
+enum CompactStream {
+	COMPACT_STREAM_HEAD = 0,
+	COMPACT_STREAM_LEFT_HAND = 1,
+	COMPACT_STREAM_RIGHT_HAND = 2
+};
+#define COMPACT_MAX_STREAMS (MAX_DEVICES * 16 * 4)
+
+struct CompactHeader {
+	uint8_t kind; // COMPACT_KEYFRAME or COMPACT_DELTA
+	uint8_t stream; // device_id << 6 | player_id << 2 | CompactStream
+	uint16_t data_id; // Low 16 bits of data_id
+};
+
+struct CompactKeyframe {
+	uint16_t x, y, z;
+};
+
+struct CompactDelta {
+	uint8_t ref; // Low byte of the data_id the delta applies to
+	int8_t dx, dy, dz;
+};
+
+struct CompactTime {
+	uint8_t kind; // COMPACT_TIME
+	uint8_t reserved[3];
+	uint64_t sensor_time;
+	uint64_t capture_time;
+	uint64_t send_time;
+};
+#pragma pack(pop)
+
+// Decoded message, independent of the wire format
+struct Message {
+	MessageType type;
+	int data_id;
+	int player_id;
+	int device_id; // Sensor that saw it, 0 = the first one
+	int hand_id, l_hand, r_hand;
+	float coordinates[3];
+	float c_p1;
+	GestureType gesture;
+	float g_p1, g_p2, g_p3;
+	bool in_session;
+	bool calibrated;
+	uint64_t sensor_time; // Depth frame timestamp (us, sensor clock)
+	uint64_t capture_time; // When the frame was read (us, CLOCK_MONOTONIC)
+	uint64_t send_time; // When it was encoded, 0 = at encoding time
+	// MSG_SKELETON: the joints in the message (all of them when encoded
+	// with a MessageEncoder, which keeps only the changed ones), and the
+	// whole skeleton
+	uint16_t joint_mask;
+	bool keyframe;
+	uint8_t skeleton_ref; // SkeletonPayload.ref
+	SkeletonJoints skeleton;
+};
+
+// CLOCK_MONOTONIC in microseconds, the clock of capture_time and send_time
+uint64_t monotonicMicros();
+
+// Text names of message types and gestures
+const char* messageTypeName(MessageType type);
+MessageType messageTypeFromName(const char *name);
+const char* gestureName(GestureType gesture);
+GestureType gestureFromName(const char *name);
+
+// Coordinates may be lost (e.g. over UDP), events must always arrive
+bool isReliableMessage(MessageType type);
+
+// Fills a message with the defaults used by the text format
+void initMessage(Message &m, MessageType type);
+
+// Encodes the message, returns the number of bytes written or -1
+int encodeText(const Message &m, char *buffer, int bufferLen);
+int encodeBinary(const Message &m, char *buffer, int bufferLen);
+int encodeMessage(WireFormat format, const Message &m, char *buffer,
+		int bufferLen);
+
+/*Decodes one binary frame from buffer.
+ * Returns the number of bytes consumed, 0 if the frame is incomplete and -1 if
+ * the buffer doesn't start with a valid frame
+ */
+int decodeBinary(const char *buffer, int bufferLen, Message &m);
+
+/*Decodes one "#...#" text record from buffer, the fields after data_id may be
+ * left out (e.g. "#resume|41#"). Returns like decodeBinary.
+ */
+int decodeText(const char *buffer, int bufferLen, Message &m);
+
+// Last point sent/received on a compact coordinates stream
+struct CompactPoint {
+	uint16_t x, y, z;
+	int data_id;
+	int samples; // Since the last keyframe
+	bool valid;
+};
+
+// Last skeleton sent/received for a player of a device
+struct SkeletonState {
+	SkeletonJoints joints;
+	int data_id;
+	int samples; // Since the last keyframe
+	bool valid;
+};
+
+/*Encoder for all the wire formats. Compact coordinates are quantized to
+ * 16 bits and sent as deltas against the last point sent on the same stream,
+ * with a keyframe every COMPACT_KEYFRAME_INTERVAL samples (or when a delta
+ * doesn't fit) so receivers can resynchronize. Skeletons (binary and compact)
+ * only carry the joints that changed since the last one sent for the player,
+ * with a keyframe every SKELETON_KEYFRAME_INTERVAL; a skeleton without changes
+ * isn't sent at all (encode() returns 0).
+ */
+class MessageEncoder {
+public:
+	MessageEncoder(WireFormat format = WIRE_FORMAT_TEXT);
+
+	void setFormat(WireFormat format);
+
+	WireFormat getFormat() const {
+		return format;
+	}
+
+	// Returns the number of bytes written or -1
+	int encode(const Message &m, char *buffer, int bufferLen);
+
+	// Next coordinates of every stream are sent as keyframes
+	void reset();
+
+	// Every compact record gets its own time record, so losing the first one
+	// of a frame doesn't leave the others with the times of the last frame
+	void setTimePerRecord(bool perRecord) {
+		time_per_record = perRecord;
+	}
+
+private:
+	int encodeCompact(const Message &m, char *buffer, int bufferLen);
+	int encodeSkeleton(const Message &m, char *buffer, int bufferLen);
+
+	WireFormat format;
+	bool time_per_record;
+	CompactPoint last[COMPACT_MAX_STREAMS];
+	uint64_t last_sensor_time; // Of the last time record
+	uint64_t last_capture_time;
+	SkeletonState skeletons[MAX_DEVICES][SKELETON_MAX_PLAYERS];
+};
+
+/*Decoder for binary and compact streams, it keeps the last point of each
+ * compact stream, the last full data_id and the last time record to rebuild
+ * compact messages, and the skeleton of each player to fill in the joints a
+ * MSG_SKELETON leaves out. Returns like decodeBinary; a delta that can't be
+ * applied (or a skeleton before its first keyframe) is consumed and returned
+ * as a MSG_NONE message.
+ */
+class MessageDecoder {
+public:
+	MessageDecoder();
+
+	int decode(const char *buffer, int bufferLen, Message &m);
+
+	void reset();
+
+	/*Microseconds from the sensor frame of m to applyTime (CLOCK_MONOTONIC of
+	 * this machine, e.g. monotonicMicros() when the message is applied), -1
+	 * if m has no times. The sensor clock is mapped with the smallest
+	 * capture_time - sensor_time seen, so the fixed transfer delay of the
+	 * sensor isn't included. On another machine than the client, applyTime
+	 * must be in the client's clock.
+	 */
+	int64_t sensorLatency(const Message &m, uint64_t applyTime) const;
+
+private:
+	int decodeCompact(const char *buffer, int bufferLen, Message &m);
+	void applySkeleton(Message &m);
+	void updateSensorOffset(const Message &m);
+
+	int last_data_id;
+	CompactPoint last[COMPACT_MAX_STREAMS];
+	CompactTime last_time; // Of the compact records that follow
+	bool has_sensor_offset;
+	int64_t sensor_offset; // Smallest capture_time - sensor_time
+	SkeletonState skeletons[MAX_DEVICES][SKELETON_MAX_PLAYERS];
+};
+
+#endif /* PROTOCOL_H_ */
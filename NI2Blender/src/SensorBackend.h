@@ -0,0 +1,100 @@
+/*
+ * SensorBackend.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SENSORBACKEND_H_
+#define SENSORBACKEND_H_
+
+#include <stdint.h>
+#include "Protocol.h"
+
+// Frames a backend read in one update()
+struct SensorUpdate {
+	bool new_depth; // A new depth frame (sensor_time is its timestamp)
+	bool new_user; // New skeleton data
+	bool new_image; // A new RGB image (OpenNI only)
+	uint32_t frame_id; // Of the depth frame
+	uint64_t sensor_time; // us, sensor clock
+};
+
+// A joint of a tracked user in the current frame
+struct SensorJoint {
+	float position[3]; // Real world (mm)
+	float confidence; // 0 if the joint isn't tracked
+	float orientation[9]; // Rotation matrix, row major
+	float orientation_confidence; // 0 if orientation isn't valid
+};
+
+/*What a backend reports while it reads a frame, on the capture thread
+ * (inside SensorBackend::update()). User ids are 1 to MAX_USERS - 1.
+ */
+class SensorListener {
+public:
+	virtual ~SensorListener() {
+	}
+
+	// A user finished calibrating, its skeleton is tracked from now on
+	virtual void userCalibrated(int user) = 0;
+
+	// A tracked user was lost, or left the field of view (exited)
+	virtual void userLost(int user, bool exited) = 0;
+
+	// The session (the single hand point the gestures follow) started/ended
+	virtual void sessionStarted() = 0;
+
+	virtual void sessionEnded() = 0;
+
+	// A gesture of the session's hand, p1 to p3 as in Message::g_p1..g_p3
+	virtual void gestureDetected(GestureType gesture, float p1, float p2,
+			float p3) = 0;
+};
+
+/*Where the pipeline gets its frames, joints and events from. The tracking
+ * core (TrackingCore) only sees this interface, so it builds and runs without
+ * OpenNI/NITE: NiteBackend reads a sensor (or an .oni recording), and
+ * SyntheticBackend makes users up. Every method is called from the capture
+ * thread, except stop().
+ */
+class SensorBackend {
+public:
+	virtual ~SensorBackend() {
+	}
+
+	// Starts generating, the events go to listener. Returns false (with the
+	// reason printed) if it can't
+	virtual bool start(SensorListener *listener) = 0;
+
+	// Stops generating (the capture thread must be done with it)
+	virtual void stop() = 0;
+
+	// Waits for the next frame of any stream and runs the tracking on it,
+	// reporting its events. Returns false if it couldn't be read
+	virtual bool update(SensorUpdate &u) = 0;
+
+	// A recording or a finite run has no more frames
+	virtual bool atEnd() const = 0;
+
+	// Timestamp of the current depth frame (us, sensor clock)
+	virtual uint64_t timestamp() const = 0;
+
+	// Field of view of the depth map (rad) and its resolution, to project
+	// the joints
+	virtual void getFieldOfView(double &hFov, double &vFov) const = 0;
+
+	virtual void getResolution(int &xRes, int &yRes) const = 0;
+
+	// The skeleton of user is tracked in the current frame
+	virtual bool isTracking(int user) = 0;
+
+	// A joint (SkeletonJointIndex) of a tracked user in the current frame
+	virtual void getJoint(int user, int joint, SensorJoint &j) = 0;
+
+	// The user of the session is gone: ends it, so the next one starts with
+	// another user's hand
+	virtual void endSession() = 0;
+};
+
+#endif /* SENSORBACKEND_H_ */
@@ -0,0 +1,105 @@
+/*
+ * SensorDevice.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "SensorDevice.h"
+
+SensorDevice::SensorDevice(int source, int deviceId, StreamMerger *merger) {
+	this->source = source;
+	device_id = deviceId;
+	this->merger = merger;
+	backend = NULL;
+	running = false;
+	stopping = false;
+	n_frames = 0;
+}
+
+SensorDevice::~SensorDevice() {
+	stop();
+	delete backend;
+}
+
+bool SensorDevice::start(int index, bool mirror) {
+	backend = new NiteBackend(mirror, true);
+	backend->setDevice(index);
+	if (!backend->start(&core)) {
+		printf("\nDevice %d: sensor %d couldn't be opened", device_id, index);
+		backend->stop();
+		return false;
+	}
+	core.setSensor(backend);
+	core.setSender(push, this);
+	core.setDeviceId(device_id);
+	core.setFullSkeleton(true);
+	core.setHandsTracking(false);
+	core.setNumbering(false); // Numbered once merged
+	if (pthread_create(&thread, NULL, run, this) != 0) {
+		printf("\nDevice %d: couldn't create the capture thread", device_id);
+		backend->stop();
+		return false;
+	}
+	running = true;
+	printf("\nDevice %d: sensor %d started", device_id, index);
+	return true;
+}
+
+void SensorDevice::stop() {
+	if (!running)
+		return;
+	__atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+	pthread_join(thread, NULL);
+	running = false;
+	backend->stop();
+}
+
+void* SensorDevice::run(void *arg) {
+	((SensorDevice*) arg)->loop();
+	return NULL;
+}
+
+// Like the first sensor's loop (updateFrame() in main.cpp), each frame with
+// new skeleton data goes to the merger once the core sent it
+void SensorDevice::loop() {
+	int failures = 0;
+	int delay = DEVICE_RETRY_MIN_DELAY;
+	while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+		SensorUpdate u;
+		if (!backend->update(u)) {
+			if (++failures == DEVICE_MAX_FAILURES) {
+				printf("\nDevice %d: %d reads failed, giving it up", device_id,
+						failures);
+				return;
+			}
+			if (failures == 1)
+				printf("\nDevice %d: read failed, trying again", device_id);
+			usleep(delay * 1000);
+			delay = delay * 2 < DEVICE_RETRY_MAX_DELAY ? delay * 2
+					: DEVICE_RETRY_MAX_DELAY;
+			continue;
+		}
+		if (failures > 0) {
+			printf("\nDevice %d: reading again", device_id);
+			failures = 0;
+			delay = DEVICE_RETRY_MIN_DELAY;
+		}
+		if (u.new_depth)
+			core.stampFrame();
+		if (!u.new_user)
+			continue;
+		core.processFrame(snapshot);
+		merger->endFrame(source, core.frameCaptureTime());
+		__atomic_add_fetch(&n_frames, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// Sender of the core: the merger keeps the events even when its queue is
+// full, coordinates are dropped (and counted)
+void SensorDevice::push(const Message &m, void *cookie) {
+	SensorDevice *d = (SensorDevice*) cookie;
+	d->merger->push(d->source, m);
+}
@@ -0,0 +1,69 @@
+/*
+ * SensorDevice.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SENSORDEVICE_H_
+#define SENSORDEVICE_H_
+
+#include <pthread.h>
+#include "Protocol.h"
+#include "NiteBackend.h"
+#include "TrackingCore.h"
+#include "StreamMerger.h"
+
+// Wait after a failed read, doubled after each one in a row (ms)
+#define DEVICE_RETRY_MIN_DELAY 10
+#define DEVICE_RETRY_MAX_DELAY 500
+
+// Failed reads in a row after which the device is given up
+#define DEVICE_MAX_FAILURES 20
+
+/*A sensor after the first one (--all-devices): a NiteBackend opened on that
+ * device (setDevice()), so its generators are only updated by its own capture
+ * thread, and a TrackingCore that only sends skeletons. Every user who
+ * calibrates is tracked, and each frame sends the full skeleton of each of
+ * them (MSG_SKELETON, device_id set) and its user events to the merger. The
+ * NITE session and gestures stay on the first sensor. A failed read is tried
+ * again after a growing delay; after DEVICE_MAX_FAILURES in a row the capture
+ * thread ends, and the merger goes on without the sensor.
+ */
+class SensorDevice {
+public:
+	// source is its queue in the merger
+	SensorDevice(int source, int deviceId, StreamMerger *merger);
+	~SensorDevice();
+
+	/*Opens the sensor at index (in the order OpenNI enumerates them) and
+	 * starts its capture thread. Returns false, with the reason printed, if
+	 * it couldn't.
+	 */
+	bool start(int index, bool mirror);
+
+	// Waits for the frame being processed and closes the sensor
+	void stop();
+
+	unsigned long getFrames() const {
+		return __atomic_load_n(&n_frames, __ATOMIC_RELAXED);
+	}
+
+private:
+	static void* run(void *arg);
+	void loop();
+	static void push(const Message &m, void *cookie);
+
+	int source;
+	int device_id;
+	StreamMerger *merger;
+	NiteBackend *backend;
+	TrackingCore core;
+	SkeletonSnapshot snapshot; // Of the frame being processed
+	pthread_t thread;
+	bool running;
+	bool stopping;
+	unsigned long n_frames;
+};
+
+#endif /* SENSORDEVICE_H_ */
@@ -0,0 +1,188 @@
+/*
+ * ShmRing.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "ShmRing.h"
+
+// Not private: the futex word is shared between processes
+static int futex(uint32_t *addr, int op, uint32_t val, const timespec *timeout) {
+	return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+ShmRing::ShmRing() {
+	owner = false;
+	header = NULL;
+	data = NULL;
+	mapped_size = 0;
+	pending_pos = 0;
+}
+
+ShmRing::~ShmRing() {
+	close();
+}
+
+bool ShmRing::create(const string &name, uint64_t capacity) {
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		printf("\nShared memory capacity must be a power of two");
+		return false;
+	}
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (fd < 0) {
+		printf("\nshm_open(%s) failed: %s", name.c_str(), strerror(errno));
+		return false;
+	}
+	size_t size = sizeof(ShmRingHeader) + capacity;
+	if (ftruncate(fd, size) < 0) {
+		printf("\nftruncate(%s) failed: %s", name.c_str(), strerror(errno));
+		::close(fd);
+		return false;
+	}
+	if (!map(fd, size))
+		return false;
+	this->name = name;
+	owner = true;
+
+	memset(header, 0, sizeof(ShmRingHeader));
+	header->capacity = capacity;
+	header->version = SHM_RING_VERSION;
+	// The magic goes last, readers wait for it
+	__atomic_store_n(&header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+	pending_pos = 0;
+	return true;
+}
+
+bool ShmRing::open(const string &name) {
+	int fd = shm_open(name.c_str(), O_RDWR, 0600);
+	if (fd < 0) {
+		printf("\nshm_open(%s) failed: %s", name.c_str(), strerror(errno));
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(ShmRingHeader)) {
+		printf("\n%s is not a ring buffer", name.c_str());
+		::close(fd);
+		return false;
+	}
+	if (!map(fd, st.st_size))
+		return false;
+	if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC
+			|| header->version != SHM_RING_VERSION || sizeof(ShmRingHeader)
+			+ header->capacity > mapped_size) {
+		printf("\n%s has an unknown format", name.c_str());
+		close();
+		return false;
+	}
+	this->name = name;
+	owner = false;
+	return true;
+}
+
+bool ShmRing::map(int fd, size_t size) {
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd); // The mapping keeps the object alive
+	if (p == MAP_FAILED) {
+		printf("\nmmap failed: %s", strerror(errno));
+		return false;
+	}
+	header = (ShmRingHeader*) p;
+	data = (char*) p + sizeof(ShmRingHeader);
+	mapped_size = size;
+	return true;
+}
+
+void ShmRing::close() {
+	if (header == NULL)
+		return;
+	munmap(header, mapped_size);
+	if (owner)
+		shm_unlink(name.c_str());
+	header = NULL;
+	data = NULL;
+	mapped_size = 0;
+}
+
+char* ShmRing::reserve(uint32_t maxLen) {
+	uint64_t capacity = header->capacity;
+	uint64_t need = recordSpace(maxLen);
+	uint64_t w = header->write_pos;
+	uint64_t r = __atomic_load_n(&header->read_pos, __ATOMIC_ACQUIRE);
+	uint64_t tail_room = capacity - (w & (capacity - 1));
+
+	// Records never wrap, the end of the area is skipped if needed
+	uint64_t skip = need > tail_room ? tail_room : 0;
+	if (need > capacity / 2 || w + skip + need - r > capacity)
+		return NULL;
+	if (skip != 0) {
+		ShmRecordHeader *padding = recordAt(w);
+		padding->size = (uint32_t) (tail_room - sizeof(ShmRecordHeader));
+		padding->type = SHM_RECORD_PADDING;
+		padding->flags = 0;
+	}
+	pending_pos = w + skip;
+	return (char*) (recordAt(pending_pos) + 1);
+}
+
+void ShmRing::commit(ShmRecordType type, uint32_t len) {
+	ShmRecordHeader *record = recordAt(pending_pos);
+	record->size = len;
+	record->type = (uint16_t) type;
+	record->flags = 0;
+	pending_pos += recordSpace(len);
+
+	__atomic_store_n(&header->write_pos, pending_pos, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&header->write_seq, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&header->waiters, __ATOMIC_SEQ_CST) != 0)
+		futex(&header->write_seq, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+const ShmRecordHeader* ShmRing::peek() {
+	uint64_t r = header->read_pos;
+	uint64_t w = __atomic_load_n(&header->write_pos, __ATOMIC_ACQUIRE);
+	while (r != w) {
+		ShmRecordHeader *record = recordAt(r);
+		if (record->type != SHM_RECORD_PADDING)
+			return record;
+		r += recordSpace(record->size);
+		__atomic_store_n(&header->read_pos, r, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+void ShmRing::release() {
+	uint64_t r = header->read_pos;
+	r += recordSpace(recordAt(r)->size);
+	__atomic_store_n(&header->read_pos, r, __ATOMIC_RELEASE);
+}
+
+bool ShmRing::wait(int timeoutMs) {
+	uint32_t seq = __atomic_load_n(&header->write_seq, __ATOMIC_SEQ_CST);
+	if (peek() != NULL)
+		return true;
+	timespec ts;
+	ts.tv_sec = timeoutMs / 1000;
+	ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+	__atomic_add_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+	// Returns at once if a commit happened after seq was read
+	futex(&header->write_seq, FUTEX_WAIT, seq, &ts);
+	__atomic_sub_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+	return peek() != NULL;
+}
+
+uint64_t ShmRing::used() const {
+	return __atomic_load_n(&header->write_pos, __ATOMIC_ACQUIRE)
+			- __atomic_load_n(&header->read_pos, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,138 @@
+/*
+ * ShmRing.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SHMRING_H_
+#define SHMRING_H_
+
+#include <stdint.h>
+#include <string>
+using namespace std;
+
+#define SHM_RING_MAGIC 0x474E5242 // "BRNG"
+#define SHM_RING_VERSION 1
+#define SHM_RECORD_ALIGN 8
+
+// Type of each record of the ring
+enum ShmRecordType {
+	SHM_RECORD_PADDING = 0, // Skip it, the next record starts at offset 0
+	SHM_RECORD_MESSAGE = 1, // One encoded message (text or binary format)
+	SHM_RECORD_DEPTH_FRAME = 2, // ShmFrameHeader + 16 bit depth map (mm)
+	SHM_RECORD_IMAGE_FRAME = 3 // ShmFrameHeader + RGB24 image
+};
+
+/*Layout of the shared memory object (little endian):
+ *   ShmRingHeader (192 bytes) followed by capacity bytes of records.
+ * Positions are byte counters that only grow; a record starts at
+ * data + (pos % capacity), is aligned to 8 bytes and never wraps (a padding
+ * record fills the end of the area instead). The reader consumes records in
+ * place and then stores the position after them in read_pos.
+ */
+struct ShmRingHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t capacity; // Bytes of the record area (power of two)
+	char pad0[48];
+	uint64_t write_pos; // Written by the writer only
+	uint32_t write_seq; // Incremented on each commit (futex word)
+	uint32_t waiters; // Readers sleeping on write_seq
+	char pad1[48];
+	uint64_t read_pos; // Written by the reader only
+	char pad2[56];
+};
+
+struct ShmRecordHeader {
+	uint32_t size; // Payload bytes, without this header and the padding
+	uint16_t type; // ShmRecordType
+	uint16_t flags;
+};
+
+// Header of SHM_RECORD_DEPTH_FRAME and SHM_RECORD_IMAGE_FRAME payloads
+struct ShmFrameHeader {
+	uint32_t frame_id;
+	uint16_t width;
+	uint16_t height;
+	uint16_t bytes_per_pixel;
+	uint16_t reserved;
+	uint64_t timestamp; // Sensor timestamp (us)
+};
+
+/*Single writer / single reader ring buffer in POSIX shared memory, for a
+ * Blender running on the same machine. The writer builds each record directly
+ * in the mapped area (reserve() + commit()) and the reader gets a pointer to
+ * it (peek() + release()), so there is no copy and no syscall per message:
+ * the futex is only touched when the reader is sleeping in wait().
+ */
+class ShmRing {
+public:
+	ShmRing();
+	~ShmRing();
+
+	// Writer: creates (or resets) the shared memory object name
+	bool create(const string &name, uint64_t capacity);
+
+	// Reader: maps an object created by the writer
+	bool open(const string &name);
+
+	// Unmaps it, and the writer also removes the name
+	void close();
+
+	//-------------------------------------------------------------------------
+	// Writer
+	//-------------------------------------------------------------------------
+
+	// Returns where to write up to maxLen bytes of payload, NULL if full
+	char* reserve(uint32_t maxLen);
+
+	// Publishes the reserved record with its real length
+	void commit(ShmRecordType type, uint32_t len);
+
+	//-------------------------------------------------------------------------
+	// Reader
+	//-------------------------------------------------------------------------
+
+	// Oldest record not released yet, NULL if there is none
+	const ShmRecordHeader* peek();
+
+	// Payload of a record returned by peek()
+	static const char* payload(const ShmRecordHeader *record) {
+		return (const char*) (record + 1);
+	}
+
+	// Releases the record returned by peek()
+	void release();
+
+	// Sleeps until there is a record or timeoutMs passes
+	bool wait(int timeoutMs);
+
+	bool isOpen() const {
+		return header != NULL;
+	}
+
+	// Bytes written and not read yet
+	uint64_t used() const;
+
+private:
+	ShmRecordHeader* recordAt(uint64_t pos) const {
+		return (ShmRecordHeader*) (data + (pos & (header->capacity - 1)));
+	}
+
+	static uint64_t recordSpace(uint32_t len) {
+		return (sizeof(ShmRecordHeader) + len + SHM_RECORD_ALIGN - 1)
+				& ~(uint64_t) (SHM_RECORD_ALIGN - 1);
+	}
+
+	bool map(int fd, size_t size);
+
+	string name;
+	bool owner; // Created by us (writer)
+	ShmRingHeader *header;
+	char *data;
+	size_t mapped_size;
+	uint64_t pending_pos; // Writer: position of the reserved record
+};
+
+#endif /* SHMRING_H_ */
@@ -0,0 +1,388 @@
+/*
+ * SkeletonFusion.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "SkeletonFusion.h"
+
+// Depth map of the sensors (VGA), and of the output
+#define FUSION_X_RES 640
+#define FUSION_Y_RES 480
+
+void defaultCalibration(SensorCalibration &c) {
+	memset(&c, 0, sizeof(c));
+	c.h_fov = FUSION_DEFAULT_HFOV;
+	c.v_fov = FUSION_DEFAULT_VFOV;
+	c.r[0] = c.r[4] = c.r[8] = 1;
+}
+
+// a * b, quaternions as x, y, z, w
+static void multiply(const float a[4], const float b[4], float out[4]) {
+	out[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	out[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+	out[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+	out[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+}
+
+SkeletonFusion::SkeletonFusion() {
+	memset(sources, 0, sizeof(sources));
+	memset(fused, 0, sizeof(fused));
+	n_users = 0;
+	SensorCalibration c;
+	defaultCalibration(c);
+	for (int d = 0; d < MAX_DEVICES; d++)
+		setCalibration(d, c);
+}
+
+void SkeletonFusion::makeProjection(double hFov, double vFov, Projection &p) {
+	p.coeff_x = (float) (FUSION_X_RES / (2 * tan(hFov / 2)));
+	p.coeff_y = (float) (FUSION_Y_RES / (2 * tan(vFov / 2)));
+	p.half_x = FUSION_X_RES / 2.0f;
+	p.half_y = FUSION_Y_RES / 2.0f;
+}
+
+void SkeletonFusion::setCalibration(int device, const SensorCalibration &c) {
+	calibrations[device] = c;
+	makeProjection(c.h_fov, c.v_fov, projections[device]);
+	SkeletonJoints rotation;
+	setJointOrientation(rotation, 0, c.r);
+	rotations[device][0] = rotation.qx[0];
+	rotations[device][1] = rotation.qy[0];
+	rotations[device][2] = rotation.qz[0];
+	rotations[device][3] = rotation.qw[0];
+}
+
+bool SkeletonFusion::loadCalibration(const char *path) {
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		printf("\nCouldn't open the calibration file %s", path);
+		return false;
+	}
+	char line[512];
+	int number = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), f) != NULL) {
+		number++;
+		char first[2];
+		if (sscanf(line, " %1s", first) != 1 || first[0] == '#')
+			continue; // Empty line or comment
+		int device;
+		SensorCalibration c;
+		float *r = c.r;
+		int n = sscanf(line, "%d %lf %lf %f %f %f %f %f %f %f %f %f %f %f %f",
+				&device, &c.h_fov, &c.v_fov, &r[0], &r[1], &r[2], &r[3], &r[4],
+				&r[5], &r[6], &r[7], &r[8], &c.t[0], &c.t[1], &c.t[2]);
+		if (n != 15 || device < 0 || device >= MAX_DEVICES) {
+			printf("\n%s:%d: expected device (0 to %d), 2 fields of view, "
+				"9 rotation and 3 translation values", path, number,
+					MAX_DEVICES - 1);
+			ok = false;
+		} else {
+			setCalibration(device, c);
+		}
+	}
+	fclose(f);
+	return ok;
+}
+
+// Real world joints of a sensor (from its projective ones) in the world frame
+void SkeletonFusion::toWorld(int device, const SkeletonJoints &in,
+		SkeletonJoints &out) const {
+	const Projection &p = projections[device];
+	const float *r = calibrations[device].r;
+	const float *t = calibrations[device].t;
+	for (int i = 0; i < SKELETON_JOINTS; i++) {
+		float z = in.z[i];
+		float x = (in.x[i] - p.half_x) * z / p.coeff_x;
+		float y = (p.half_y - in.y[i]) * z / p.coeff_y;
+		out.x[i] = r[0] * x + r[1] * y + r[2] * z + t[0];
+		out.y[i] = r[3] * x + r[4] * y + r[5] * z + t[1];
+		out.z[i] = r[6] * x + r[7] * y + r[8] * z + t[2];
+		out.confidence[i] = z > 0 ? in.confidence[i] : 0;
+		float q[4] = { in.qx[i], in.qy[i], in.qz[i], in.qw[i] };
+		float w[4];
+		multiply(rotations[device], q, w);
+		out.qx[i] = w[0];
+		out.qy[i] = w[1];
+		out.qz[i] = w[2];
+		out.qw[i] = w[3];
+	}
+}
+
+void SkeletonFusion::toOutput(int device, const float in[3], float out[3]) const {
+	SkeletonJoints a, b;
+	clearSkeleton(a);
+	a.x[0] = in[0];
+	a.y[0] = in[1];
+	a.z[0] = in[2];
+	toWorld(device, a, b);
+	const Projection &p = projections[0];
+	if (b.z[0] <= 0) {
+		out[0] = out[1] = out[2] = 0;
+		return;
+	}
+	out[0] = p.half_x + p.coeff_x * b.x[0] / b.z[0];
+	out[1] = p.half_y - p.coeff_y * b.y[0] / b.z[0];
+	out[2] = b.z[0];
+}
+
+void SkeletonFusion::addSkeleton(const Message &m) {
+	if (m.device_id < 0 || m.device_id >= MAX_DEVICES || m.player_id < 0
+			|| m.player_id >= SKELETON_MAX_PLAYERS)
+		return;
+	SourceUser &s = sources[m.device_id][m.player_id];
+	if (s.active && m.capture_time <= s.last.time)
+		return; // Out of order
+	if (s.active) {
+		s.prev = s.last;
+		s.has_prev = true;
+	} else {
+		s.active = true;
+		s.fused_id = -1;
+		s.has_prev = false;
+	}
+	s.last.time = m.capture_time;
+	toWorld(m.device_id, m.skeleton, s.last.joints);
+	if (s.fused_id < 0)
+		associate(m.device_id, m.player_id);
+	if (s.fused_id >= 0 && s.last.time > fused[s.fused_id].seen_time)
+		fused[s.fused_id].seen_time = s.last.time;
+}
+
+void SkeletonFusion::removeSkeleton(int device, int player) {
+	if (device < 0 || device >= MAX_DEVICES || player < 0 || player
+			>= SKELETON_MAX_PLAYERS)
+		return;
+	sources[device][player].active = false;
+	sources[device][player].fused_id = -1;
+}
+
+int SkeletonFusion::fusedUser(int device, int player) const {
+	if (device < 0 || device >= MAX_DEVICES || player < 0 || player
+			>= SKELETON_MAX_PLAYERS || !sources[device][player].active)
+		return -1;
+	return sources[device][player].fused_id;
+}
+
+// Nearest fused user not seen by this sensor yet, or a new one
+void SkeletonFusion::associate(int device, int player) {
+	SourceUser &s = sources[device][player];
+	const SkeletonJoints &j = s.last.joints;
+	if (j.confidence[SKELETON_TORSO] <= 0)
+		return; // Tried again with the next skeleton
+	float best = FUSION_MATCH_DISTANCE * FUSION_MATCH_DISTANCE;
+	int match = -1;
+	for (int id = 1; id < MAX_USERS; id++) {
+		if (!fused[id].active)
+			continue;
+		bool taken = false;
+		for (int p = 0; p < SKELETON_MAX_PLAYERS && !taken; p++)
+			taken = sources[device][p].active && sources[device][p].fused_id
+					== id;
+		if (taken)
+			continue;
+		float dx = j.x[SKELETON_TORSO] - fused[id].torso[0];
+		float dy = j.y[SKELETON_TORSO] - fused[id].torso[1];
+		float dz = j.z[SKELETON_TORSO] - fused[id].torso[2];
+		float d = dx * dx + dy * dy + dz * dz;
+		if (d < best) {
+			best = d;
+			match = id;
+		}
+	}
+	if (match < 0) {
+		for (int id = 1; id < MAX_USERS && match < 0; id++)
+			if (!fused[id].active)
+				match = id;
+		if (match < 0)
+			return; // Every id in use
+		FusedUser &u = fused[match];
+		u.active = true;
+		u.torso[0] = j.x[SKELETON_TORSO];
+		u.torso[1] = j.y[SKELETON_TORSO];
+		u.torso[2] = j.z[SKELETON_TORSO];
+		u.last_time = 0;
+		u.seen_time = s.last.time;
+		n_users++;
+		addEvent(MSG_NEW_USER_CALIBRATED, match);
+	}
+	s.fused_id = match;
+}
+
+// Skeleton of a sensor's user at time, interpolated between its last two
+void SkeletonFusion::sampleAt(const SourceUser &s, uint64_t time,
+		SkeletonJoints &out) const {
+	if (!s.has_prev || time >= s.last.time) {
+		out = s.last.joints;
+		return;
+	}
+	if (time <= s.prev.time) {
+		out = s.prev.joints;
+		return;
+	}
+	const SkeletonJoints &a = s.prev.joints;
+	const SkeletonJoints &b = s.last.joints;
+	float k = (float) (time - s.prev.time) / (float) (s.last.time
+			- s.prev.time);
+	for (int i = 0; i < SKELETON_JOINTS; i++) {
+		out.x[i] = a.x[i] + (b.x[i] - a.x[i]) * k;
+		out.y[i] = a.y[i] + (b.y[i] - a.y[i]) * k;
+		out.z[i] = a.z[i] + (b.z[i] - a.z[i]) * k;
+		out.confidence[i] = a.confidence[i] < b.confidence[i] ? a.confidence[i]
+				: b.confidence[i];
+		// Shortest way between the two rotations, then normalized
+		float sign = a.qx[i] * b.qx[i] + a.qy[i] * b.qy[i] + a.qz[i] * b.qz[i]
+				+ a.qw[i] * b.qw[i] < 0 ? -1.0f : 1.0f;
+		float q[4] = { a.qx[i] + (sign * b.qx[i] - a.qx[i]) * k, a.qy[i]
+				+ (sign * b.qy[i] - a.qy[i]) * k, a.qz[i] + (sign * b.qz[i]
+				- a.qz[i]) * k, a.qw[i] + (sign * b.qw[i] - a.qw[i]) * k };
+		float norm = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3]
+				* q[3]);
+		if (norm == 0)
+			norm = 1;
+		out.qx[i] = q[0] / norm;
+		out.qy[i] = q[1] / norm;
+		out.qz[i] = q[2] / norm;
+		out.qw[i] = q[3] / norm;
+	}
+}
+
+// One skeleton from every sensor that sees user id, at the time of the one
+// most behind. Returns false if there is nothing new.
+bool SkeletonFusion::fuseUser(int id, uint64_t now, Message &m) {
+	const SourceUser *members[MAX_DEVICES * SKELETON_MAX_PLAYERS];
+	int n = 0;
+	uint64_t time = 0;
+	for (int d = 0; d < MAX_DEVICES; d++) {
+		for (int p = 0; p < SKELETON_MAX_PLAYERS; p++) {
+			const SourceUser &s = sources[d][p];
+			if (!s.active || s.fused_id != id || s.last.time + FUSION_MAX_AGE
+					< now)
+				continue;
+			if (n == 0 || s.last.time < time)
+				time = s.last.time;
+			members[n++] = &s;
+		}
+	}
+	FusedUser &u = fused[id];
+	if (n == 0 || time <= u.last_time)
+		return false;
+
+	float sx[SKELETON_JOINT_SLOTS], sy[SKELETON_JOINT_SLOTS],
+			sz[SKELETON_JOINT_SLOTS], sw[SKELETON_JOINT_SLOTS];
+	float q[SKELETON_JOINT_SLOTS][4];
+	initMessage(m, MSG_SKELETON);
+	SkeletonJoints &out = m.skeleton;
+	clearSkeleton(out);
+	memset(sx, 0, sizeof(sx));
+	memset(sy, 0, sizeof(sy));
+	memset(sz, 0, sizeof(sz));
+	memset(sw, 0, sizeof(sw));
+	memset(q, 0, sizeof(q));
+	for (int k = 0; k < n; k++) {
+		SkeletonJoints j;
+		sampleAt(*members[k], time, j);
+		for (int i = 0; i < SKELETON_JOINTS; i++) {
+			float w = j.confidence[i];
+			if (w <= 0)
+				continue; // Occluded: the other sensors fill it in
+			sx[i] += w * j.x[i];
+			sy[i] += w * j.y[i];
+			sz[i] += w * j.z[i];
+			// Rotations on the same side as the first one (q and -q are the
+			// same) so they don't cancel out
+			float sign = q[i][0] * j.qx[i] + q[i][1] * j.qy[i] + q[i][2]
+					* j.qz[i] + q[i][3] * j.qw[i] < 0 ? -w : w;
+			q[i][0] += sign * j.qx[i];
+			q[i][1] += sign * j.qy[i];
+			q[i][2] += sign * j.qz[i];
+			q[i][3] += sign * j.qw[i];
+			sw[i] += w;
+			if (w > out.confidence[i])
+				out.confidence[i] = w;
+		}
+	}
+
+	const Projection &p = projections[0];
+	for (int i = 0; i < SKELETON_JOINTS; i++) {
+		if (sw[i] <= 0)
+			continue; // No sensor sees it
+		float x = sx[i] / sw[i], y = sy[i] / sw[i], z = sz[i] / sw[i];
+		if (i == SKELETON_TORSO) {
+			u.torso[0] = x;
+			u.torso[1] = y;
+			u.torso[2] = z;
+		}
+		if (z <= 0) {
+			out.confidence[i] = 0;
+			continue;
+		}
+		out.x[i] = p.half_x + p.coeff_x * x / z;
+		out.y[i] = p.half_y - p.coeff_y * y / z;
+		out.z[i] = z;
+		float norm = sqrtf(q[i][0] * q[i][0] + q[i][1] * q[i][1] + q[i][2]
+				* q[i][2] + q[i][3] * q[i][3]);
+		if (norm > 0) {
+			float sign = q[i][3] < 0 ? -1.0f : 1.0f; // w >= 0, as NITE's
+			out.qx[i] = sign * q[i][0] / norm;
+			out.qy[i] = sign * q[i][1] / norm;
+			out.qz[i] = sign * q[i][2] / norm;
+			out.qw[i] = sign * q[i][3] / norm;
+		}
+	}
+	u.last_time = time;
+	m.player_id = id;
+	m.calibrated = true;
+	m.capture_time = time;
+	m.joint_mask = SKELETON_ALL_JOINTS;
+	return true;
+}
+
+void SkeletonFusion::addEvent(MessageType type, int id) {
+	Message m;
+	initMessage(m, type);
+	m.player_id = id;
+	m.calibrated = n_users > 0; // After the event
+	events.push_back(m);
+}
+
+int SkeletonFusion::fuse(uint64_t now, Message *out, int maxOut) {
+	// Sensors that stopped sending (e.g. disconnected) leave their users
+	for (int d = 0; d < MAX_DEVICES; d++)
+		for (int p = 0; p < SKELETON_MAX_PLAYERS; p++)
+			if (sources[d][p].active && sources[d][p].last.time
+					+ FUSION_LOST_TIME < now)
+				removeSkeleton(d, p);
+	// A user nobody sees any more is lost
+	for (int id = 1; id < MAX_USERS; id++) {
+		if (!fused[id].active)
+			continue;
+		bool seen = false;
+		for (int d = 0; d < MAX_DEVICES && !seen; d++)
+			for (int p = 0; p < SKELETON_MAX_PLAYERS && !seen; p++)
+				seen = sources[d][p].active && sources[d][p].fused_id == id;
+		if (seen)
+			continue;
+		fused[id].active = false;
+		n_users--;
+		addEvent(MSG_CALIBRATED_USER_LOST, id);
+	}
+
+	int n = 0;
+	size_t e = 0;
+	for (; e < events.size() && n < maxOut; e++) {
+		out[n] = events[e];
+		out[n].capture_time = now;
+		n++;
+	}
+	events.erase(events.begin(), events.begin() + e);
+	for (int id = 1; id < MAX_USERS && n < maxOut; id++)
+		if (fused[id].active && fuseUser(id, now, out[n]))
+			n++;
+	return n;
+}
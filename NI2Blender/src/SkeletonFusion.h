@@ -0,0 +1,142 @@
+/*
+ * SkeletonFusion.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SKELETONFUSION_H_
+#define SKELETONFUSION_H_
+
+#include <stdint.h>
+#include <vector>
+#include "Protocol.h"
+#include "SkeletonSnapshot.h"
+
+// Field of view of a Kinect depth map (rad), for sensors without calibration
+#define FUSION_DEFAULT_HFOV 1.0144686707507438
+#define FUSION_DEFAULT_VFOV 0.78980943449644714
+
+// Samples older than this (us) aren't fused
+#define FUSION_MAX_AGE 100000
+
+// A fused user with no sample for this long (us) is lost
+#define FUSION_LOST_TIME 1000000
+
+// Two skeletons from different sensors are the same person if their torsos
+// are closer than this (mm)
+#define FUSION_MATCH_DISTANCE 400.0f
+
+/*Pose of a sensor in the common (world) frame: a real world point p of the
+ * sensor (mm, as OpenNI gives them) is r * p + t in the world. The field of
+ * view turns its projective coordinates back into real world ones.
+ */
+struct SensorCalibration {
+	double h_fov, v_fov; // rad
+	float r[9]; // Rotation, row major
+	float t[3]; // Translation (mm)
+};
+
+// Identity pose with the default field of view
+void defaultCalibration(SensorCalibration &c);
+
+/*Fuses the skeletons that several sensors (device_id) see of the same people
+ * into one skeleton per person:
+ * - space: every joint is taken to the world frame with the calibration of
+ *   its sensor, and the result is projected like the joints of a single
+ *   sensor (pixels, z in mm) with the field of view of device 0, as if seen
+ *   by a sensor at the world origin;
+ * - time: the capture_time of each skeleton (already in the local clock) is
+ *   kept, and the other sensors are interpolated to the time of the one that
+ *   is most behind, so every fused skeleton is a single instant;
+ * - association: a skeleton joins the fused user whose torso is within
+ *   FUSION_MATCH_DISTANCE and has no other skeleton from the same sensor, or
+ *   starts a new one;
+ * - each joint is the average of the sensors that see it weighted by their
+ *   confidence, so a joint one sensor can't see (confidence 0) comes from
+ *   the others.
+ * Fused users get their own player ids (1 to MAX_USERS - 1). Single thread.
+ */
+class SkeletonFusion {
+public:
+	SkeletonFusion();
+
+	void setCalibration(int device, const SensorCalibration &c);
+
+	/*Reads the calibration of each sensor from a text file, one line each:
+	 *   device h_fov v_fov r11 r12 r13 r21 r22 r23 r31 r32 r33 tx ty tz
+	 * Lines starting with '#' are comments. Returns false (with the reason
+	 * printed) if the file can't be read or a line is wrong.
+	 */
+	bool loadCalibration(const char *path);
+
+	// A skeleton of a sensor, its capture_time in the local clock
+	void addSkeleton(const Message &m);
+
+	// The user left the view of a sensor
+	void removeSkeleton(int device, int player);
+
+	// Fused user a sensor's user belongs to, -1 if none
+	int fusedUser(int device, int player) const;
+
+	// Projective point of a sensor in the output projection
+	void toOutput(int device, const float in[3], float out[3]) const;
+
+	/*Fused skeletons that have new data at now (local clock), and the user
+	 * events since the last call (MSG_NEW_USER_CALIBRATED and
+	 * MSG_CALIBRATED_USER_LOST, for the fused ids). Returns the number of
+	 * messages written to out, without data_id.
+	 */
+	int fuse(uint64_t now, Message *out, int maxOut);
+
+	// Fused users being tracked
+	int users() const {
+		return n_users;
+	}
+
+private:
+	// Skeleton of a sensor's user in the world frame (real world, mm)
+	struct WorldSample {
+		uint64_t time;
+		SkeletonJoints joints;
+	};
+
+	struct SourceUser {
+		bool active;
+		int fused_id; // -1 until it is associated
+		bool has_prev;
+		WorldSample prev;
+		WorldSample last;
+	};
+
+	struct FusedUser {
+		bool active;
+		float torso[3]; // World, last fused
+		uint64_t last_time; // capture_time of the last fused skeleton
+		uint64_t seen_time; // Of the newest sample of any sensor
+	};
+
+	struct Projection {
+		float coeff_x, coeff_y;
+		float half_x, half_y;
+	};
+
+	static void makeProjection(double hFov, double vFov, Projection &p);
+	void toWorld(int device, const SkeletonJoints &in, SkeletonJoints &out)
+			const;
+	void associate(int device, int player);
+	void sampleAt(const SourceUser &s, uint64_t time, SkeletonJoints &out)
+			const;
+	bool fuseUser(int id, uint64_t now, Message &m);
+	void addEvent(MessageType type, int id);
+
+	SensorCalibration calibrations[MAX_DEVICES];
+	Projection projections[MAX_DEVICES];
+	float rotations[MAX_DEVICES][4]; // calibration.r as a quaternion
+	SourceUser sources[MAX_DEVICES][SKELETON_MAX_PLAYERS];
+	FusedUser fused[MAX_USERS];
+	int n_users;
+	std::vector<Message> events; // Not returned by fuse() yet
+};
+
+#endif /* SKELETONFUSION_H_ */
@@ -0,0 +1,105 @@
+/*
+ * SkeletonJoints.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <math.h>
+#include <string.h>
+#include "SkeletonJoints.h"
+
+void clearSkeleton(SkeletonJoints &s) {
+	memset(&s, 0, sizeof(s));
+	for (int i = 0; i < SKELETON_JOINT_SLOTS; i++)
+		s.qw[i] = 1;
+}
+
+void setJointOrientation(SkeletonJoints &s, int joint, const float m[9]) {
+	float trace = m[0] + m[4] + m[8];
+	float x, y, z, w;
+	if (trace > 0) {
+		float k = 0.5f / sqrtf(trace + 1);
+		w = 0.25f / k;
+		x = (m[7] - m[5]) * k;
+		y = (m[2] - m[6]) * k;
+		z = (m[3] - m[1]) * k;
+	} else if (m[0] > m[4] && m[0] > m[8]) {
+		float k = 2 * sqrtf(1 + m[0] - m[4] - m[8]);
+		w = (m[7] - m[5]) / k;
+		x = 0.25f * k;
+		y = (m[1] + m[3]) / k;
+		z = (m[2] + m[6]) / k;
+	} else if (m[4] > m[8]) {
+		float k = 2 * sqrtf(1 + m[4] - m[0] - m[8]);
+		w = (m[2] - m[6]) / k;
+		x = (m[1] + m[3]) / k;
+		y = 0.25f * k;
+		z = (m[5] + m[7]) / k;
+	} else {
+		float k = 2 * sqrtf(1 + m[8] - m[0] - m[4]);
+		if (k == 0) { // Not a rotation (no orientation)
+			x = y = z = 0;
+			w = 1;
+		} else {
+			w = (m[3] - m[1]) / k;
+			x = (m[2] + m[6]) / k;
+			y = (m[5] + m[7]) / k;
+			z = 0.25f * k;
+		}
+	}
+	if (w < 0) { // q and -q are the same rotation, keep one of them
+		x = -x;
+		y = -y;
+		z = -z;
+		w = -w;
+	}
+	s.qx[joint] = x;
+	s.qy[joint] = y;
+	s.qz[joint] = z;
+	s.qw[joint] = w;
+}
+
+static inline float square(float value) {
+	return value * value;
+}
+
+// No branches or calls in the first loop (squares instead of fabsf), so it
+// is vectorized (SSE/NEON)
+uint16_t changedJoints(const SkeletonJoints &last,
+		const SkeletonJoints &current) {
+	const float x = SKELETON_STEP_X * SKELETON_STEP_X;
+	const float y = SKELETON_STEP_Y * SKELETON_STEP_Y;
+	const float z = SKELETON_STEP_Z * SKELETON_STEP_Z;
+	const float q = SKELETON_STEP_ROTATION * SKELETON_STEP_ROTATION;
+	int changed[SKELETON_JOINT_SLOTS];
+	for (int i = 0; i < SKELETON_JOINT_SLOTS; i++) {
+		changed[i] = (square(current.x[i] - last.x[i]) > x)
+				| (square(current.y[i] - last.y[i]) > y)
+				| (square(current.z[i] - last.z[i]) > z)
+				| (current.confidence[i] != last.confidence[i])
+				| (square(current.qx[i] - last.qx[i]) > q)
+				| (square(current.qy[i] - last.qy[i]) > q)
+				| (square(current.qz[i] - last.qz[i]) > q)
+				| (square(current.qw[i] - last.qw[i]) > q);
+	}
+	uint16_t mask = 0;
+	for (int i = 0; i < SKELETON_JOINTS; i++)
+		mask |= changed[i] << i;
+	return mask;
+}
+
+void copyJoints(SkeletonJoints &dst, const SkeletonJoints &src, uint16_t mask) {
+	for (int i = 0; i < SKELETON_JOINTS; i++) {
+		if ((mask & (1 << i)) == 0)
+			continue;
+		dst.x[i] = src.x[i];
+		dst.y[i] = src.y[i];
+		dst.z[i] = src.z[i];
+		dst.confidence[i] = src.confidence[i];
+		dst.qx[i] = src.qx[i];
+		dst.qy[i] = src.qy[i];
+		dst.qz[i] = src.qz[i];
+		dst.qw[i] = src.qw[i];
+	}
+}
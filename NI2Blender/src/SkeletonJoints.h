@@ -0,0 +1,76 @@
+/*
+ * SkeletonJoints.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SKELETONJOINTS_H_
+#define SKELETONJOINTS_H_
+
+#include <stdint.h>
+
+// The joints NITE tracks with XN_SKEL_PROFILE_ALL, in this order
+enum SkeletonJointIndex {
+	SKELETON_HEAD = 0,
+	SKELETON_NECK = 1,
+	SKELETON_TORSO = 2,
+	SKELETON_LEFT_SHOULDER = 3,
+	SKELETON_LEFT_ELBOW = 4,
+	SKELETON_LEFT_HAND = 5,
+	SKELETON_RIGHT_SHOULDER = 6,
+	SKELETON_RIGHT_ELBOW = 7,
+	SKELETON_RIGHT_HAND = 8,
+	SKELETON_LEFT_HIP = 9,
+	SKELETON_LEFT_KNEE = 10,
+	SKELETON_LEFT_FOOT = 11,
+	SKELETON_RIGHT_HIP = 12,
+	SKELETON_RIGHT_KNEE = 13,
+	SKELETON_RIGHT_FOOT = 14,
+	SKELETON_JOINTS = 15
+};
+
+// Arrays are padded to whole vectors of 4 floats
+#define SKELETON_JOINT_SLOTS 16
+#define SKELETON_ALL_JOINTS ((1 << SKELETON_JOINTS) - 1)
+
+// Smallest change of a joint that is sent again, the same steps as
+// checkCoordinates() (1.5% of the depth map and of 4 m)
+#define SKELETON_STEP_X 9.6f // Pixels
+#define SKELETON_STEP_Y 7.2f
+#define SKELETON_STEP_Z 60.0f // mm
+#define SKELETON_STEP_ROTATION 0.02f // Quaternion component (~2 degrees)
+
+/*All the joints of a skeleton as a structure of arrays, so the comparisons of
+ * changedJoints() run over every joint at once (vectorized by the compiler).
+ * Positions are projective like the hand coordinates: x, y in depth map
+ * pixels and z in mm. Orientations are unit quaternions, (0, 0, 0, 1) when
+ * NITE has none.
+ */
+struct SkeletonJoints {
+	float x[SKELETON_JOINT_SLOTS];
+	float y[SKELETON_JOINT_SLOTS];
+	float z[SKELETON_JOINT_SLOTS];
+	float confidence[SKELETON_JOINT_SLOTS]; // 0 if the joint isn't tracked
+	float qx[SKELETON_JOINT_SLOTS];
+	float qy[SKELETON_JOINT_SLOTS];
+	float qz[SKELETON_JOINT_SLOTS];
+	float qw[SKELETON_JOINT_SLOTS];
+};
+
+// Sets every joint untracked, with no rotation
+void clearSkeleton(SkeletonJoints &s);
+
+// Orientation of a joint from its rotation matrix (row major, as in
+// XnMatrix3X3)
+void setJointOrientation(SkeletonJoints &s, int joint, const float m[9]);
+
+// Bitmask (bit i = joint i) of the joints of current whose confidence changed
+// or that moved or turned by more than the SKELETON_STEP_* from last
+uint16_t changedJoints(const SkeletonJoints &last,
+		const SkeletonJoints &current);
+
+// Copies the joints of mask from src to dst
+void copyJoints(SkeletonJoints &dst, const SkeletonJoints &src, uint16_t mask);
+
+#endif /* SKELETONJOINTS_H_ */
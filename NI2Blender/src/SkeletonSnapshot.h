@@ -0,0 +1,55 @@
+/*
+ * SkeletonSnapshot.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SKELETONSNAPSHOT_H_
+#define SKELETONSNAPSHOT_H_
+
+#include <stdint.h>
+#include "SkeletonJoints.h"
+
+// Joints kept in a snapshot (skeleton profile XN_SKEL_PROFILE_HEAD_HANDS)
+enum SnapshotJointIndex {
+	SNAPSHOT_HEAD = 0,
+	SNAPSHOT_LEFT_HAND = 1,
+	SNAPSHOT_RIGHT_HAND = 2,
+	SNAPSHOT_JOINTS = 3
+};
+
+struct SnapshotJoint {
+	float real[3]; // Real world (mm)
+	float projective[3]; // Depth map x, y (pixels) and z (mm)
+	float confidence; // 0 if the joint isn't tracked
+};
+
+// Users a snapshot (and the UserTable) can hold: XnUserID 1 to 15, which are
+// also player ids of the wire protocol (SKELETON_MAX_PLAYERS)
+#define MAX_USERS 16
+
+// A tracked user in a snapshot
+struct UserSnapshot {
+	int user_id;
+	SnapshotJoint joints[SNAPSHOT_JOINTS];
+	bool full_skeleton; // skeleton is valid (--skeleton)
+	SkeletonJoints skeleton; // Every joint, projective
+};
+
+/*Everything the pipeline knows about a frame, written once by the capture
+ * thread and never changed after it is published (through a TripleBuffer, one
+ * for each reading thread), so readers never lock and never see half of a
+ * frame.
+ */
+struct SkeletonSnapshot {
+	uint32_t frame_id; // Depth frame
+	uint64_t sensor_time; // Depth frame timestamp (us, sensor clock)
+	uint64_t capture_time; // When it was read (us, CLOCK_MONOTONIC)
+	bool in_session; // NITE session
+	int session_user; // User of the session and gestures, -1 if none
+	int n_users; // Users whose skeleton is tracked in this frame
+	UserSnapshot users[MAX_USERS];
+};
+
+#endif /* SKELETONSNAPSHOT_H_ */
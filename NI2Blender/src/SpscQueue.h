@@ -0,0 +1,104 @@
+/*
+ * SpscQueue.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SPSCQUEUE_H_
+#define SPSCQUEUE_H_
+
+#include <stddef.h>
+
+#define CACHE_LINE_SIZE 64
+
+/*Bounded lock-free queue for one producer thread and one consumer thread.
+ * Slots are preallocated: the producer fills the slot returned by reserve(),
+ * commit()s it and the consumer only sees it after publish(), so several
+ * messages (e.g. a whole frame) can be made visible at once.
+ * Size must be a power of two.
+ */
+template<typename T, unsigned int Size>
+class SpscQueue {
+public:
+	SpscQueue() {
+		head = 0;
+		tail = 0;
+		pending = 0;
+	}
+
+	//-------------------------------------------------------------------------
+	// Producer
+	//-------------------------------------------------------------------------
+
+	// Returns the next free slot, or NULL if the queue is full
+	T* reserve() {
+		unsigned int h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+		if (pending - h == Size)
+			return NULL;
+		return &slots[pending & (Size - 1)];
+	}
+
+	// Accepts the slot returned by reserve() (not visible yet)
+	void commit() {
+		pending++;
+	}
+
+	// Makes every committed slot visible to the consumer
+	void publish() {
+		__atomic_store_n(&tail, pending, __ATOMIC_RELEASE);
+	}
+
+	// Copies the value into the queue, returns false if it is full
+	bool push(const T &value) {
+		T *slot = reserve();
+		if (slot == NULL)
+			return false;
+		*slot = value;
+		commit();
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Consumer
+	//-------------------------------------------------------------------------
+
+	// Returns the oldest published slot, or NULL if there is none
+	T* front() {
+		unsigned int t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+		if (head == t)
+			return NULL;
+		return &slots[head & (Size - 1)];
+	}
+
+	// Releases the slot returned by front()
+	void pop() {
+		__atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+	}
+
+	//-------------------------------------------------------------------------
+	// Any thread
+	//-------------------------------------------------------------------------
+
+	// Number of published slots not consumed yet
+	unsigned int size() const {
+		// head first: it never passes a tail loaded after it
+		unsigned int h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+		return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) - h;
+	}
+
+	unsigned int capacity() const {
+		return Size;
+	}
+
+private:
+	// Indexes grow forever (unsigned overflow is fine with power of two sizes)
+	unsigned int head; // Next slot to consume, written by the consumer
+	char pad1[CACHE_LINE_SIZE - sizeof(unsigned int)];
+	unsigned int tail; // Published slots, written by the producer
+	unsigned int pending; // Committed slots, private to the producer
+	char pad2[CACHE_LINE_SIZE - 2 * sizeof(unsigned int)];
+	T slots[Size];
+};
+
+#endif /* SPSCQUEUE_H_ */
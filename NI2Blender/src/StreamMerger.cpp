@@ -0,0 +1,82 @@
+/*
+ * StreamMerger.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include "StreamMerger.h"
+
+StreamMerger::StreamMerger() {
+	n_sources = 1;
+	n_dropped = 0;
+	n_deferred = 0;
+	for (int i = 0; i < MAX_DEVICES; i++)
+		sources[i].frame_time = 0;
+}
+
+void StreamMerger::setSources(int n) {
+	n_sources = n < 1 ? 1 : (n > MAX_DEVICES ? MAX_DEVICES : n);
+}
+
+bool StreamMerger::push(int source, const Message &m) {
+	Source &s = sources[source];
+	// Keeps the order: once an event waits in the overflow list, so does the
+	// rest
+	if (s.overflow.empty() && s.queue.push(m))
+		return true;
+	if (!isReliableMessage(m.type)) {
+		__atomic_add_fetch(&n_dropped, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+	s.overflow.push_back(m);
+	__atomic_add_fetch(&n_deferred, 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+void StreamMerger::endFrame(int source, uint64_t captureTime) {
+	Source &s = sources[source];
+	while (!s.overflow.empty() && s.queue.push(s.overflow.front()))
+		s.overflow.pop_front();
+	s.queue.publish();
+	// After the messages, so they are there once the time is seen
+	__atomic_store_n(&s.frame_time, captureTime, __ATOMIC_RELEASE);
+}
+
+// Newest capture_time every live source has already reached
+uint64_t StreamMerger::watermark() const {
+	uint64_t now = monotonicMicros();
+	uint64_t mark = 0;
+	bool found = false;
+	for (int i = 0; i < n_sources; i++) {
+		uint64_t t = __atomic_load_n(&sources[i].frame_time, __ATOMIC_ACQUIRE);
+		if (t == 0 || now - t > MERGE_MAX_DELAY)
+			continue;
+		if (!found || t < mark)
+			mark = t;
+		found = true;
+	}
+	if (!found) // Everything stalled: nothing is waited for
+		return now;
+	return mark;
+}
+
+bool StreamMerger::pop(Message &m) {
+	uint64_t mark = watermark();
+	int oldest = -1;
+	uint64_t oldestTime = 0;
+	for (int i = 0; i < n_sources; i++) {
+		Message *f = sources[i].queue.front();
+		if (f == NULL || f->capture_time > mark)
+			continue;
+		if (oldest < 0 || f->capture_time < oldestTime) {
+			oldest = i;
+			oldestTime = f->capture_time;
+		}
+	}
+	if (oldest < 0)
+		return false;
+	m = *sources[oldest].queue.front();
+	sources[oldest].queue.pop();
+	return true;
+}
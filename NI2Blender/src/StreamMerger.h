@@ -0,0 +1,86 @@
+/*
+ * StreamMerger.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef STREAMMERGER_H_
+#define STREAMMERGER_H_
+
+#include <stdint.h>
+#include <deque>
+#include "Protocol.h"
+#include "SpscQueue.h"
+
+// Messages waiting in each source (power of two)
+#define MERGE_QUEUE_SIZE 128
+
+// A source without a new frame for this long (us) doesn't hold the others
+// back any more
+#define MERGE_MAX_DELAY 100000
+
+/*Merges the messages of several sensors (one capture thread each) into a
+ * single stream in capture_time order, which all of them take from
+ * CLOCK_MONOTONIC. Each source push()es the messages of a frame in order and
+ * then calls endFrame(); pop() only hands out a message once no source can
+ * still produce an older one, i.e. up to the oldest last frame of the sources
+ * that are alive. A source that stalled (or hasn't started) is left out, and
+ * its messages go out as they come when it is back. Events are never dropped:
+ * when the queue of their source is full they wait in a list of the producer
+ * and are queued at its next endFrame(), while coordinates are dropped.
+ */
+class StreamMerger {
+public:
+	StreamMerger();
+
+	// Number of sources, before any of them starts
+	void setSources(int n);
+
+	int getSources() const {
+		return n_sources;
+	}
+
+	//-------------------------------------------------------------------------
+	// Producer (one thread for each source)
+	//-------------------------------------------------------------------------
+
+	// Queues m (not visible yet), false if the queue is full and m (only
+	// coordinates) is dropped
+	bool push(int source, const Message &m);
+
+	// Makes the frame of captureTime visible, even if it had no messages
+	void endFrame(int source, uint64_t captureTime);
+
+	//-------------------------------------------------------------------------
+	// Consumer
+	//-------------------------------------------------------------------------
+
+	// Takes the oldest message that can go out, false if there is none
+	bool pop(Message &m);
+
+	unsigned long getDropped() const {
+		return __atomic_load_n(&n_dropped, __ATOMIC_RELAXED);
+	}
+
+	// Events that waited because the queue of their source was full
+	unsigned long getDeferred() const {
+		return __atomic_load_n(&n_deferred, __ATOMIC_RELAXED);
+	}
+
+private:
+	uint64_t watermark() const;
+
+	struct Source {
+		SpscQueue<Message, MERGE_QUEUE_SIZE> queue;
+		std::deque<Message> overflow; // Events, producer only
+		uint64_t frame_time; // capture_time of the last frame, 0 = none yet
+	};
+
+	Source sources[MAX_DEVICES];
+	int n_sources;
+	unsigned long n_dropped;
+	unsigned long n_deferred;
+};
+
+#endif /* STREAMMERGER_H_ */
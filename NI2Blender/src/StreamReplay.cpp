@@ -0,0 +1,62 @@
+/*
+ * StreamReplay.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include "StreamReplay.h"
+
+// Bytes read from the file at a time
+#define REPLAY_CHUNK 4096
+
+StreamReplay::StreamReplay() {
+	file = NULL;
+}
+
+StreamReplay::~StreamReplay() {
+	close();
+}
+
+bool StreamReplay::open(const char *path) {
+	close();
+	file = fopen(path, "rb");
+	if (file == NULL) {
+		printf("\nCouldn't open the recording %s", path);
+		return false;
+	}
+	return true;
+}
+
+void StreamReplay::close() {
+	if (file != NULL)
+		fclose(file);
+	file = NULL;
+	input.clear();
+	decoder.reset();
+}
+
+bool StreamReplay::next(Message &m) {
+	if (file == NULL)
+		return false;
+	for (;;) {
+		if (input.next(m, &decoder)) {
+			if (m.type != MSG_NONE) // A delta without its keyframe
+				return true;
+			continue;
+		}
+		char chunk[REPLAY_CHUNK];
+		size_t n = fread(chunk, 1, sizeof(chunk), file);
+		if (n == 0)
+			return false;
+		input.append(chunk, n);
+	}
+}
+
+void StreamReplay::rewind() {
+	if (file == NULL)
+		return;
+	::rewind(file);
+	input.clear();
+	decoder.reset();
+}
@@ -0,0 +1,40 @@
+/*
+ * StreamReplay.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef STREAMREPLAY_H_
+#define STREAMREPLAY_H_
+
+#include <stdio.h>
+#include "Protocol.h"
+#include "ConnectionBuffer.h"
+
+/*Reads back a recorded stream: the bytes a server got from NI2Blender (text,
+ * binary or compact, e.g. saved with "nc -l 2001 > walk.bin"). Compact
+ * coordinates and skeleton deltas are rebuilt as a receiver would, so every
+ * message comes out whole and can be sent again in any wire format.
+ */
+class StreamReplay {
+public:
+	StreamReplay();
+	~StreamReplay();
+
+	bool open(const char *path);
+	void close();
+
+	// Next message of the recording, false at the end
+	bool next(Message &m);
+
+	// Starts over from the beginning
+	void rewind();
+
+private:
+	FILE *file;
+	InputBuffer input;
+	MessageDecoder decoder;
+};
+
+#endif /* STREAMREPLAY_H_ */
@@ -0,0 +1,239 @@
+/*
+ * SyntheticBackend.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include "SyntheticBackend.h"
+
+// Joints of a standing user relative to the torso (x, y in mm)
+static const float standing_pose[SKELETON_JOINTS][2] = { { 0, 450 }, // Head
+		{ 0, 250 }, { 0, 0 }, // Neck, torso
+		{ -180, 230 }, { -220, -20 }, { -240, -250 }, // Left arm
+		{ 180, 230 }, { 220, -20 }, { 240, -250 }, // Right arm
+		{ -100, -220 }, { -110, -620 }, { -110, -1000 }, // Left leg
+		{ 100, -220 }, { 110, -620 }, { 110, -1000 } }; // Right leg
+
+// Users per row, and the distances between them and between the rows (mm)
+#define ROW_USERS 5
+#define USER_SPACING 500.0f
+#define ROW_SPACING 1000.0f
+#define FIRST_ROW 2200.0f
+
+// Right hand: center of its circles in front of the shoulder, their radius
+// and the ends of the swipes (mm)
+static const float hand_center[3] = { 60, -150, -350 };
+#define CIRCLE_RADIUS 200.0f
+#define SWIPE_LEFT_END -300.0f
+
+// The script (s into the cycle), see SyntheticBackend.h
+#define CIRCLE_PERIOD 2.0
+#define SWIPE_LEFT_START 4.0
+#define SWIPE_RIGHT_START 5.0
+#define SWIPE_TIME 0.7
+#define STEADY_START 6.0
+#define STEADY_DETECTION 0.8
+
+// Time between users calibrating, and from the first one to the session (s)
+#define CALIBRATION_INTERVAL 0.25
+#define FIRST_CALIBRATION 0.5
+#define SESSION_DELAY 1.0
+
+// How much each user's script is shifted from the last one's (s)
+#define USER_SHIFT 1.3
+
+static const double PI = 3.14159265358979323846;
+
+SyntheticBackend::SyntheticBackend(int users, double rate,
+		unsigned long frames) {
+	n_users = users < 1 ? 1 : (users >= MAX_USERS ? MAX_USERS - 1 : users);
+	this->rate = rate;
+	max_frames = frames;
+	listener = NULL;
+	frame = 0;
+	start_time = 0;
+	for (int i = 0; i < MAX_USERS; i++)
+		tracked[i] = false;
+	in_session = false;
+	session_index = 0;
+	session_time = FIRST_CALIBRATION + SESSION_DELAY;
+}
+
+bool SyntheticBackend::start(SensorListener *listener) {
+	this->listener = listener;
+	frame = 0;
+	start_time = monotonicMicros();
+	if (rate > 0)
+		printf("\nSynthetic sensor: %d users at %.1f frames/s", n_users, rate);
+	else
+		printf("\nSynthetic sensor: %d users, as fast as possible", n_users);
+	return true;
+}
+
+void SyntheticBackend::stop() {
+}
+
+double SyntheticBackend::timeOf(unsigned long frame) const {
+	return frame / (rate > 0 ? rate : SYNTHETIC_VIRTUAL_RATE);
+}
+
+double SyntheticBackend::calibrationTime(int i) const {
+	return FIRST_CALIBRATION + i * CALIBRATION_INTERVAL;
+}
+
+// Makes the next frame (at its time, unless as fast as possible) and reports
+// what happened in it
+bool SyntheticBackend::update(SensorUpdate &u) {
+	if (atEnd())
+		return false;
+	double prev = timeOf(frame);
+	frame++;
+	double now = timeOf(frame);
+	if (rate > 0) {
+		uint64_t at = start_time + (uint64_t) (now * 1000000);
+		uint64_t t = monotonicMicros();
+		if (at > t)
+			usleep(at - t);
+	}
+	for (int i = 0; i < n_users; i++)
+		moveUser(i, now);
+	for (int i = 0; i < n_users; i++) {
+		if (!tracked[i] && now >= calibrationTime(i)) {
+			tracked[i] = true;
+			listener->userCalibrated(i + 1);
+		}
+	}
+	if (!in_session && tracked[session_index] && now >= session_time) {
+		in_session = true;
+		listener->sessionStarted();
+	}
+	if (in_session)
+		reportGestures(session_index, prev, now);
+	u.new_depth = true;
+	u.new_user = true;
+	u.new_image = false;
+	u.frame_id = frame;
+	u.sensor_time = timestamp();
+	return true;
+}
+
+bool SyntheticBackend::atEnd() const {
+	return max_frames != 0 && frame >= max_frames;
+}
+
+uint64_t SyntheticBackend::timestamp() const {
+	return (uint64_t) (timeOf(frame) * 1000000);
+}
+
+void SyntheticBackend::getFieldOfView(double &hFov, double &vFov) const {
+	hFov = SYNTHETIC_HFOV;
+	vFov = SYNTHETIC_VFOV;
+}
+
+void SyntheticBackend::getResolution(int &xRes, int &yRes) const {
+	xRes = 640;
+	yRes = 480;
+}
+
+bool SyntheticBackend::isTracking(int user) {
+	return user > 0 && user <= n_users && tracked[user - 1];
+}
+
+void SyntheticBackend::getJoint(int user, int joint, SensorJoint &j) {
+	const float *p = joints[user - 1][joint];
+	j.position[0] = p[0];
+	j.position[1] = p[1];
+	j.position[2] = p[2];
+	j.confidence = 1;
+	for (int i = 0; i < 9; i++) // Facing the sensor
+		j.orientation[i] = i % 4 == 0 ? 1 : 0;
+	j.orientation_confidence = 1;
+}
+
+// The session starts again a second later with the next user, the one
+// calibrated after it (as the core moves the session to the next one)
+void SyntheticBackend::endSession() {
+	if (!in_session)
+		return;
+	in_session = false;
+	session_index = (session_index + 1) % n_users;
+	session_time = timeOf(frame) + SESSION_DELAY;
+	listener->sessionEnded();
+}
+
+// Joints of user i at t: the standing pose swaying, the right hand (and its
+// elbow) following the script
+void SyntheticBackend::moveUser(int i, double t) {
+	int row = i / ROW_USERS;
+	int inRow = n_users - row * ROW_USERS < ROW_USERS ? n_users - row
+			* ROW_USERS : ROW_USERS;
+	float x = (i % ROW_USERS - (inRow - 1) / 2.0f) * USER_SPACING;
+	float z = FIRST_ROW + row * ROW_SPACING;
+	x += 20 * (float) sin(2 * PI * (t + i) / 4); // Sway
+	float (*p)[3] = joints[i];
+	for (int k = 0; k < SKELETON_JOINTS; k++) {
+		p[k][0] = x + standing_pose[k][0];
+		p[k][1] = standing_pose[k][1];
+		p[k][2] = z;
+	}
+
+	// Position in the script, from when the user calibrated
+	double s = fmod(t - calibrationTime(i) + i * USER_SHIFT + 10
+			* SYNTHETIC_CYCLE, SYNTHETIC_CYCLE);
+	float hx, hy; // Relative to the center of the circles
+	if (s < SWIPE_LEFT_START) {
+		double a = 2 * PI * s / CIRCLE_PERIOD;
+		hx = CIRCLE_RADIUS * (float) cos(a);
+		hy = CIRCLE_RADIUS * (float) sin(a);
+	} else if (s < STEADY_START) {
+		// Smooth start and stop, then holds until the next swipe
+		bool left = s < SWIPE_RIGHT_START;
+		double f = (s - (left ? SWIPE_LEFT_START : SWIPE_RIGHT_START))
+				/ SWIPE_TIME;
+		f = f > 1 ? 1 : f * f * (3 - 2 * f);
+		float from = left ? CIRCLE_RADIUS : SWIPE_LEFT_END;
+		float to = left ? SWIPE_LEFT_END : CIRCLE_RADIUS;
+		hx = from + (to - from) * (float) f;
+		hy = 0;
+	} else {
+		hx = CIRCLE_RADIUS; // Where the next circle starts
+		hy = 0;
+	}
+	float *shoulder = p[SKELETON_RIGHT_SHOULDER];
+	float *hand = p[SKELETON_RIGHT_HAND];
+	float *elbow = p[SKELETON_RIGHT_ELBOW];
+	hand[0] = shoulder[0] + hand_center[0] + hx;
+	hand[1] = shoulder[1] + hand_center[1] + hy;
+	hand[2] = shoulder[2] + hand_center[2];
+	for (int k = 0; k < 3; k++)
+		elbow[k] = (shoulder[k] + hand[k]) / 2;
+	elbow[1] -= 60;
+}
+
+// The script time went past at (s into the cycle) between prev and now
+static bool passed(double prev, double now, double at) {
+	return floor((now - at) / SYNTHETIC_CYCLE) > floor((prev - at)
+			/ SYNTHETIC_CYCLE);
+}
+
+// Gestures of user i completed between prev and now, with the parameters
+// NITE would give (radius and confidence, velocity in m/s and angle)
+void SyntheticBackend::reportGestures(int i, double prev, double now) {
+	double shift = i * USER_SHIFT - calibrationTime(i);
+	prev += shift;
+	now += shift;
+	float swipeSpeed = (CIRCLE_RADIUS - SWIPE_LEFT_END) / 1000 / SWIPE_TIME;
+	if (passed(prev, now, CIRCLE_PERIOD) || passed(prev, now, 2
+			* CIRCLE_PERIOD))
+		listener->gestureDetected(GESTURE_CIRCLE, CIRCLE_RADIUS, 1, 0);
+	if (passed(prev, now, SWIPE_LEFT_START + SWIPE_TIME))
+		listener->gestureDetected(GESTURE_SWIPE_LEFT, swipeSpeed, 0, 0);
+	if (passed(prev, now, SWIPE_RIGHT_START + SWIPE_TIME))
+		listener->gestureDetected(GESTURE_SWIPE_RIGHT, swipeSpeed, 0, 0);
+	if (passed(prev, now, STEADY_START + STEADY_DETECTION))
+		listener->gestureDetected(GESTURE_ON_STEADY, 0, 0, 0);
+}
@@ -0,0 +1,79 @@
+/*
+ * SyntheticBackend.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef SYNTHETICBACKEND_H_
+#define SYNTHETICBACKEND_H_
+
+#include <stdint.h>
+#include "SensorBackend.h"
+#include "SkeletonSnapshot.h"
+
+// Field of view of a Kinect depth map (rad), the joints are projected with it
+#define SYNTHETIC_HFOV 1.0144686707507438
+#define SYNTHETIC_VFOV 0.78980943449644714
+
+// Frame rate the motion is computed at when frames are made as fast as
+// possible (rate 0)
+#define SYNTHETIC_VIRTUAL_RATE 30
+
+// Length of each user's motion script (s)
+#define SYNTHETIC_CYCLE 8.0
+
+/*Users made up with parametric motion, for running the pipeline without a
+ * sensor or OpenNI (tests, load tests). The users stand in rows facing the
+ * sensor and calibrate one after the other; the session starts a second
+ * after the first one, and when it is ended (endSession()) it starts again
+ * a second later with the next one. Each one repeats an 8 s script with its right hand,
+ * shifted in time from the others:
+ *   0-4 s    two circles of 200 mm    (a circle gesture after each)
+ *   4-5 s    swipe to the left        (swipe_left)
+ *   5-6 s    swipe to the right       (swipe_right)
+ *   6-8 s    steady hold              (on_steady after 0.8 s)
+ * while the whole body sways slowly. Only the session user's gestures are
+ * reported, as NITE follows a single hand. The motion only depends on the
+ * frame number, so every run with the same options gives the same joints.
+ */
+class SyntheticBackend: public SensorBackend {
+public:
+	/*users (1 to MAX_USERS - 1) at rate frames/s, or as fast as they can be
+	 * processed (0), for frames frames (0 = without end)
+	 */
+	SyntheticBackend(int users, double rate, unsigned long frames);
+
+	// SensorBackend
+	virtual bool start(SensorListener *listener);
+	virtual void stop();
+	virtual bool update(SensorUpdate &u);
+	virtual bool atEnd() const;
+	virtual uint64_t timestamp() const;
+	virtual void getFieldOfView(double &hFov, double &vFov) const;
+	virtual void getResolution(int &xRes, int &yRes) const;
+	virtual bool isTracking(int user);
+	virtual void getJoint(int user, int joint, SensorJoint &j);
+	virtual void endSession();
+
+private:
+	// Seconds since the start of the run
+	double timeOf(unsigned long frame) const;
+	double calibrationTime(int i) const;
+	void moveUser(int i, double t);
+	void reportGestures(int i, double prev, double now);
+
+	int n_users;
+	double rate;
+	unsigned long max_frames;
+	SensorListener *listener;
+	unsigned long frame;
+	uint64_t start_time; // us, CLOCK_MONOTONIC
+	bool tracked[MAX_USERS]; // By index, the user id is index + 1
+	float joints[MAX_USERS][SKELETON_JOINTS][3]; // Real world (mm)
+	bool in_session;
+	int session_index; // User followed by the session (index)
+	double session_time; // When the session (re)starts
+};
+
+#endif /* SYNTHETICBACKEND_H_ */
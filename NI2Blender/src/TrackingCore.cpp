@@ -0,0 +1,426 @@
+/*
+ * TrackingCore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include <stdio.h>
+#include "TrackingCore.h"
+
+// For debugging purposes
+static bool _printSessionStatus = false;
+static bool _printUserTracking = true;
+static bool _printHandsTracking = false;
+
+// Depth range of the hand coordinates (== 4m)
+static const int res_z = 4000;
+
+// Percent to filter data (coordinates from hands)
+static const float percent = 1.5;
+
+#define SECONDS_STEADY_HAND 1.5
+
+TrackingCore::TrackingCore() {
+	send = NULL;
+	send_cookie = NULL;
+	sensor = NULL;
+	device_id = 0;
+	full_skeleton = false;
+	hands_tracking = true;
+	res_x = 640;
+	res_y = 480;
+	valid_step_x = (res_x * percent) / 100;
+	valid_step_y = (res_y * percent) / 100;
+	valid_step_z = (res_z * percent) / 100;
+	session_user = -1;
+	in_session = false;
+	data_id = 1;
+	numbering = true;
+	frame_sensor_time = 0;
+	frame_capture_time = 0;
+}
+
+// The field of view doesn't change, the joints are projected with it instead
+// of one conversion per joint
+void TrackingCore::setSensor(SensorBackend *sensor) {
+	this->sensor = sensor;
+	double hFov, vFov;
+	sensor->getFieldOfView(hFov, vFov);
+	sensor->getResolution(res_x, res_y);
+	joint_projector.setFieldOfView(hFov, vFov, res_x, res_y);
+	valid_step_x = (res_x * percent) / 100;
+	valid_step_y = (res_y * percent) / 100;
+}
+
+void TrackingCore::stampFrame() {
+	uint64_t sensor_time = sensor->timestamp();
+	if (sensor_time != frame_sensor_time) {
+		frame_sensor_time = sensor_time;
+		frame_capture_time = monotonicMicros();
+	}
+}
+
+void TrackingCore::processFrame(SkeletonSnapshot &snapshot) {
+	takeSnapshot(snapshot);
+	// Extract hand position of tracked user
+	for (int i = 0; i < snapshot.n_users; i++) {
+		const UserSnapshot &user = snapshot.users[i];
+		if (hands_tracking && snapshot.in_session)
+			handleHandPosition(user);
+		if (send != NULL && user.full_skeleton)
+			sendSkeleton(snapshot, user);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Session Event Handlers
+//-----------------------------------------------------------------------------
+
+void TrackingCore::sessionStarted() {
+	if (_printSessionStatus)
+		printf("\nSession Started");
+	if (!in_session) {
+		float coordinates[3] = { 0.0, 0.0, 0.0 };
+		formatData("session_started", session_user, -1, -1, -1, coordinates,
+				0.0, "none", 0.0, 0.0, 0.0);
+	}
+	in_session = true;
+}
+
+void TrackingCore::sessionEnded() {
+	if (_printSessionStatus)
+		printf("\nSession Ended");
+	if (in_session) {
+		float coordinates[3] = { 0.0, 0.0, 0.0 };
+		formatData("session_ended", session_user, -1, -1, -1, coordinates,
+				0.0, "none", 0.0, 0.0, 0.0);
+	}
+	in_session = false;
+}
+
+//-----------------------------------------------------------------------------
+// Gesture Events
+//-----------------------------------------------------------------------------
+
+void TrackingCore::gestureDetected(GestureType gesture, float p1, float p2,
+		float p3) {
+	float coordinates[3] = { 0.0, 0.0, 0.0 };
+	formatData("gesture", session_user, -1, -1, -1, coordinates, 0.0,
+			gestureName(gesture), p1, p2, p3);
+}
+
+//-----------------------------------------------------------------------------
+// User Tracking/Skeleton Events
+//-----------------------------------------------------------------------------
+
+// Adds the user to the tracked ones
+void TrackingCore::userCalibrated(int user) {
+	if (!users.startTracking(user))
+		return;
+	if (_printUserTracking)
+		printf("\nCalibration complete, start tracking user: %d", user);
+	if (session_user == -1)
+		session_user = user;
+	float coordinates[3] = { 0.0, 0.0, 0.0 };
+	formatData("new_user_calibrated", user, -1, -1, -1, coordinates, 0.0,
+			"none", 0.0, 0.0, 0.0);
+}
+
+void TrackingCore::userLost(int user, bool exited) {
+	if (!users.isTracked(user))
+		return;
+	if (_printUserTracking)
+		printf(exited ? "\nThe calibrated user (%d) exited from field of view"
+				: "\nThe calibrated user (%d) was lost", user);
+	float coordinates[3] = { 0.0, 0.0, 0.0 };
+	formatData(exited ? "calibrated_user_exit" : "calibrated_user_lost", user,
+			-1, -1, -1, coordinates, 0.0, "none", 0.0, 0.0, 0.0);
+	releaseUser(user);
+}
+
+// Stops tracking a calibrated user that was lost or exited. The session
+// ends with its user and goes to the next one calibrated.
+void TrackingCore::releaseUser(int id) {
+	users.stopTracking(id);
+	if (id == session_user) {
+		if (in_session) { // Ends the session if still open, as this user's
+			sensor->endSession();
+			if (in_session) // The backend calls back later, it finds it ended
+				sessionEnded();
+		}
+		session_user = users.size() > 0 ? users.trackedUser(0) : -1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Methods
+//-----------------------------------------------------------------------------
+
+// Joints of every tracked user in the current frame: all of them are read
+// first and then projected at once, so the cost grows linearly with the users.
+// With full skeletons every joint is read, the head and hands are among them.
+void TrackingCore::takeSnapshot(SkeletonSnapshot &snapshot) {
+	// Indexes of the snapshot joints in the skeleton
+	static const int snapshot_joints[SNAPSHOT_JOINTS] = { SKELETON_HEAD,
+			SKELETON_LEFT_HAND, SKELETON_RIGHT_HAND };
+	snapshot.sensor_time = frame_sensor_time;
+	snapshot.capture_time = frame_capture_time;
+	snapshot.in_session = in_session;
+	snapshot.session_user = session_user;
+	snapshot.n_users = 0;
+	joint_projector.clear();
+	for (int u = 0; u < users.size(); u++) {
+		int id = users.trackedUser(u);
+		if (!sensor->isTracking(id))
+			continue;
+		UserSnapshot &user = snapshot.users[snapshot.n_users++];
+		user.user_id = id;
+		user.full_skeleton = full_skeleton;
+		if (user.full_skeleton) {
+			SkeletonJoints &s = user.skeleton;
+			clearSkeleton(s);
+			for (int i = 0; i < SKELETON_JOINTS; i++) {
+				SensorJoint t;
+				sensor->getJoint(id, i, t);
+				s.confidence[i] = t.confidence;
+				if (t.orientation_confidence > 0)
+					setJointOrientation(s, i, t.orientation);
+				joint_projector.add(t.position[0], t.position[1],
+						t.position[2]);
+				for (int j = 0; j < SNAPSHOT_JOINTS; j++) {
+					if (snapshot_joints[j] != i)
+						continue;
+					user.joints[j].real[0] = t.position[0];
+					user.joints[j].real[1] = t.position[1];
+					user.joints[j].real[2] = t.position[2];
+					user.joints[j].confidence = t.confidence;
+				}
+			}
+		} else {
+			for (int i = 0; i < SNAPSHOT_JOINTS; i++) {
+				SensorJoint t;
+				sensor->getJoint(id, snapshot_joints[i], t);
+				SnapshotJoint &j = user.joints[i];
+				j.real[0] = t.position[0];
+				j.real[1] = t.position[1];
+				j.real[2] = t.position[2];
+				j.confidence = t.confidence;
+				joint_projector.add(j.real[0], j.real[1], j.real[2]);
+			}
+		}
+	}
+	joint_projector.project();
+	// The points were added user by user, in the same order
+	int k = 0;
+	for (int u = 0; u < snapshot.n_users; u++) {
+		UserSnapshot &user = snapshot.users[u];
+		if (user.full_skeleton) {
+			SkeletonJoints &s = user.skeleton;
+			for (int i = 0; i < SKELETON_JOINTS; i++, k++) {
+				s.x[i] = joint_projector.projectiveX(k);
+				s.y[i] = joint_projector.projectiveY(k);
+				s.z[i] = joint_projector.projectiveZ(k);
+			}
+			for (int i = 0; i < SNAPSHOT_JOINTS; i++) {
+				SnapshotJoint &j = user.joints[i];
+				j.projective[0] = s.x[snapshot_joints[i]];
+				j.projective[1] = s.y[snapshot_joints[i]];
+				j.projective[2] = s.z[snapshot_joints[i]];
+			}
+		} else {
+			for (int i = 0; i < SNAPSHOT_JOINTS; i++, k++) {
+				SnapshotJoint &j = user.joints[i];
+				j.projective[0] = joint_projector.projectiveX(k);
+				j.projective[1] = joint_projector.projectiveY(k);
+				j.projective[2] = joint_projector.projectiveZ(k);
+			}
+		}
+	}
+}
+
+static Point3D projectivePoint(const SnapshotJoint &joint) {
+	Point3D p;
+	p.X = joint.projective[0];
+	p.Y = joint.projective[1];
+	p.Z = joint.projective[2];
+	return p;
+}
+
+// Extracts and sends hand position data and more, for one user
+void TrackingCore::handleHandPosition(const UserSnapshot &user,
+		bool fix_coordinates) {
+	UserState &state = users[user.user_id];
+	Point3D hands[2]; // 0=left; 1=right
+	float confidence[2];
+	hands[0] = projectivePoint(user.joints[SNAPSHOT_LEFT_HAND]);
+	confidence[0] = user.joints[SNAPSHOT_LEFT_HAND].confidence;
+	hands[1] = projectivePoint(user.joints[SNAPSHOT_RIGHT_HAND]);
+	confidence[1] = user.joints[SNAPSHOT_RIGHT_HAND].confidence;
+	if (confidence[0] > 0.5) {// Left hand
+		if(state.l_hand_out_fov)state.l_hand_out_fov = false;
+		if (fix_coordinates)
+			fixCoordinates(&hands[0]);
+		if (checkCoordinates(&state.l_last_point3d, hands[0])) {// Hand in movement
+			if (_printHandsTracking)
+				printf(
+						"\nLeft Hand from Skeleton - (%3.3f, %3.3f, %4.3f), Confidence:%2.2f",
+						hands[0].X, hands[0].Y, hands[0].Z, confidence[0]);
+			sendHandCoordinates(user.user_id, hands[0], 1, 0);
+			if (state.l_timer.isRunning())
+				state.l_timer.reset();
+		} else {// Hand isn't in movement
+			state.l_timer.start();
+			if (!state.l_timer.isOver(SECONDS_STEADY_HAND)) {
+				//sendHeadCoordinates(user.user_id, projectivePoint(user.joints[SNAPSHOT_HEAD]), 1, 0); //TODO: Disable for tests
+				state.l_timer.reset();
+			}
+		}
+	}
+	if (confidence[1] > 0.5) {// Right hand
+		if(state.r_hand_out_fov)state.r_hand_out_fov = false;
+		if (fix_coordinates)
+			fixCoordinates(&hands[1]);
+		if (checkCoordinates(&state.r_last_point3d, hands[1])) {// Hand in movement
+			if (_printHandsTracking)
+				printf(
+						"\nRight Hand from Skeleton - (%3.3f, %3.3f, %4.3f), Confidence:%2.2f",
+						hands[1].X, hands[1].Y, hands[1].Z, confidence[1]);
+			sendHandCoordinates(user.user_id, hands[1], 0, 1);
+			if (state.r_timer.isRunning())
+				state.r_timer.reset();
+		} else {// Hand isn't in movement
+			state.r_timer.start();
+			if (!state.r_timer.isOver(SECONDS_STEADY_HAND)) {
+				//sendHeadCoordinates(user.user_id, projectivePoint(user.joints[SNAPSHOT_HEAD]), 0, 1); //TODO: Disable for tests
+				state.r_timer.reset();
+			}
+		}
+	}
+}
+
+// Sends every joint of a user of the snapshot, the sender only keeps the ones
+// that changed since the last skeleton it sent (see MessageEncoder)
+void TrackingCore::sendSkeleton(const SkeletonSnapshot &snapshot,
+		const UserSnapshot &user) {
+	Message m;
+	initMessage(m, MSG_SKELETON);
+	m.data_id = numbering ? data_id++ : 0;
+	m.player_id = user.user_id;
+	m.device_id = device_id;
+	m.in_session = snapshot.in_session;
+	m.calibrated = true;
+	m.sensor_time = snapshot.sensor_time;
+	m.capture_time = snapshot.capture_time;
+	m.joint_mask = SKELETON_ALL_JOINTS;
+	m.skeleton = user.skeleton;
+	send(m, send_cookie);
+}
+
+// Sends hand coordinates data to socket connection
+void TrackingCore::sendHandCoordinates(int player_id, Point3D h_coordinates,
+		int is_l_hand, int is_r_hand) {
+	float coordinates[3] = { h_coordinates.X, h_coordinates.Y, h_coordinates.Z };
+	formatData("hand_coordinates", player_id, 0, is_l_hand, is_r_hand,
+			coordinates, 0.0, "none", 0.0, 0.0, 0.0);
+}
+
+// Sends head coordinates data to socket connection
+// TODO: Verificar a necessidade de filtrar estes dados aqui, no cliente.
+void TrackingCore::sendHeadCoordinates(int player_id, Point3D h_coordinates,
+		int is_l_hand, int is_r_hand) {
+	float coordinates[3] = { h_coordinates.X, h_coordinates.Y, h_coordinates.Z };
+	formatData("head_coordinates", player_id, 0, is_l_hand, is_r_hand,
+			coordinates, 0.0, "none", 0.0, 0.0, 0.0);
+}
+
+// Fix coordinates
+void TrackingCore::fixCoordinates(Point3D *c) {
+	if (c->X > res_x)
+		c->X = res_x;
+	else if (c->X < 0)
+		c->X = 0;
+	if (c->Y > res_y)
+		c->Y = res_y;
+	else if (c->Y < 0)
+		c->Y = 0;
+}
+
+// Checks if the new point3d is valid, and stores it if so
+bool TrackingCore::checkCoordinates(Point3D *last_point3d,
+		Point3D new_point3d) {
+	if (last_point3d->X == 0 && last_point3d->Y == 0) {
+		storeCoordinates(last_point3d, new_point3d);
+		return true;
+	} else {
+		if (last_point3d->X + valid_step_x < new_point3d.X || last_point3d->X
+				- valid_step_x > new_point3d.X) {// Test X
+			storeCoordinates(last_point3d, new_point3d);
+			return true;
+		} else if (last_point3d->Y + valid_step_y < new_point3d.Y
+				|| last_point3d->Y - valid_step_y > new_point3d.Y) {// Test Y
+			storeCoordinates(last_point3d, new_point3d);
+			return true;
+		} else if (last_point3d->Z + valid_step_z < new_point3d.Z
+				|| last_point3d->Z - valid_step_z > new_point3d.Z) {// Test Z
+			storeCoordinates(last_point3d, new_point3d);
+			return true;
+		} else
+			return false;
+	}
+}
+
+// Stores last coordinates
+void TrackingCore::storeCoordinates(Point3D *last_point3d,
+		Point3D new_point3d) {
+	if (last_point3d->X != new_point3d.X || last_point3d->Y != new_point3d.Y
+			|| last_point3d->Z != new_point3d.Z) {
+		last_point3d->X = new_point3d.X;
+		last_point3d->Y = new_point3d.Y;
+		last_point3d->Z = new_point3d.Z;
+	}
+}
+
+/*Format of data:
+ * #header|data_id|player_id|hand_id,left,right|x,y,z,c_p1|gesture,g_p1,g_p2,g_p3|sensor,capture,send#
+ * Formats the data and send it (see Protocol.h for the binary format)
+ */
+void TrackingCore::formatData(const char *header, int player_id, int hand_id,
+		int l_hand, int r_hand, float coordinates[3], float c_p1,
+		const char *gesture, float g_p1, float g_p2, float g_p3) {
+	int id = numbering ? data_id++ : 0;
+	printf("\n#%s|%i|%i|%i,%i,%i|%.3f,%.3f,%.3f,%.3f|%s,%.2f,%.2f,%.2f#\n",
+			header, id, player_id, hand_id, l_hand, r_hand,
+			coordinates[0], coordinates[1], coordinates[2], c_p1, gesture,
+			g_p1, g_p2, g_p3);
+	if (send != NULL) {
+		Message m;
+		initMessage(m, messageTypeFromName(header));
+		m.data_id = id;
+		m.player_id = player_id;
+		m.device_id = device_id;
+		m.hand_id = hand_id;
+		m.l_hand = l_hand;
+		m.r_hand = r_hand;
+		m.coordinates[0] = coordinates[0];
+		m.coordinates[1] = coordinates[1];
+		m.coordinates[2] = coordinates[2];
+		m.c_p1 = c_p1;
+		m.gesture = gestureFromName(gesture);
+		m.g_p1 = g_p1;
+		m.g_p2 = g_p2;
+		m.g_p3 = g_p3;
+		m.in_session = (m.type == MSG_SESSION_STARTED) || (in_session
+				&& m.type != MSG_SESSION_ENDED);
+		int tracked = users.size(); // Still tracked after the event
+		if (m.type == MSG_CALIBRATED_USER_LOST || m.type
+				== MSG_CALIBRATED_USER_EXIT)
+			tracked--;
+		m.calibrated = tracked > 0;
+		stampFrame(); // Events arrive while the backend reads the frame
+		m.sensor_time = frame_sensor_time;
+		m.capture_time = frame_capture_time;
+		send(m, send_cookie);
+	}
+	last_gesture = gesture;
+}
@@ -0,0 +1,142 @@
+/*
+ * TrackingCore.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef TRACKINGCORE_H_
+#define TRACKINGCORE_H_
+
+#include <stdint.h>
+#include <string>
+#include "Protocol.h"
+#include "SensorBackend.h"
+#include "SkeletonSnapshot.h"
+#include "JointProjector.h"
+#include "UserTable.h"
+
+// Receives the messages of a TrackingCore, with the cookie given with it
+typedef void (*MessageSender)(const Message &m, void *cookie);
+
+/*Turns what a SensorBackend reads into messages: the user, session and
+ * gesture events, the hand coordinates of every tracked user (only when they
+ * moved) and, with full skeletons, every joint. The session and its gestures
+ * belong to the first calibrated user still tracked. Messages get their
+ * data_id (unless numbering is off) and the times of their frame here, and go
+ * to the send function.
+ * Needs no OpenNI, capture thread only.
+ */
+class TrackingCore: public SensorListener {
+public:
+	TrackingCore();
+
+	// Called with every message
+	void setSender(MessageSender send, void *cookie = NULL) {
+		this->send = send;
+		send_cookie = cookie;
+	}
+
+	// Reads the field of view of sensor, which must be started
+	void setSensor(SensorBackend *sensor);
+
+	void setDeviceId(int id) {
+		device_id = id;
+	}
+
+	// Every joint as MSG_SKELETON (--skeleton)
+	void setFullSkeleton(bool full) {
+		full_skeleton = full;
+	}
+
+	// Hand coordinates of the users while in session
+	void setHandsTracking(bool on) {
+		hands_tracking = on;
+	}
+
+	// Off: messages go out with data_id 0 and don't use up ids, whoever
+	// merges them numbers them (several sensors)
+	void setNumbering(bool on) {
+		numbering = on;
+	}
+
+	// Remembers when the current depth frame was first seen
+	void stampFrame();
+
+	// Takes the joints of the frame into snapshot, and sends the hands and
+	// skeletons of its users
+	void processFrame(SkeletonSnapshot &snapshot);
+
+	// SensorListener
+	virtual void userCalibrated(int user);
+	virtual void userLost(int user, bool exited);
+	virtual void sessionStarted();
+	virtual void sessionEnded();
+	virtual void gestureDetected(GestureType gesture, float p1, float p2,
+			float p3);
+
+	// For messages sent around the core (other sensors, exit flag)
+	int nextDataId() {
+		return data_id++;
+	}
+
+	int dataId() const {
+		return data_id;
+	}
+
+	uint64_t frameCaptureTime() const {
+		return frame_capture_time;
+	}
+
+private:
+	void releaseUser(int id);
+	void takeSnapshot(SkeletonSnapshot &snapshot);
+	void handleHandPosition(const UserSnapshot &user, bool fix_coordinates =
+			true);
+	void sendSkeleton(const SkeletonSnapshot &snapshot,
+			const UserSnapshot &user);
+	void sendHandCoordinates(int player_id, Point3D h_coordinates,
+			int is_l_hand, int is_r_hand);
+	void sendHeadCoordinates(int player_id, Point3D h_coordinates,
+			int is_l_hand, int is_r_hand);
+	void fixCoordinates(Point3D *c);
+	bool checkCoordinates(Point3D *last_point3d, Point3D new_point3d);
+	void storeCoordinates(Point3D *last_point3d, Point3D new_point3d);
+	void formatData(const char *header, int player_id, int hand_id,
+			int l_hand, int r_hand, float coordinates[3], float c_p1,
+			const char *gesture, float g_p1, float g_p2, float g_p3);
+
+	MessageSender send;
+	void *send_cookie;
+	SensorBackend *sensor;
+	int device_id;
+	bool full_skeleton;
+	bool hands_tracking;
+
+	// Real world to depth map projection of the sensor
+	JointProjector joint_projector;
+	int res_x, res_y;
+	float valid_step_x, valid_step_y, valid_step_z;
+
+	// Users being tracked, and their state (hands, steady timers...)
+	UserTable users;
+
+	// The first calibrated user still tracked: the session (a single hand
+	// point) and its gestures are sent as this user's, -1 if none
+	int session_user;
+	bool in_session;
+
+	// Id of data sent
+	int data_id;
+	bool numbering;
+
+	// Depth frame the messages come from: its timestamp (sensor clock) and
+	// when it was first seen (CLOCK_MONOTONIC), both in us
+	uint64_t frame_sensor_time;
+	uint64_t frame_capture_time;
+
+	// Stores the last gesture recognized
+	std::string last_gesture;
+};
+
+#endif /* TRACKINGCORE_H_ */
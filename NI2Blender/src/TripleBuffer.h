@@ -0,0 +1,71 @@
+/*
+ * TripleBuffer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+
+/*Wait-free "latest value wins" exchange between one writer and one reader
+ * thread. The writer fills writeBuffer() and publish()es it, the reader calls
+ * update() and reads readBuffer(). Neither ever waits for the other and the
+ * reader never sees a half written value; values published while the reader
+ * wasn't looking are simply replaced by newer ones.
+ */
+template<typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() {
+		front = 0;
+		middle = 1;
+		back = 2;
+	}
+
+	//-------------------------------------------------------------------------
+	// Writer
+	//-------------------------------------------------------------------------
+
+	T& writeBuffer() {
+		return buffers[back];
+	}
+
+	// Returns true if it replaced a value the reader never got
+	bool publish() {
+		unsigned int previous = __atomic_exchange_n(&middle, back | DIRTY,
+				__ATOMIC_ACQ_REL);
+		back = previous & INDEX;
+		return (previous & DIRTY) != 0;
+	}
+
+	//-------------------------------------------------------------------------
+	// Reader
+	//-------------------------------------------------------------------------
+
+	// Takes the newest published value, returns false if there is none
+	bool update() {
+		if ((__atomic_load_n(&middle, __ATOMIC_ACQUIRE) & DIRTY) == 0)
+			return false;
+		unsigned int previous = __atomic_exchange_n(&middle, front,
+				__ATOMIC_ACQ_REL);
+		front = previous & INDEX;
+		return true;
+	}
+
+	const T& readBuffer() const {
+		return buffers[front];
+	}
+
+private:
+	enum {
+		INDEX = 3, DIRTY = 4
+	};
+
+	T buffers[3];
+	unsigned int front; // Reader only
+	unsigned int middle; // Shared: index | DIRTY when not read yet
+	unsigned int back; // Writer only
+};
+
+#endif /* TRIPLEBUFFER_H_ */
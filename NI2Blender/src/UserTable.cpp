@@ -0,0 +1,47 @@
+/*
+ * UserTable.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#include "UserTable.h"
+
+UserTable::UserTable() {
+	n_tracked = 0;
+	for (int i = 0; i < MAX_USERS; i++)
+		resetState(states[i]);
+}
+
+void UserTable::resetState(UserState &state) {
+	state.tracked = false;
+	state.l_last_point3d.X = 0;
+	state.l_last_point3d.Y = 0;
+	state.l_last_point3d.Z = 0;
+	state.r_last_point3d = state.l_last_point3d;
+	state.l_hand_out_fov = false;
+	state.r_hand_out_fov = false;
+	state.l_timer = Timer();
+	state.r_timer = Timer();
+}
+
+bool UserTable::startTracking(int id) {
+	if (!isValidId(id) || states[id].tracked)
+		return false;
+	states[id].tracked = true;
+	tracked[n_tracked++] = id;
+	return true;
+}
+
+bool UserTable::stopTracking(int id) {
+	if (!isTracked(id))
+		return false;
+	int i = 0;
+	while (tracked[i] != id)
+		i++;
+	// Keeps the calibration order
+	for (n_tracked--; i < n_tracked; i++)
+		tracked[i] = tracked[i + 1];
+	resetState(states[id]);
+	return true;
+}
@@ -0,0 +1,77 @@
+/*
+ * UserTable.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+#ifndef USERTABLE_H_
+#define USERTABLE_H_
+
+#include "MyTimer.h"
+#include "SkeletonSnapshot.h"
+
+// A projective point (x, y in pixels, z in mm)
+struct Point3D {
+	float X, Y, Z;
+};
+
+// What the capture thread keeps for each user between frames
+struct UserState {
+	bool tracked; // Calibrated, its skeleton is tracked
+	// To prevent repeated hand coordinates being sent
+	Point3D l_last_point3d;
+	Point3D r_last_point3d;
+	bool l_hand_out_fov;
+	bool r_hand_out_fov;
+	// To control steady hands
+	Timer l_timer;
+	Timer r_timer;
+};
+
+/*State of every user, in a table indexed by user id (OpenNI gives small ids
+ * and reuses them), with a dense list of the tracked ones in the order they
+ * were calibrated, so the work of a frame is one loop over them. Ids from
+ * MAX_USERS on are never tracked. Capture thread only.
+ */
+class UserTable {
+public:
+	UserTable();
+
+	static bool isValidId(int id) {
+		return id > 0 && id < MAX_USERS;
+	}
+
+	UserState& operator[](int id) {
+		return states[id];
+	}
+
+	bool isTracked(int id) const {
+		return isValidId(id) && states[id].tracked;
+	}
+
+	// Adds id to the tracked users, false if it already was or isn't valid
+	bool startTracking(int id);
+
+	// Removes id from the tracked users and forgets its state, false if it
+	// wasn't tracked
+	bool stopTracking(int id);
+
+	// Tracked users
+	int size() const {
+		return n_tracked;
+	}
+
+	int trackedUser(int i) const {
+		return tracked[i];
+	}
+
+private:
+	static void resetState(UserState &state);
+
+	UserState states[MAX_USERS];
+	int tracked[MAX_USERS];
+	int n_tracked;
+};
+
+#endif /* USERTABLE_H_ */
@@ -6,10 +6,31 @@
 #include <XnVNite.h>
 
 #include <iostream>
+#include <vector>
+#include <string.h>
+#include <pthread.h>
+#define GL_GLEXT_PROTOTYPES // Pixel buffer objects
 #include <GL/glut.h> // For GUI
 // Local header
 #include "MyMethods.h"
+#include "Protocol.h"
 #include "PracticalSocket.h"  // For Socket and SocketException
+#include "NetSender.h"
+#include "ShmRing.h"
+#include "FanOutServer.h"
+#include "TripleBuffer.h"
+#include "SkeletonSnapshot.h"
+#include "JointProjector.h"
+#include "UserTable.h"
+#include "StreamMerger.h"
+#include "SensorDevice.h"
+#include "SkeletonFusion.h"
+#include "FusionNode.h"
+#include "StreamReplay.h"
+#include "SensorBackend.h"
+#include "TrackingCore.h"
+#include "NiteBackend.h"
+#include "SyntheticBackend.h"
 #include "MyTimer.h"
 //-----------------------------------------------------------------------------
 // Error Handling
@@ -30,62 +51,91 @@ using namespace std;
 //-----------------------------------------------------------------------------
 // Globals
 //-----------------------------------------------------------------------------
-// OpenNI objects
-Context g_Context;
-DepthGenerator g_DepthGenerator;
-GestureGenerator g_GestureGenerator;
-HandsGenerator g_HandsGenerator;
-UserGenerator g_UserGenerator;
-XnMapOutputMode _outputModeDepth;
+// Where the frames come from: the sensor through OpenNI/NITE (nite, also
+// used directly for the preview image and the frame ring) or made up
+// (--synthetic)
+SensorBackend *sensor = NULL;
+NiteBackend *nite = NULL;
+
+// Turns the frames and events of the sensor into messages
+TrackingCore core;
 
 // Auxiliary vars for GUI
-ImageGenerator g_ImageGenerator;
-XnMapOutputMode _outputModeImage;
-ImageMetaData g_imageMD;
-XnRGB24Pixel* g_pTexMap = NULL;
 unsigned int g_nTexMapX = 0;
 unsigned int g_nTexMapY = 0;
+GLuint g_texture = 0; // Allocated once, frames only replace the image
+// Frames are uploaded through it (0 if pixel buffer objects aren't
+// supported), see uploadPreview()
+GLuint g_pixelBuffer = 0;
+bool g_newPreviewFrame = false; // Not uploaded yet
 
 #define GL_WIN_SIZE_X 640
 #define GL_WIN_SIZE_Y 480
 #define POSITION_X 1250 // or 1600 if you're using a single monitor
 #define POSITION_Y 410
 #define USE_GUI_GLUT 1
+#define PREVIEW_INTERVAL 33 // ms between checks for a new preview frame
+
+// RGB image of a frame, copied by the capture thread for the preview
+struct PreviewFrame {
+	std::vector<XnRGB24Pixel> pixels;
+	XnUInt32 x_res, y_res;
+	XnUInt32 x_offset, y_offset;
+	XnUInt32 full_x_res, full_y_res;
+};
+
+// Newest frame for the GUI thread, which never waits for the capture thread
+TripleBuffer<PreviewFrame> preview_frames;
+
+// Skeleton of the newest frame, for the GUI thread
+TripleBuffer<SkeletonSnapshot> preview_skeletons;
 
-//NITE objects
-XnVSessionManager* _sessionManager;
-XnVBroadcaster* _broadcaster;
-XnVWaveDetector* _waveDetector;
-XnVPushDetector* _pushDetector;
-XnVCircleDetector* _circleDetector;
-XnVSwipeDetector* _swipeDetector;
-XnVSteadyDetector* _steadyDetector;
-
-// For debugging purposes
-XnBool _printGesture = false;
-XnBool _printCircle = false;
-XnBool _printSessionStatus = false;
-XnBool _printUserTracking = true;
-XnBool _printHandsTracking = false;
+// The preview shows the RGB image ('p' toggles it). Set by the GUI thread,
+// the capture thread creates or releases the RGB stream to follow it.
+bool preview_image = false;
+
+// The recording played by --playback (or the --synthetic-frames) has no more
+// frames (set by the capture thread), and when it ended
+bool playback_ended = false;
+uint64_t playback_start = 0;
+uint64_t playback_end = 0;
+
+// Reads the sensor and runs NITE, so the GUI never slows the tracking down
+pthread_t capture_thread;
+bool capture_running = false;
+bool capture_stopping = false;
 
 // Toggle on/off features
 XnBool _featureGesture = true;
 XnBool _featureCircle = true;
-const XnBool _featureUserTracking = true; // If it's not true, nothing works
 XnBool _featureHandsTracking = true;
 
 // Toggle extra features
 XnBool _mirror = true;
 XnBool _useSockets = true;
-
-// Session control
-XnBool _sessionInitialized = false;
-XnBool _inSession = false;
-XnBool _sessionRegistered = false;
-
-// User tracking vars
-XnBool _needPose = false;
-XnChar _strPose[20] = "";
+string _serverAddress = "localhost"; // Host, or socket path (--server)
+unsigned short _serverPort = 2001; // --port
+WireFormat _wireFormat = WIRE_FORMAT_TEXT; // --binary, --compact
+XnBool _batchFrames = true; // One send per frame, --no-batch disables it
+XnBool _udpCoordinates = false; // Coordinates over UDP, events over TCP (--udp)
+unsigned short _udpPort = 2002; // --udp-port
+string _multicastGroup = ""; // Multicast group for coordinates (--multicast)
+unsigned char _multicastTTL = 1; // Only the local network by default
+string _shmName = ""; // Shared memory ring instead of sockets (--shm)
+XnBool _shmFrames = false; // Depth/RGB frames in a second ring (--shm-frames)
+unsigned short _listenPort = 0; // Serve several clients instead (--listen)
+XnBool _fullSkeleton = false; // Every joint as MSG_SKELETON (--skeleton)
+XnBool _allDevices = false; // Every attached sensor (--all-devices)
+int _deviceId = 0; // device_id of the first sensor (--device-id)
+unsigned short _fusionPort = 0; // Fuse other instances instead (--fusion)
+string _calibrationFile = ""; // Sensor poses for --fusion (--calibration)
+string _replayFile = ""; // Send a recorded stream instead (--replay)
+string _recordFile = ""; // Record the sensor streams to an .oni (--record)
+string _playbackFile = ""; // Play an .oni instead of the sensor (--playback)
+double _playbackSpeed = 1.0; // --playback-speed, 0 = as fast as possible
+int _syntheticUsers = 0; // Made up users instead of the sensor (--synthetic)
+double _syntheticRate = 30; // --synthetic-rate, 0 = as fast as possible
+unsigned long _syntheticFrames = 0; // --synthetic-frames, 0 = without end
 
 // Set the frames per second
 //XnFPSData _xnFPS;
@@ -93,646 +143,402 @@ XnChar _strPose[20] = "";
 // Setup the status
 XnStatus nRetVal = XN_STATUS_OK;
 
-// XnVHandles
-XnVHandle hSessionManager;
-
 // Socket object
-TCPSocket tcp_sock;
-
-// Resolution of output map
-const int res_x = XN_VGA_X_RES;
-const int res_y = XN_VGA_Y_RES;
-const int res_z = 4000; // == 4m
+UDPSocket *udp_sock = NULL; // Only with _udpCoordinates
 
-// User id control
-int user_id = -1;
+// Sends the messages on its own thread, owns the stream socket (TCP or Unix)
+NetSender net_sender;
 
-// Id of data sent
-int data_id = 1;
+// Shared memory transport (same machine as Blender)
+ShmRing *shm_ring = NULL; // Messages, written by the sender thread
+ShmRing *shm_frame_ring = NULL; // Frames, written by the capture thread
+#define SHM_RING_SIZE (1 << 20)
+#define SHM_FRAME_RING_SIZE (1 << 24) // ~16 VGA depth frames
 
-// Stores the last gesture recognized
-string last_gesture;
+// Server mode, every subscriber gets all the messages
+FanOutServer *fan_out = NULL;
 
-//Time to control steady hand
-Timer l_timer = Timer();
-Timer r_timer = Timer();
+// Sensors after the first one (--all-devices), merger sources 1 to
+// n_devices - 1. Their messages and the ones of this thread (source 0) are
+// merged in capture_time order before they go to the sender.
+SensorDevice *devices[MAX_DEVICES];
+int n_devices = 1;
+StreamMerger merger;
 
-// Variable to prevent repeated data (provided from hands) be sent
-XnPoint3D l_last_point3d;
-XnPoint3D r_last_point3d;
-bool l_hand_out_fov = false;
-bool r_hand_out_fov = false;
+// Resolution of output map
+const int res_x = XN_VGA_X_RES;
+const int res_y = XN_VGA_Y_RES;
 
-// Percent to filter data (coordinates from hands)
-const float percent = 1.5;
-float valid_step_x = (res_x * percent) / 100;
-float valid_step_y = (res_y * percent) / 100;
-float valid_step_z = (res_z * percent) / 100;
+int flushed_data_id = 1; // Messages up to here were handed to the sender
 
-// Definitions
-#define GESTURE_INIT_SESSION "Wave"
-#define KINECT_SMOOTHING_HANDS 0.8
-#define KINECT_SMOOTHING_SKELETON 0.8
-#define SECONDS_STEADY_HAND 1.5
+// Wakeups, and the ones without new skeleton data
+unsigned long n_wakeups = 0;
+unsigned long n_depth_frames = 0;
+unsigned long n_skipped_wakeups = 0;
 
 //-----------------------------------------------------------------------------
-// CALLBACKS
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// Session Event Handlers
+// Methods
 //-----------------------------------------------------------------------------
 
-void XN_CALLBACK_TYPE SessionStart(const XnPoint3D& pFocus, void* UserCxt) {
-	if (_printSessionStatus)
-		printf("\nSession Started");
-	if (!_inSession) {
-		if (_useSockets) {
-			char header[16] = "session_started";
-			float coordinates[3] = { 0.0, 0.0, 0.0 };
-			char gesture[5] = "none";
-			formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-					0.0, 0.0, 0.0);
-		}
-		addListeners();
-	}
-	_inSession = true;
-}
-
-void XN_CALLBACK_TYPE SessionEnd(void* UserCxt) {
-	if (_printSessionStatus)
-		printf("\nSession Ended");
-	if (_inSession) {
-		if (_useSockets) {
-			char header[14] = "session_ended";
-			float coordinates[3] = { 0.0, 0.0, 0.0 };
-			char gesture[5] = "none";
-			formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-					0.0, 0.0, 0.0);
+// Opens the stream socket to the server and starts connecting it, called by
+// the sender thread for the first connection and after each failure. A
+// _serverAddress with a '/' is the path of a Unix domain socket
+// (SOCK_SEQPACKET, _serverPort unused).
+CommunicatingSocket* connectStream() {
+	if (_serverAddress.find('/') != string::npos) {
+		UnixSocket *sock = new UnixSocket();
+		try {
+			sock->startConnect(_serverAddress);
+		} catch (SocketException &e) {
+			delete sock;
+			throw;
 		}
-		removeListeners();
+		return sock;
 	}
-	_inSession = false;
-}
-
-//-----------------------------------------------------------------------------
-// Circle Events
-//-----------------------------------------------------------------------------
-
-void XN_CALLBACK_TYPE CircleCB(XnFloat fTimes, XnBool bConfident,
-		const XnVCircle* pCircle, void* UserCxt) {
-	if (_printCircle) {
-		float fAngle = fmod((double) fTimes, 1.0) * 2 * XnVMathCommon::PI;
-		printf("\nCircle - Angle:%.2f, Confident:%i, Radius:%.2f", fAngle,
-				(int) bConfident, pCircle->fRadius);
-	}
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[7] = "circle";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				pCircle->fRadius, (float) bConfident, 0.0);
-	}
-	_circleDetector->Reset(); // Used to force recognize only one circle gesture
-}
-
-void XN_CALLBACK_TYPE NoCircleCB(XnFloat fLastValue,
-		XnVCircleDetector::XnVNoCircleReason reason, void* UserCxt) {
-	if (_printCircle)
-		printf("\nNo Circle - Last Value:%.2f, No Circle Reason:%d",
-				fLastValue, reason);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[10] = "no_circle";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				fLastValue, (int) reason, 0.0);
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Gesture Events
-//-----------------------------------------------------------------------------
-
-void XN_CALLBACK_TYPE SwipeUp(XnFloat fVelocity, XnFloat fAngle, void* UserCxt) {
-	if (_printGesture)
-		printf("\nSwipe Up - Velocity:%.2f, Angle:%.2f", fVelocity, fAngle);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[9] = "swipe_up";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				fVelocity, fAngle, 0.0);
+	TCPSocket *sock = new TCPSocket();
+	try {
+		if (_batchFrames)// Batches are already one segment per frame
+			sock->setNoDelay(true);
+		sock->startConnect(_serverAddress, _serverPort);
+	} catch (SocketException &e) {
+		delete sock;
+		throw;
 	}
+	return sock;
 }
 
-void XN_CALLBACK_TYPE SwipeDown(XnFloat fVelocity, XnFloat fAngle,
-		void* UserCxt) {
-	if (_printGesture)
-		printf("\nSwipe Down - Velocity:%.2f, Angle:%.2f", fVelocity, fAngle);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[11] = "swipe_down";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				fVelocity, fAngle, 0.0);
-	}
+// Messages sent back by Blender through the stream socket (control channel),
+// called on the sender thread
+void handleServerMessage(const Message &m) {
+	printf("\nFrom the server: %s %d", messageTypeName(m.type), m.data_id);
 }
 
-void XN_CALLBACK_TYPE SwipeLeft(XnFloat fVelocity, XnFloat fAngle,
-		void* UserCxt) {
-	if (_printGesture)
-		printf("\nSwipe Left - Velocity:%.2f, Angle:%.2f", fVelocity, fAngle);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[11] = "swipe_left";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				fVelocity, fAngle, 0.0);
-	}
-}
-
-void XN_CALLBACK_TYPE SwipeRight(XnFloat fVelocity, XnFloat fAngle,
-		void* UserCxt) {
-	if (_printGesture)
-		printf("\nSwipe Right - Velocity:%.2f, Angle:%.2f", fVelocity, fAngle);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[12] = "swipe_right";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				fVelocity, fAngle, 0.0);
-	}
-}
-
-void XN_CALLBACK_TYPE OnWave(void* UserCxt) {
-	if (_printGesture)
-		printf("\nWave Occured");
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[8] = "on_wave";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture, 0.0,
-				0.0, 0.0);
-	}
-	//_sessionManager->EndSession();// TODO: Check if turn off the session here is a good idea
-}
-
-void XN_CALLBACK_TYPE OnPush(XnFloat fVelocity, XnFloat fAngle, void* UserCxt) {
-	if (_printGesture)
-		printf("\nPush Occured - Velocity:%.2f, Angle:%.2f", fVelocity, fAngle);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[8] = "on_push";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				fVelocity, fAngle, 0.0);
-	}
-}
-
-void XN_CALLBACK_TYPE StabilizedPush(XnFloat fVelocity, void* UserCxt) {
-	if (_printGesture)
-		printf("\nPush Stabilized - Velocity:%.2f", fVelocity);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[16] = "stabilized_push";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-				fVelocity, 0.0, 0.0);
-	}
-}
-
-void XN_CALLBACK_TYPE OnSteady(XnUInt32 nId, XnFloat fVelocity, void* UserCxt) {
-	if (_printGesture)
-		printf("\nSteady Occured - Id:%d, Velocity:%.2f", nId, fVelocity);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[10] = "on_steady";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture, 0.0,
-				0.0, 0.0);
-	}
-}
-
-void XN_CALLBACK_TYPE NotSteady(XnUInt32 nId, XnFloat fVelocity, void* UserCxt) {
-	if (_printGesture)
-		printf("\nNot Steady Occured - Id:%d, Velocity:%.2f", nId, fVelocity);
-	if (_useSockets) {
-		char header[8] = "gesture";
-		float coordinates[3] = { 0.0, 0.0, 0.0 };
-		char gesture[11] = "not_steady";
-		formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture, 0.0,
-				0.0, 0.0);
+// Client socket initialization and configuration. The stream socket is
+// connected (and reconnected) by the sender thread, see connectStream().
+void initSocket(string servAddress, unsigned short servPort) {
+	net_sender.setConnector(connectStream);
+	net_sender.setControlHandler(handleServerMessage);
+	if (servAddress.find('/') != string::npos) {
+		net_sender.setPacketMode(true); // One message per packet, no '#' scan
+		if (!net_sender.start(NULL, _wireFormat))
+			exit(1);
+		return;
 	}
-}
-
-//-----------------------------------------------------------------------------
-// User Tracking/Skeleton Events
-//-----------------------------------------------------------------------------
-
-void XN_CALLBACK_TYPE NewUser(UserGenerator& generator, XnUserID nId,
-		void* pCookie) {
-	if (_printUserTracking)
-		printf("\nNew User: %d", nId);
-	if (user_id == -1) {
-		if (_needPose) {
-			g_UserGenerator.GetPoseDetectionCap().StartPoseDetection(_strPose,
-					nId);
+	if (_udpCoordinates) {
+		udp_sock = new UDPSocket();
+		if (_multicastGroup.empty()) {
+			udp_sock->connect(servAddress, _udpPort);
 		} else {
-			g_UserGenerator.GetSkeletonCap().RequestCalibration(nId, true);
+			udp_sock->setMulticastTTL(_multicastTTL);
+			udp_sock->connect(_multicastGroup, _udpPort);
 		}
+		net_sender.setDatagramSocket(udp_sock);
 	}
+	if (!net_sender.start(NULL, _wireFormat))
+		exit(1);
 }
 
-void XN_CALLBACK_TYPE LostUser(UserGenerator& generator, XnUserID nId,
-		void* pCookie) {
-	if (_printUserTracking)
-		printf("\nLost user: %d", nId);
-	if ((int) nId == user_id) {
-		if (_printUserTracking)
-			printf("\nThe calibrated user (%d) was lost", nId);
-		if (_useSockets) {
-			char header[21] = "calibrated_user_lost";
-			float coordinates[3] = { 0.0, 0.0, 0.0 };
-			char gesture[5] = "none";
-			formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-					0.0, 0.0, 0.0);
-		}
-		user_id = -1;
-		if (_inSession)// Ends the session is still open
-			_sessionManager->EndSession();
-		if (_sessionRegistered)// Unregister session manager if registered
-			unregisterSessionManager(hSessionManager);
+// Shared memory initialization, used instead of initSocket when Blender runs
+// on the same machine. The frame ring is named <name>_frames.
+void initSharedMemory(string name) {
+	shm_ring = new ShmRing();
+	if (!shm_ring->create(name, SHM_RING_SIZE))
+		exit(1);
+	if (_shmFrames) {
+		shm_frame_ring = new ShmRing();
+		if (!shm_frame_ring->create(name + "_frames", SHM_FRAME_RING_SIZE))
+			exit(1);
 	}
+	net_sender.setRing(shm_ring);
+	if (!net_sender.start(NULL, _wireFormat))
+		exit(1);
 }
 
-void XN_CALLBACK_TYPE UserExit(UserGenerator& generator, XnUserID nId,
-		void* pCookie) {
-	if (_printUserTracking)
-		printf("\nThe user %d exited from field of view", nId);
-	if ((int) nId == user_id) {
-		if (_printUserTracking)
-			printf("\nThe calibrated user (%d) exited from field of view", nId);
-		if (_useSockets) {
-			char header[21] = "calibrated_user_exit";
-			float coordinates[3] = { 0.0, 0.0, 0.0 };
-			char gesture[5] = "none";
-			formatData(header, user_id, -1, -1, -1, coordinates, 0.0, gesture,
-					0.0, 0.0, 0.0);
-		}
-		user_id = -1;
-		if (_inSession)// Ends the session is still open
-			_sessionManager->EndSession();
-		if (_sessionRegistered)// Unregister session manager if registered
-			unregisterSessionManager(hSessionManager);
-	}
+// Server mode initialization, used instead of initSocket: the clients (Blender,
+// recorders...) connect to port and each one gets every message.
+void initFanOut(unsigned short port) {
+	fan_out = new FanOutServer();
+	if (!fan_out->start(port))
+		exit(1);
+	net_sender.setFanOut(fan_out);
+	if (!net_sender.start(NULL, _wireFormat))
+		exit(1);
 }
 
-void XN_CALLBACK_TYPE UserReEnter(UserGenerator& generator, XnUserID nId,
-		void* pCookie) {
-	if (_printUserTracking)
-		printf("\nUser %d re-entered the scene after exiting", nId);
-	if (user_id == -1) {
-		if (_needPose) {
-			g_UserGenerator.GetPoseDetectionCap().StartPoseDetection(_strPose,
-					nId);
-		} else {
-			g_UserGenerator.GetSkeletonCap().RequestCalibration(nId, true);
-		}
+// Queues the message for the sender thread, which encodes it using the
+// selected wire format. Without batching it is handed over right away. With
+// several sensors it waits in the merger until the frame is flushed.
+void sendMessage(const Message &m, void *cookie) {
+	if (n_devices > 1) {
+		merger.push(0, m); // Events wait if the queue is full, never dropped
+		return;
 	}
-}
-
-void XN_CALLBACK_TYPE UserPoseDetected(PoseDetectionCapability& capability,
-		const XnChar* strPose, XnUserID nId, void* pCookie) {
-	if (_printUserTracking)
-		printf("\nPose %s detected for user: %d", strPose, nId);
-	g_UserGenerator.GetPoseDetectionCap().StopPoseDetection(nId);
-	g_UserGenerator.GetSkeletonCap().RequestCalibration(nId, true);
-}
-
-void XN_CALLBACK_TYPE UserCalibrationStart(SkeletonCapability& capability,
-		XnUserID nId, void* pCookie) {
-	if (_printUserTracking)
-		printf("\nCalibration started for user: %d", nId);
-}
-// Save user id when it is -1, create and initialize session manager
-void XN_CALLBACK_TYPE UserCalibrationComplete(SkeletonCapability& capability,
-		XnUserID nId, XnCalibrationStatus eStatus, void* pCookie) {
-	if (eStatus == XN_CALIBRATION_STATUS_OK) {
-		if (_printUserTracking)
-			printf("\nCalibration complete, start tracking user: %d", nId);
-		g_UserGenerator.GetSkeletonCap().StartTracking(nId);
-		if (user_id == -1) {
-			user_id = nId;
-			if (_useSockets) {
-				char header[20] = "new_user_calibrated";
-				float coordinates[3] = { 0.0, 0.0, 0.0 };
-				char gesture[5] = "none";
-				formatData(header, user_id, -1, -1, -1, coordinates, 0.0,
-						gesture, 0.0, 0.0, 0.0);
-			}
-		}
-		if (!_sessionInitialized)// Initializes session manager if was not initialized
-			initSessionManager();
-		if (!_sessionRegistered)// Add callbacks for session manager
-			hSessionManager = registerSessionManager();
+	net_sender.enqueue(m); // Coordinates may be coalesced, events never drop
+	if (!_batchFrames)
+		net_sender.publish();
+}
+
+// Hands the messages of the current frame to the sender thread, which sends
+// them with a single call
+void flushFrame() {
+	if (n_devices > 1)
+		mergeDevices();
+	net_sender.publish();
+}
+
+// Moves the messages of every sensor that are in order (up to the last frame
+// all of them reached) to the sender. Every message gets its data_id here,
+// also the ones of this thread (the cores don't number them), so data_id
+// grows along the merged stream as replaying after a reconnection expects.
+void mergeDevices() {
+	merger.endFrame(0, core.frameCaptureTime());
+	Message m;
+	while (merger.pop(m)) {
+		m.data_id = core.nextDataId();
+		net_sender.enqueue(m);
+	}
+}
+
+// Reads the next frame, runs the tracking and sends the data produced by it.
+// Each stage only runs if its input changed since the last wakeup.
+bool updateFrame() {
+	SensorUpdate u;
+	if (!sensor->update(u))
+		return false;
+	n_wakeups++;
+	if (u.new_depth) {
+		n_depth_frames++;
+		core.stampFrame();
+	}
+	if (u.new_user) {
+		// The state of this frame, read by everything after this point
+		SkeletonSnapshot &snapshot = preview_skeletons.writeBuffer();
+		snapshot.frame_id = u.frame_id;
+		core.processFrame(snapshot);
+		preview_skeletons.publish();
 	} else {
-		if (_printUserTracking)
-			printf("\nCalibration failed for user: %d", nId);
-		if (eStatus == XN_CALIBRATION_STATUS_MANUAL_ABORT) {
-			printf("\nManual abort occurred, stop attempting to calibrate!");
-			return;
-		}
-		if (_needPose)
-			g_UserGenerator.GetPoseDetectionCap().StartPoseDetection(_strPose,
-					nId);
-		else
-			g_UserGenerator.GetSkeletonCap().RequestCalibration(nId, true);
-	}
+		n_skipped_wakeups++;
+	}
+	// Also the events of the callbacks, whatever woke us up, and the other
+	// sensors' frames
+	if (_useSockets && (core.dataId() != flushed_data_id || n_devices > 1)) {
+		flushFrame();
+		flushed_data_id = core.dataId();
+	}
+	if (shm_frame_ring != NULL && nite != NULL)
+		writeFrames(u.new_depth, u.new_image);
+	if (u.new_image)
+		publishPreview();
+	return true;
+}
+
+// Copies the new depth map and RGB image (if generated) of the current frame
+// into the frame ring. A frame is skipped while the reader is behind.
+void writeFrames(bool depth, bool image) {
+	if (depth) {
+		DepthMetaData depthMD;
+		nite->getDepth().GetMetaData(depthMD);
+		writeFrame(SHM_RECORD_DEPTH_FRAME, depthMD, depthMD.Data(),
+				sizeof(XnDepthPixel));
+	}
+	if (image) {
+		ImageMetaData imageMD;
+		nite->getImage().GetMetaData(imageMD);
+		writeFrame(SHM_RECORD_IMAGE_FRAME, imageMD, imageMD.RGB24Data(),
+				sizeof(XnRGB24Pixel));
+	}
+}
+
+void writeFrame(ShmRecordType type, const MapMetaData &md, const void *pixels,
+		int bytesPerPixel) {
+	uint32_t size = md.XRes() * md.YRes() * bytesPerPixel;
+	char *record = shm_frame_ring->reserve(sizeof(ShmFrameHeader) + size);
+	if (record == NULL)
+		return;
+	ShmFrameHeader *frame = (ShmFrameHeader*) record;
+	frame->frame_id = md.FrameID();
+	frame->width = md.XRes();
+	frame->height = md.YRes();
+	frame->bytes_per_pixel = bytesPerPixel;
+	frame->reserved = 0;
+	frame->timestamp = md.Timestamp();
+	xnOSMemCopy(frame + 1, pixels, size);
+	shm_frame_ring->commit(type, sizeof(ShmFrameHeader) + size);
 }
 
-//-----------------------------------------------------------------------------
-// Methods
-//-----------------------------------------------------------------------------
-
-// Client socket initialization and configuration
-void initSocket(string servAddress, unsigned short servPort) {
-	tcp_sock.connect(servAddress, servPort);
+// Capture thread: the RGB stream only runs while the preview shows it, so
+// without it only depth and skeleton data are read from the sensor
+void updateImageGenerator() {
+	if (nite != NULL && !nite->setImage(__atomic_load_n(&preview_image,
+			__ATOMIC_ACQUIRE)))
+		__atomic_store_n(&preview_image, false, __ATOMIC_RELEASE);
 }
 
-void addListeners() {
-	if (_featureGesture) {
-		_broadcaster->AddListener(_waveDetector);
-		_broadcaster->AddListener(_pushDetector);
-		_broadcaster->AddListener(_swipeDetector);
-		_broadcaster->AddListener(_steadyDetector);
-	}
-
-	if (_featureCircle)
-		_broadcaster->AddListener(_circleDetector);
-
-	_sessionManager->AddListener(_broadcaster);
+// GUI thread
+void setPreviewImage(bool show) {
+	__atomic_store_n(&preview_image, show, __ATOMIC_RELEASE);
 }
 
-void removeListeners() {
-	if (_featureGesture) {
-		_broadcaster->RemoveListener(_waveDetector);
-		_broadcaster->RemoveListener(_pushDetector);
-		_broadcaster->RemoveListener(_swipeDetector);
-		_broadcaster->RemoveListener(_steadyDetector);
+// Runs the tracking until stopCapture()
+void* captureLoop(void *arg) {
+	while (!__atomic_load_n(&capture_stopping, __ATOMIC_ACQUIRE)) {
+		updateImageGenerator();
+		updateFrame();
+		if (checkPlaybackEnd())
+			break;
 	}
-
-	if (_featureCircle)
-		_broadcaster->RemoveListener(_circleDetector);
-
-	_sessionManager->RemoveListener(_broadcaster);
+	return NULL;
 }
 
-// Create and initialize session manager
-void initSessionManager() {
-	// Create and initialize point tracker
-	_sessionManager = new XnVSessionManager();
-	nRetVal = _sessionManager->Initialize(&g_Context, GESTURE_INIT_SESSION,
-			"RaiseHand", &g_HandsGenerator, &g_GestureGenerator,
-			&g_GestureGenerator); // I change here...putting generators on initialize session
-	if (nRetVal != XN_STATUS_OK) {
-		printf("Couldn't initialize the Session Manager: %s\n",
-				xnGetStatusString(nRetVal));
-		cleanUpExit();
+bool startCapture() {
+	if (pthread_create(&capture_thread, NULL, captureLoop, NULL) != 0) {
+		printf("\nCouldn't create the capture thread");
+		return false;
 	}
-	_sessionManager->SetQuickRefocusTimeout(15000);// Time to finish the session when any movement is detected (ms)
-	_sessionManager->SetPrimaryStaticTimeout(2.0);// Time to recognize another gesture (s)
-	_sessionInitialized = true;
+	capture_running = true;
+	return true;
 }
 
-// Registers session manager and return Handle, allowing unregistering.
-XnVHandle registerSessionManager() {
-	XnVHandle handleSessionManager = _sessionManager->RegisterSession(NULL,
-			&SessionStart, &SessionEnd);
-	_sessionRegistered = true;
-	return handleSessionManager;
+// Waits for the frame being processed, the callbacks stop with it
+void stopCapture() {
+	if (!capture_running)
+		return;
+	__atomic_store_n(&capture_stopping, true, __ATOMIC_RELEASE);
+	pthread_join(capture_thread, NULL);
+	capture_running = false;
+}
+
+// Capture thread: true once the recording has been played to the end (or the
+// last --synthetic-frames made)
+bool checkPlaybackEnd() {
+	if (!sensor->atEnd())
+		return false;
+	if (!playbackEnded()) {
+		playback_end = monotonicMicros();
+		if (_syntheticUsers > 0)
+			printf("\nEnd of the synthetic run");
+		else
+			printf("\nEnd of %s", _playbackFile.c_str());
+		__atomic_store_n(&playback_ended, true, __ATOMIC_RELEASE);
+	}
+	return true;
 }
 
-// Unregisters session manager
-void unregisterSessionManager(XnVHandle h) {
-	_sessionManager->UnregisterSession(h);
-	_sessionRegistered = false;
+bool playbackEnded() {
+	return __atomic_load_n(&playback_ended, __ATOMIC_ACQUIRE);
 }
 
-// Extracts and sends hand position data and more
-void handleHandPosition(bool fix_coordinates = true) {
-	XnSkeletonJointPosition skeleton_hands[2]; // 0=left; 1=right
-	g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(user_id,
-			XN_SKEL_LEFT_HAND, skeleton_hands[0]);
-	g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(user_id,
-			XN_SKEL_RIGHT_HAND, skeleton_hands[1]);
-	if (skeleton_hands[0].fConfidence > 0.5) {// Left hand
-		//printf("\nLeft Hand from Skeleton - (%3.3f, %3.3f, %4.3f), Confidence:%2.2f", skeleton_hands[0].position.X,	skeleton_hands[0].position.Y, skeleton_hands[0].position.Z,	skeleton_hands[0].fConfidence);
-		if(l_hand_out_fov)l_hand_out_fov = false;
-		g_DepthGenerator.ConvertRealWorldToProjective(1,
-				&skeleton_hands[0].position, &skeleton_hands[0].position);
-		if (fix_coordinates)
-			fixCoordinates(&skeleton_hands[0].position);
-		if (checkCoordinates(&l_last_point3d, skeleton_hands[0].position)) {// Hand in movement
-			if (_printHandsTracking)
-				printf(
-						"\nLeft Hand from Skeleton - (%3.3f, %3.3f, %4.3f), Confidence:%2.2f",
-						skeleton_hands[0].position.X,
-						skeleton_hands[0].position.Y,
-						skeleton_hands[0].position.Z,
-						skeleton_hands[0].fConfidence);
-			if (_useSockets)
-				sendHandCoordinates(skeleton_hands[0].position, 1, 0);
-			if (l_timer.isRunning())
-				l_timer.reset();
-		} else {// Hand isn't in movement
-			l_timer.start();
-			if (!l_timer.isOver(SECONDS_STEADY_HAND)) {
-				XnSkeletonJointPosition skeleton_head;
-				g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(
-						user_id, XN_SKEL_HEAD, skeleton_head);
-				g_DepthGenerator.ConvertRealWorldToProjective(1,
-						&skeleton_head.position, &skeleton_head.position);
-				if (_useSockets)
-					//sendHeadCoordinates(skeleton_head.position, 1, 0); //TODO: Disable for tests
-				l_timer.reset();
-			}
-		}
+// Opens every sensor after the first one (which nite already uses), each
+// with its own capture thread
+void startDevices() {
+	NodeInfoList list;
+	nRetVal = nite->getContext().EnumerateProductionTrees(XN_NODE_TYPE_DEVICE,
+			NULL, list);
+	if (nRetVal != XN_STATUS_OK) {
+		printf("\nEnumerate devices failed: %s", xnGetStatusString(nRetVal));
+		return;
 	}
-	if (skeleton_hands[1].fConfidence > 0.5) {// Right hand
-		//printf("\nRight Hand from Skeleton - (%3.3f, %3.3f, %4.3f), Confidence:%2.2f", skeleton_hands[1].position.X, skeleton_hands[1].position.Y, skeleton_hands[1].position.Z, skeleton_hands[1].fConfidence);
-		if(r_hand_out_fov)r_hand_out_fov = false;
-		g_DepthGenerator.ConvertRealWorldToProjective(1,
-				&skeleton_hands[1].position, &skeleton_hands[1].position);
-		if (fix_coordinates)
-			fixCoordinates(&skeleton_hands[1].position);
-		if (checkCoordinates(&r_last_point3d, skeleton_hands[1].position)) {// Hand in movement
-			if (_printHandsTracking)
-				printf(
-						"\nRight Hand from Skeleton - (%3.3f, %3.3f, %4.3f), Confidence:%2.2f",
-						skeleton_hands[1].position.X,
-						skeleton_hands[1].position.Y,
-						skeleton_hands[1].position.Z,
-						skeleton_hands[1].fConfidence);
-			if (_useSockets)
-				sendHandCoordinates(skeleton_hands[1].position, 0, 1);
-			if (r_timer.isRunning())
-				r_timer.reset();
-		} else {// Hand isn't in movement
-			r_timer.start();
-			if (!r_timer.isOver(SECONDS_STEADY_HAND)) {
-				XnSkeletonJointPosition skeleton_head;
-				g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(
-						user_id, XN_SKEL_HEAD, skeleton_head);
-				g_DepthGenerator.ConvertRealWorldToProjective(1,
-						&skeleton_head.position, &skeleton_head.position);
-				if(_useSockets)
-					//sendHeadCoordinates(skeleton_head.position, 0, 1); //TODO: Disable for tests
-				r_timer.reset();
-			}
+	int found = 0;
+	for (NodeInfoList::Iterator it = list.Begin(); it != list.End(); ++it)
+		found++;
+	printf("\n%d sensors found", found);
+	if (_deviceId + found > MAX_DEVICES) { // device_id of each one
+		printf("\nOnly the first %d are used", MAX_DEVICES - _deviceId);
+		found = MAX_DEVICES - _deviceId;
+	}
+	for (int index = 1; index < found; index++) {
+		SensorDevice *device = new SensorDevice(n_devices, _deviceId
+				+ n_devices, &merger);
+		if (!device->start(index, _mirror)) {
+			delete device;
+			continue;
 		}
+		devices[n_devices++] = device;
 	}
+	merger.setSources(n_devices);
+	// The merged stream is numbered in mergeDevices() only
+	core.setNumbering(n_devices == 1);
 }
 
-// Sends hand coordinates data to socket connection
-void sendHandCoordinates(XnPoint3D h_coordinates, int is_l_hand, int is_r_hand) {
-	char *header = "hand_coordinates";
-	float coordinates[3] = { h_coordinates.X, h_coordinates.Y, h_coordinates.Z };
-	char *gesture = "none";
-	formatData(header, user_id, 0, is_l_hand, is_r_hand, coordinates, 0.0,
-			gesture, 0.0, 0.0, 0.0);
-}
-
-// Sends head coordinates data to socket connection
-// TODO: Verificar a necessidade de filtrar estes dados aqui, no cliente.
-void sendHeadCoordinates(XnPoint3D h_coordinates, int is_l_hand, int is_r_hand) {
-	char *header = "head_coordinates";
-	float coordinates[3] = { h_coordinates.X, h_coordinates.Y, h_coordinates.Z };
-	char *gesture = "none";
-	formatData(header, user_id, 0, is_l_hand, is_r_hand, coordinates, 0.0,
-			gesture, 0.0, 0.0, 0.0);
-}
-
-// Fix coordinates
-void fixCoordinates(XnPoint3D *c) {
-	if (c->X > res_x)
-		c->X = res_x;
-	else if (c->X < 0)
-		c->X = 0;
-	if (c->Y > res_y)
-		c->Y = res_y;
-	else if (c->Y < 0)
-		c->Y = 0;
-}
-
-// Checks if the new point3d is valid, and stores it if so
-bool checkCoordinates(XnPoint3D *last_point3d, XnPoint3D new_point3d) {
-	if (last_point3d->X == 0 && last_point3d->Y == 0) {
-		storeCoordinates(last_point3d, new_point3d);
-		return true;
-	} else {
-		if (last_point3d->X + valid_step_x < new_point3d.X || last_point3d->X
-				- valid_step_x > new_point3d.X) {// Test X
-			storeCoordinates(last_point3d, new_point3d);
-			return true;
-		} else if (last_point3d->Y + valid_step_y < new_point3d.Y
-				|| last_point3d->Y - valid_step_y > new_point3d.Y) {// Test Y
-			storeCoordinates(last_point3d, new_point3d);
-			return true;
-		} else if (last_point3d->Z + valid_step_z < new_point3d.Z
-				|| last_point3d->Z - valid_step_z > new_point3d.Z) {// Test Z
-			storeCoordinates(last_point3d, new_point3d);
-			return true;
-		} else
-			return false;
-	}
-}
-
-// Stores last coordinates
-void storeCoordinates(XnPoint3D *last_point3d, XnPoint3D new_point3d) {
-	if (last_point3d->X != new_point3d.X || last_point3d->Y != new_point3d.Y
-			|| last_point3d->Z != new_point3d.Z) {
-		last_point3d->X = new_point3d.X;
-		last_point3d->Y = new_point3d.Y;
-		last_point3d->Z = new_point3d.Z;
+void stopDevices() {
+	for (int i = 1; i < n_devices; i++) {
+		printf("\nDevice %d: %lu frames", i, devices[i]->getFrames());
+		delete devices[i];
+		devices[i] = NULL;
 	}
 }
 
-// Initializes variables to control repeated data of hands
-void initLastPoint3d() {
-	l_last_point3d.X = 0;
-	l_last_point3d.Y = 0;
-	l_last_point3d.Z = 0;
-	r_last_point3d.X = 0;
-	r_last_point3d.Y = 0;
-	r_last_point3d.Z = 0;
-}
-
-/*Format of data:
- * #header|data_id|player_id|hand_id,left,right|x,y,z,c_p1|gesture,g_p1,g_p2,g_p3#
- * Formats the data and send it
- */
-void formatData(char header[], int player_id, int hand_id, int l_hand,
-		int r_hand, float coordinates[3], float c_p1, char gesture[],
-		float g_p1, float g_p2, float g_p3) {
-	printf("\n#%s|%i|%i|%i,%i,%i|%.3f,%.3f,%.3f,%.3f|%s,%.2f,%.2f,%.2f#\n",
-			header, data_id, player_id, hand_id, l_hand, r_hand,
-			coordinates[0], coordinates[1], coordinates[2], c_p1, gesture,
-			g_p1, g_p2, g_p3);
-	if (_useSockets) {
-		char sensor_data[100];
-		int n = sprintf(sensor_data,
-				"#%s|%i|%i|%i,%i,%i|%.3f,%.3f,%.3f,%.3f|%s,%.2f,%.2f,%.2f#",
-				header, data_id, player_id, hand_id, l_hand, r_hand,
-				coordinates[0], coordinates[1], coordinates[2], c_p1, gesture,
-				g_p1, g_p2, g_p3);
-		try {
-			tcp_sock.send(sensor_data, n);
-		} catch (SocketException &e) {
-			cerr << e.what() << endl;
-			exit(1);
-		}
-	}
-	data_id++;
-	last_gesture = gesture;
+// Copies the RGB image of the current frame for the GUI thread
+void publishPreview() {
+	if (nite == NULL || !nite->getImage().IsValid())
+		return;
+	ImageMetaData imageMD;
+	nite->getImage().GetMetaData(imageMD);
+	PreviewFrame &frame = preview_frames.writeBuffer();
+	frame.x_res = imageMD.XRes();
+	frame.y_res = imageMD.YRes();
+	frame.x_offset = imageMD.XOffset();
+	frame.y_offset = imageMD.YOffset();
+	frame.full_x_res = imageMD.FullXRes();
+	frame.full_y_res = imageMD.FullYRes();
+	frame.pixels.resize(frame.x_res * frame.y_res);
+	if (!frame.pixels.empty())
+		xnOSMemCopy(&frame.pixels[0], imageMD.RGB24Data(), frame.pixels.size()
+				* sizeof(XnRGB24Pixel));
+	preview_frames.publish();
 }
 
 // Clean up
 void cleanUpExit() {
-	if (_inSession) {
-		removeListeners();
-	}
-	if (NULL != _sessionManager) {
-		if (_sessionRegistered)
-			unregisterSessionManager(hSessionManager);
-		delete _sessionManager;
-		_sessionManager = NULL;
-	}
-	delete _broadcaster;
-	delete _waveDetector;
-	delete _pushDetector;
-	delete _swipeDetector;
-	delete _steadyDetector;
-	delete _circleDetector;
-	delete g_pTexMap;
-
-	g_ImageGenerator.Release();
-	g_DepthGenerator.Release();
-	g_HandsGenerator.Release();
-	g_GestureGenerator.Release();
-	g_UserGenerator.Release();
-	g_Context.Release();
-	if (_useSockets) {
-		char exit_flag[2] = "0";
-		try {
-			tcp_sock.send(exit_flag, 2);
-		} catch (SocketException &e) {
-			cerr << e.what() << endl;
-			exit(1);
+	stopCapture(); // Nothing may produce messages from here on
+	stopDevices();
+	if (sensor != NULL) {
+		sensor->stop(); // Closes the recording
+		delete sensor;
+		sensor = NULL;
+		nite = NULL;
+	}
+	if (_useSockets && (shm_ring != NULL || fan_out != NULL)) {
+		Message exit_flag;
+		initMessage(exit_flag, MSG_CLIENT_EXIT);
+		exit_flag.data_id = core.dataId();
+		sendMessage(exit_flag);
+		flushFrame();
+		net_sender.stop(); // The subscribers take what they still have
+		net_sender.printStats();
+		if (fan_out != NULL) {
+			fan_out->stop();
+			fan_out->printStats();
+			delete fan_out;
+			fan_out = NULL;
 		}
-		tcp_sock.cleanUp();
-		tcp_sock.~Socket();
-	}
+		delete shm_frame_ring; // Removes the shared memory objects
+		delete shm_ring;
+		shm_frame_ring = NULL;
+		shm_ring = NULL;
+	} else if (_useSockets) {
+		net_sender.stop(); // Sends what is still queued
+		net_sender.printStats();
+		// The exit flag must arrive alone
+		Message exit_flag;
+		initMessage(exit_flag, MSG_CLIENT_EXIT);
+		exit_flag.data_id = core.dataId();
+		net_sender.sendAlone(exit_flag);
+		delete udp_sock;
+		udp_sock = NULL;
+		Socket::cleanUp();
+	}
+	printf("\nCapture: %lu depth frames, %lu wakeups, %lu skipped (no new"
+		" skeleton data)", n_depth_frames, n_wakeups, n_skipped_wakeups);
+	if (!_playbackFile.empty() || _syntheticUsers > 0) {
+		double seconds = ((playbackEnded() ? playback_end : monotonicMicros())
+				- playback_start) / 1000000.0;
+		printf("\nRun: %.2f s, %.1f depth frames/s", seconds, seconds > 0
+				? n_depth_frames / seconds : 0);
+	}
+	if (n_devices > 1)
+		printf("\nMerge: %lu coordinates dropped, %lu events deferred (queue "
+			"full)", merger.getDropped(), merger.getDeferred());
 	printf("\nFinished!\n");
 	exit(1);
 }
@@ -740,27 +546,49 @@ void cleanUpExit() {
 // GUI
 //-----------------------------------------------------------------------------
 
-void glutIdle(void) {
-	// Display the frame
-	glutPostRedisplay();
+// Redraws only when the capture thread has a new frame
+void glutTimer(int value) {
+	bool newFrame = preview_frames.update();
+	bool newSkeleton = preview_skeletons.update();
+	if (newFrame)
+		g_newPreviewFrame = true;
+	if (newFrame || newSkeleton)
+		glutPostRedisplay();
+	glutTimerFunc(PREVIEW_INTERVAL, glutTimer, 0);
+	if (playbackEnded())
+		cleanUpExit();
 }
 
-void glutDisplay(void) {
-	nRetVal = g_Context.WaitAnyUpdateAll();
-	if (nRetVal != XN_STATUS_OK) {
-		printf("Read failed: %s\n", xnGetStatusString(nRetVal));
+// Copies the image into the texture: through a pixel buffer object, the
+// transfer runs asynchronously (DMA) while the GUI goes on. One buffer is
+// enough: each frame orphans its storage, so the driver gives it new memory
+// instead of waiting for the transfer of the last frame, and the texture
+// shows the frame just copied instead of the one before.
+void uploadPreview(const PreviewFrame &frame) {
+	glBindTexture(GL_TEXTURE_2D, g_texture);
+	if (g_pixelBuffer == 0) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, frame.x_offset, frame.y_offset,
+				frame.x_res, frame.y_res, GL_RGB, GL_UNSIGNED_BYTE,
+				&frame.pixels[0]);
 		return;
 	}
-	if (_sessionInitialized) {
-		_sessionManager->Update(&g_Context);
-	}
-	// Extract hand position of tracked user
-	if (_featureHandsTracking && _inSession) {
-		if (g_UserGenerator.GetSkeletonCap().IsTracking(user_id)) {
-			handleHandPosition();
-		}
+	GLsizeiptr size = frame.pixels.size() * sizeof(XnRGB24Pixel);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_pixelBuffer);
+	// Orphans the storage of the last frame
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void *pixels = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	if (pixels != NULL) {
+		xnOSMemCopy(pixels, &frame.pixels[0], size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, frame.x_offset, frame.y_offset,
+				frame.x_res, frame.y_res, GL_RGB, GL_UNSIGNED_BYTE, 0);
 	}
-	g_ImageGenerator.GetMetaData(g_imageMD);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Shows the newest frame taken by glutTimer() (also on window exposure)
+void glutDisplay(void) {
+	const PreviewFrame &frame = preview_frames.readBuffer();
 
 	// Clear the OpenGL buffers
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -770,38 +598,26 @@ void glutDisplay(void) {
 	glLoadIdentity();
 	glOrtho(0, GL_WIN_SIZE_X, GL_WIN_SIZE_Y, 0, -1.0, 1.0);
 
-	xnOSMemSet(g_pTexMap, 0, g_nTexMapX*g_nTexMapY*sizeof(XnRGB24Pixel));
-
-	const XnRGB24Pixel* pImageRow = g_imageMD.RGB24Data();
-	XnRGB24Pixel* pTexRow = g_pTexMap + g_imageMD.YOffset() * g_nTexMapX;
-
-	for (XnUInt y = 0; y < g_imageMD.YRes(); ++y) {
-		const XnRGB24Pixel* pImage = pImageRow;
-		XnRGB24Pixel* pTex = pTexRow + g_imageMD.XOffset();
-
-		for (XnUInt x = 0; x < g_imageMD.XRes(); ++x, ++pImage, ++pTex) {
-			*pTex = *pImage;
-		}
-
-		pImageRow += g_imageMD.XRes();
-		pTexRow += g_nTexMapX;
+	if (frame.pixels.empty() || !__atomic_load_n(&preview_image,
+			__ATOMIC_ACQUIRE)) { // No image, only the skeleton
+		drawSkeleton(preview_skeletons.readBuffer());
+		glutSwapBuffers();
+		return;
 	}
 
-	// Create the OpenGL texture map
-	glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP_SGIS, GL_TRUE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-			GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, g_nTexMapX, g_nTexMapY, 0, GL_RGB,
-			GL_UNSIGNED_BYTE, g_pTexMap);
+	if (g_newPreviewFrame) {
+		uploadPreview(frame);
+		g_newPreviewFrame = false;
+	}
+	glBindTexture(GL_TEXTURE_2D, g_texture);
 
 	// Display the OpenGL texture map
 	glColor4f(1, 1, 1, 1);
 
 	glBegin(GL_QUADS);
 
-	int nXRes = g_imageMD.FullXRes();
-	int nYRes = g_imageMD.FullYRes();
+	int nXRes = frame.full_x_res;
+	int nYRes = frame.full_y_res;
 
 	// upper left
 	glTexCoord2f(0, 0);
@@ -819,26 +635,68 @@ void glutDisplay(void) {
 
 	glEnd();
 
+	drawSkeleton(preview_skeletons.readBuffer());
+
 	// Swap the OpenGL display buffers
 	glutSwapBuffers();
 }
 
+// Head and hands of the tracked users over the image (and the other joints
+// with --skeleton)
+void drawSkeleton(const SkeletonSnapshot &snapshot) {
+	if (snapshot.n_users == 0)
+		return;
+	glDisable(GL_TEXTURE_2D);
+	for (int u = 0; u < snapshot.n_users; u++) {
+		const UserSnapshot &user = snapshot.users[u];
+		if (user.full_skeleton) {
+			const SkeletonJoints &s = user.skeleton;
+			glPointSize(6);
+			glColor4f(0, 0.6f, 1, 1);
+			glBegin(GL_POINTS);
+			for (int i = 0; i < SKELETON_JOINTS; i++) {
+				if (s.confidence[i] > 0.5)
+					glVertex2f(s.x[i] * GL_WIN_SIZE_X / res_x, s.y[i]
+							* GL_WIN_SIZE_Y / res_y);
+			}
+			glEnd();
+		}
+		glPointSize(10);
+		glBegin(GL_POINTS);
+		for (int i = 0; i < SNAPSHOT_JOINTS; i++) {
+			const SnapshotJoint &j = user.joints[i];
+			if (j.confidence <= 0.5)
+				continue;
+			if (i == SNAPSHOT_HEAD)
+				glColor4f(1, 1, 0, 1);
+			else
+				glColor4f(0, 1, 0, 1);
+			glVertex2f(j.projective[0] * GL_WIN_SIZE_X / res_x,
+					j.projective[1] * GL_WIN_SIZE_Y / res_y);
+		}
+		glEnd();
+	}
+	glColor4f(1, 1, 1, 1);
+	glEnable(GL_TEXTURE_2D);
+}
+
 void glutKeyboard (unsigned char key, int x, int y)
 {
 	switch (key){
 		case 27:
 			cleanUpExit();
 			exit (1);
+		case 'p':
+			setPreviewImage(!__atomic_load_n(&preview_image, __ATOMIC_ACQUIRE));
+			glutPostRedisplay();
+			break;
 	}
 }
 
 void glInit (int * pargc, char ** argv){
-	g_ImageGenerator.GetMetaData(g_imageMD);
-
-	// Texture map init
-	g_nTexMapX = (((unsigned short) (g_imageMD.FullXRes() - 1) / 512) + 1)* 512;
-	g_nTexMapY = (((unsigned short) (g_imageMD.FullYRes() - 1) / 512) + 1)* 512;
-	g_pTexMap = (XnRGB24Pixel*) malloc(g_nTexMapX * g_nTexMapY * sizeof(XnRGB24Pixel));
+	// Texture map init, for the resolution requested in startImageGenerator()
+	g_nTexMapX = (((unsigned short) (res_x - 1) / 512) + 1)* 512;
+	g_nTexMapY = (((unsigned short) (res_y - 1) / 512) + 1)* 512;
 
 	glutInit(pargc, argv);
 	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
@@ -850,160 +708,248 @@ void glInit (int * pargc, char ** argv){
 
 	glutKeyboardFunc(glutKeyboard);
 	glutDisplayFunc(glutDisplay);
-	glutIdleFunc(glutIdle);
+	glutTimerFunc(PREVIEW_INTERVAL, glutTimer, 0);
+#ifdef GLUT_ACTION_ON_WINDOW_CLOSE
+	// freeglut: closing the window returns from glutMainLoop()
+	glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE,
+			GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+#endif
 
 	glDisable(GL_DEPTH_TEST);
 	glEnable(GL_TEXTURE_2D);
 
+	// The texture is allocated once, without mipmaps (the image is shown at
+	// its own size)
+	glGenTextures(1, &g_texture);
+	glBindTexture(GL_TEXTURE_2D, g_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Black around a cropped image
+	std::vector<XnRGB24Pixel> black(g_nTexMapX * g_nTexMapY);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, g_nTexMapX, g_nTexMapY, 0, GL_RGB,
+			GL_UNSIGNED_BYTE, &black[0]);
+
+	const char *extensions = (const char*) glGetString(GL_EXTENSIONS);
+	if (extensions != NULL && strstr(extensions, "GL_ARB_pixel_buffer_object"))
+		glGenBuffers(1, &g_pixelBuffer);
+	else
+		printf("\nNo pixel buffer objects, the preview is uploaded directly");
 }
 
 //-----------------------------------------------------------------------------
 // Init Method
 //-----------------------------------------------------------------------------
 
-int main(int argc, char* argv[]) {
-	//moveKinectMotor(10); // Needs to run with root privileges
+// Fusion mode: no sensor here, the skeletons that other instances send are
+// fused and the result goes to Blender
+int runFusion() {
+	SkeletonFusion fusion;
+	if (!_calibrationFile.empty() && !fusion.loadCalibration(
+			_calibrationFile.c_str()))
+		return 1;
+	FusionNode node(&fusion, &net_sender);
+	if (!node.start(_fusionPort))
+		return 1;
+	printf("\nPress a key to exit");
+	while (!xnOSWasKeyboardHit())
+		xnOSSleep(100);
+	node.stop(); // The sender has no other producer from here on
+	node.printStats();
+	cleanUpExit();
+	return 0;
+}
 
-	if (_useSockets)
-		initSocket("localhost", 2001);
-
-	// Context Init
-	nRetVal = g_Context.Init();
-	CHECK_RC(nRetVal, "Initialize context");
-	g_Context.SetGlobalMirror(_mirror);
-
-	// Create the depth generator
-	nRetVal = g_DepthGenerator.Create(g_Context);
-	CHECK_RC(nRetVal, "Create depth generator");
-
-	// Set it to VGA maps at 30 FPS (Depth image)
-	_outputModeDepth.nXRes = res_x;
-	_outputModeDepth.nYRes = res_y;
-	_outputModeDepth.nFPS = 30;
-	nRetVal = g_DepthGenerator.SetMapOutputMode(_outputModeDepth);
-	CHECK_RC(nRetVal, "Set map output mode for depth generator");
-
-	// Create the image generator and set output map (Image only)
-	nRetVal = g_ImageGenerator.Create(g_Context);
-	CHECK_RC(nRetVal, "Create image generator");
-	_outputModeImage.nXRes = res_x;
-	_outputModeImage.nYRes = res_y;
-	_outputModeImage.nFPS = 30;
-	nRetVal = g_ImageGenerator.SetMapOutputMode(_outputModeImage);
-	CHECK_RC(nRetVal, "Set map output mode for image generator");
-
-	// Create the hands generator
-	nRetVal = g_HandsGenerator.Create(g_Context);
-	CHECK_RC(nRetVal, "Create hands generator");
-	// Smoothing hand movements
-	g_HandsGenerator.SetSmoothing(KINECT_SMOOTHING_HANDS);
-	initLastPoint3d();
-
-	// Create the gesture generator
-	nRetVal = g_GestureGenerator.Create(g_Context);
-	CHECK_RC(nRetVal, "Create gesture generator");
-
-	// Create user generator.
-	nRetVal = g_UserGenerator.Create(g_Context);
-	CHECK_RC(nRetVal, "Create user generator");
-
-	//---------------------------------------------------------------//
-	//------------------------- SETUP FEATURES ---------------------//
-	//--------------------------------------------------------------//
-
-	// Feature Gesture.
-	if (_featureGesture) {
-		// Wave detector.
-		_waveDetector = new XnVWaveDetector();//TODO: Check both ways this gesture
-		//_waveDetector->SetMinLength(25); // The length (in mm) of the motion before a direction change (a flip)
-		/*printf(
-		 "\nWave Detector Config - Flip Count:%d, Min Length:%d, Max Deviation:%d",
-		 _waveDetector->GetFlipCount(), _waveDetector->GetMinLength(),
-		 _waveDetector->GetMaxDeviation());*/
-		_waveDetector->RegisterWave(NULL, &OnWave);
-
-		// Push detector.
-		_pushDetector = new XnVPushDetector();
-		_pushDetector->SetPushImmediateDuration(400); // Change the time used to detect push (ms)
-		_pushDetector->SetPushImmediateMinimumVelocity(0.35f); // To test
-		_pushDetector->RegisterPush(NULL, &OnPush);
-		//_pushDetector->RegisterStabilized(NULL, &StabilizedPush);
-
-		// Swipe detector.
-		_swipeDetector = new XnVSwipeDetector();
-		_swipeDetector->SetMotionTime(700); // Minimal duration to recognize as swipe (ms)
-		_swipeDetector->SetMotionSpeedThreshold(0.55f); // Minimal speed to recognize as a swipe (m/s)
-		_swipeDetector->RegisterSwipeUp(NULL, &SwipeUp);
-		_swipeDetector->RegisterSwipeDown(NULL, &SwipeDown);
-		_swipeDetector->RegisterSwipeLeft(NULL, &SwipeLeft);
-		_swipeDetector->RegisterSwipeRight(NULL, &SwipeRight);
-
-		// Steady detector.
-		_steadyDetector = new XnVSteadyDetector();
-		_steadyDetector->SetDetectionDuration(800); // The time it takes to detect steady state (ms) - The previus value was 1000up
-		_steadyDetector->RegisterSteady(NULL, &OnSteady);
-		//_steadyDetector->RegisterNotSteady(NULL, &NotSteady);
+// Replay mode: sends a recorded stream again at the pace it was captured, as
+// if its sensor were here (device ids moved by --device-id), e.g. to feed a
+// fusion node without sensors
+int runReplay() {
+	StreamReplay replay;
+	if (!replay.open(_replayFile.c_str()))
+		return 1;
+	printf("\nReplaying %s, press a key to stop", _replayFile.c_str());
+	uint64_t start = monotonicMicros();
+	uint64_t first = 0;
+	uint64_t frame = 0;
+	unsigned long n = 0;
+	Message m;
+	while (replay.next(m) && !xnOSWasKeyboardHit()) {
+		if (m.type == MSG_PING || m.type == MSG_PONG || m.type == MSG_RESUME
+				|| m.type == MSG_CLIENT_EXIT)
+			continue; // Of the recorded connection
+		m.device_id += _deviceId;
+		if (m.device_id >= MAX_DEVICES)
+			continue;
+		if (m.capture_time != 0) {
+			if (first == 0)
+				first = m.capture_time;
+			uint64_t at = start + (m.capture_time > first ? m.capture_time
+					- first : 0);
+			if (m.capture_time != frame) {
+				// A new frame: the last one goes out first, this one on time
+				flushFrame();
+				frame = m.capture_time;
+				uint64_t now = monotonicMicros();
+				if (at > now)
+					xnOSSleep((XnUInt32) ((at - now) / 1000));
+			}
+			m.capture_time = at;
+		}
+		m.data_id = core.nextDataId();
+		m.send_time = 0;
+		sendMessage(m);
+		n++;
 	}
+	flushFrame();
+	printf("\nReplay: %lu messages sent", n);
+	cleanUpExit();
+	return 0;
+}
 
-	// Feature Circle.
-	if (_featureCircle) {
-		// Circle detector.
-		_circleDetector = new XnVCircleDetector();
-		_circleDetector->SetMinimumPoints(16); // Minimum number of points to consider a circle
-		_circleDetector->RegisterCircle(NULL, &CircleCB);
-		_circleDetector->RegisterNoCircle(NULL, &NoCircleCB);
+// Reads the startup options (unknown options are left to GLUT)
+void parseArguments(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--binary") == 0)
+			_wireFormat = WIRE_FORMAT_BINARY;
+		else if (strcmp(argv[i], "--compact") == 0)
+			_wireFormat = WIRE_FORMAT_COMPACT;
+		else if (strcmp(argv[i], "--text") == 0)
+			_wireFormat = WIRE_FORMAT_TEXT;
+		else if (strcmp(argv[i], "--no-batch") == 0)
+			_batchFrames = false;
+		else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc)
+			_serverAddress = argv[++i];
+		else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+			_serverPort = (unsigned short) atoi(argv[++i]);
+		else if (strcmp(argv[i], "--udp") == 0)
+			_udpCoordinates = true;
+		else if (strcmp(argv[i], "--udp-port") == 0 && i + 1 < argc)
+			_udpPort = (unsigned short) atoi(argv[++i]);
+		else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+			_shmName = argv[++i];
+		else if (strcmp(argv[i], "--shm-frames") == 0)
+			_shmFrames = true;
+		else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc)
+			_listenPort = (unsigned short) atoi(argv[++i]);
+		else if (strcmp(argv[i], "--multicast") == 0 && i + 1 < argc) {
+			_udpCoordinates = true;
+			_multicastGroup = argv[++i];
+		} else if (strcmp(argv[i], "--skeleton") == 0)
+			_fullSkeleton = true;
+		else if (strcmp(argv[i], "--all-devices") == 0)
+			_allDevices = true;
+		else if (strcmp(argv[i], "--device-id") == 0 && i + 1 < argc)
+			_deviceId = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--fusion") == 0 && i + 1 < argc)
+			_fusionPort = (unsigned short) atoi(argv[++i]);
+		else if (strcmp(argv[i], "--calibration") == 0 && i + 1 < argc)
+			_calibrationFile = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			_replayFile = argv[++i];
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			_recordFile = argv[++i];
+		else if (strcmp(argv[i], "--playback") == 0 && i + 1 < argc)
+			_playbackFile = argv[++i];
+		else if (strcmp(argv[i], "--playback-speed") == 0 && i + 1 < argc)
+			_playbackSpeed = atof(argv[++i]);
+		else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+			_syntheticUsers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--synthetic-rate") == 0 && i + 1 < argc)
+			_syntheticRate = atof(argv[++i]);
+		else if (strcmp(argv[i], "--synthetic-frames") == 0 && i + 1 < argc)
+			_syntheticFrames = strtoul(argv[++i], NULL, 10);
+	}
+	if (_playbackSpeed < 0) {
+		printf("\n--playback-speed can't be negative, using 1");
+		_playbackSpeed = 1.0;
+	}
+	if (_syntheticRate < 0) {
+		printf("\n--synthetic-rate can't be negative, using 30");
+		_syntheticRate = 30;
+	}
+	if (_syntheticUsers > 0 && (!_playbackFile.empty() || !_recordFile.empty()
+			|| _allDevices)) {
+		// There is no sensor to read or record
+		printf("\n--playback, --record and --all-devices are ignored with"
+			" --synthetic");
+		_playbackFile = "";
+		_recordFile = "";
+		_allDevices = false;
+	}
+	if (!_playbackFile.empty() && !_recordFile.empty()) {
+		printf("\n--record is ignored with --playback");
+		_recordFile = "";
+	}
+	if (!_playbackFile.empty() && _allDevices) {
+		// A recording has a single sensor
+		printf("\n--all-devices is ignored with --playback");
+		_allDevices = false;
+	}
+	if (_deviceId < 0 || _deviceId >= MAX_DEVICES) {
+		printf("\n--device-id must be 0 to %d, using 0", MAX_DEVICES - 1);
+		_deviceId = 0;
+	}
+	if (_allDevices && !_fullSkeleton) {
+		// The other sensors only send skeletons
+		printf("\n--all-devices sends full skeletons, using --skeleton");
+		_fullSkeleton = true;
+	}
+	if (_fullSkeleton && _wireFormat == WIRE_FORMAT_TEXT) {
+		printf("\n--skeleton needs the binary format, using --binary");
+		_wireFormat = WIRE_FORMAT_BINARY;
+	}
+	if ((_fusionPort != 0 || !_replayFile.empty()) && _wireFormat
+			== WIRE_FORMAT_TEXT) {
+		printf("\nSkeletons need the binary format, using --binary");
+		_wireFormat = WIRE_FORMAT_BINARY;
 	}
+}
 
-	// Feature User Tracking.
-	if (_featureUserTracking) {
-		// Setup user generator callbacks.
-		XnCallbackHandle hUserCallbacks, hCalibrationStart,
-				hCalibrationComplete, hPoseDetected;
-		if (!g_UserGenerator.IsCapabilitySupported(XN_CAPABILITY_SKELETON)) {
-			printf("\nSupplied user generator doesn't support skeleton");
-			return 1;
-		}
-		nRetVal = g_UserGenerator.RegisterUserCallbacks(NewUser, LostUser,
-				NULL, hUserCallbacks);
-		CHECK_RC(nRetVal, "Register to user callbacks");
-		nRetVal = g_UserGenerator.RegisterToUserExit(UserExit, NULL,
-				hUserCallbacks);
-		CHECK_RC(nRetVal, "Register to user exit callback");
-		nRetVal = g_UserGenerator.RegisterToUserReEnter(UserReEnter, NULL,
-				hUserCallbacks);
-		CHECK_RC(nRetVal, "Register to user re-enters callback");
-
-		// Setup Skeleton detection.
-		nRetVal = g_UserGenerator.GetSkeletonCap().RegisterToCalibrationStart(
-				UserCalibrationStart, NULL, hCalibrationStart);
-		CHECK_RC(nRetVal, "Register to calibration start");
-		nRetVal = g_UserGenerator.GetSkeletonCap().RegisterToCalibrationComplete(
-						UserCalibrationComplete, NULL, hCalibrationComplete);
-		CHECK_RC(nRetVal, "Register to calibration complete");
-
-		if (g_UserGenerator.GetSkeletonCap().NeedPoseForCalibration()) {
-			printf("\nPose required!");
-			_needPose = true;
-			if (!g_UserGenerator.IsCapabilitySupported(
-					XN_CAPABILITY_POSE_DETECTION)) {
-				printf("\nPose required, but not supported.");
-				return 1;
-			}
-			g_UserGenerator.GetPoseDetectionCap().RegisterToPoseDetected(
-					UserPoseDetected, NULL, hPoseDetected);
-			g_UserGenerator.GetSkeletonCap().GetCalibrationPose(_strPose);
-		}
-		g_UserGenerator.GetSkeletonCap().SetSkeletonProfile(
-				XN_SKEL_PROFILE_HEAD_HANDS);
-		g_UserGenerator.GetSkeletonCap().SetSmoothing(KINECT_SMOOTHING_SKELETON);
+int main(int argc, char* argv[]) {
+	//moveKinectMotor(10); // Needs to run with root privileges
+
+	parseArguments(argc, argv);
+
+	if (_useSockets) {
+		if (!_shmName.empty())
+			initSharedMemory(_shmName);
+		else if (_listenPort != 0)
+			initFanOut(_listenPort);
+		else
+			initSocket(_serverAddress, _serverPort);
 	}
 
-	// Create the broadcaster manager.
-	_broadcaster = new XnVBroadcaster();
+	// Modes without a sensor
+	if (_fusionPort != 0)
+		return runFusion();
+	if (!_replayFile.empty())
+		return runReplay();
+
+	// The sensor (or its recording), or the made up users
+	if (_syntheticUsers > 0) {
+		sensor = new SyntheticBackend(_syntheticUsers, _syntheticRate,
+				_syntheticFrames);
+	} else {
+		nite = new NiteBackend(_mirror, _fullSkeleton);
+		nite->setGestures(_featureGesture, _featureCircle);
+		if (!_recordFile.empty())
+			nite->setRecording(_recordFile);
+		if (!_playbackFile.empty())
+			nite->setPlayback(_playbackFile, _playbackSpeed);
+		sensor = nite;
+	}
+	if (!sensor->start(&core))
+		return 1;
+	core.setSensor(sensor);
+	if (_useSockets)
+		core.setSender(sendMessage);
+	core.setDeviceId(_deviceId);
+	core.setFullSkeleton(_fullSkeleton);
+	core.setHandsTracking(_featureHandsTracking);
 
-	// Start generating all
-	nRetVal = g_Context.StartGeneratingAll();
-	CHECK_RC(nRetVal, "Start Generating All");
+	if (_allDevices)
+		startDevices();
+	playback_start = monotonicMicros();
 
 	// Set the frame rate.
 	//nRetVal = xnFPSInit(&_xnFPS, 180);// TODO: Verify this functionality and turn on then
@@ -1016,22 +962,26 @@ int main(int argc, char* argv[]) {
 	//-----------------------------------------------------------//
 #if (USE_GUI_GLUT == 1)
 	glInit(&argc, argv);
-	// Per frame code is in glutDisplay
+	// The frames are processed on the capture thread, the window only shows
+	// the newest one
+	setPreviewImage(true);
+	if (!startCapture())
+		return 1;
 	glutMainLoop();
+	// Window closed (freeglut): the tracking goes on without the RGB stream
+	setPreviewImage(false);
+	printf("\nPreview closed, press a key to exit");
+	while (!xnOSWasKeyboardHit() && !playbackEnded())
+		xnOSSleep(100);
+	cleanUpExit();
 #else
 	while (!xnOSWasKeyboardHit()) {
 		// Update to next frame
-		nRetVal = g_Context.WaitAnyUpdateAll();
-		CHECK_RC(nRetVal, "Update data");
-		if (_sessionInitialized) {
-			_sessionManager->Update(&g_Context);
-		}
-		// Extract hand position of tracked user
-		if (_featureHandsTracking && _inSession) {
-			if (g_UserGenerator.GetSkeletonCap().IsTracking(user_id)) {
-				handleHandPosition();
-			}
-		}
+		bool ok = updateFrame();
+		if (checkPlaybackEnd())
+			break;
+		if (!ok)
+			return 1;
 	}
 
 	cleanUpExit();
@@ -0,0 +1,151 @@
+/*
+ * LoadTest.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+/*Load test of the sending path without OpenNI: TrackingCore on
+ * SyntheticBackend (as fast as it can make frames) hands its messages to a
+ * NetSender, which sends them over TCP to a server on this machine that only
+ * reads them. Usage:
+ *   load_test [users [frames [text|binary|compact]]]
+ * (default 14 users, 3000 frames, binary). The report goes to stderr, the
+ * core prints every event to stdout. Returns 0 if the server received
+ * anything: coalesced and lost coordinates are how the sender copes with the
+ * load, not failures.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <iostream>
+#include "TrackingCore.h"
+#include "SyntheticBackend.h"
+#include "NetSender.h"
+
+static unsigned short server_port;
+static unsigned long n_received = 0; // Bytes, set by the reader thread
+
+// Connector of the sender (see NetSender::setConnector())
+static CommunicatingSocket* connectServer() {
+	TCPSocket *sock = new TCPSocket();
+	try {
+		sock->setNoDelay(true); // A publish() per frame, like --batch
+		sock->startConnect("127.0.0.1", server_port);
+	} catch (SocketException &e) {
+		delete sock;
+		throw;
+	}
+	return sock;
+}
+
+// Reads what the sender writes until it closes the connection
+static void* readAll(void *arg) {
+	TCPServerSocket *server = (TCPServerSocket*) arg;
+	try {
+		TCPSocket *sock = server->accept();
+		char buffer[64 * 1024];
+		int n;
+		while ((n = sock->recv(buffer, sizeof(buffer))) > 0)
+			n_received += n;
+		delete sock;
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+	}
+	return NULL;
+}
+
+static void enqueue(const Message &m, void *cookie) {
+	((NetSender*) cookie)->enqueue(m);
+}
+
+int main(int argc, char *argv[]) {
+	int users = argc > 1 ? atoi(argv[1]) : 14;
+	unsigned long frames = argc > 2 ? strtoul(argv[2], NULL, 10) : 3000;
+	WireFormat format = WIRE_FORMAT_BINARY;
+	if (argc > 3 && strcmp(argv[3], "text") == 0)
+		format = WIRE_FORMAT_TEXT;
+	else if (argc > 3 && strcmp(argv[3], "compact") == 0)
+		format = WIRE_FORMAT_COMPACT;
+	if (users < 1 || frames == 0) {
+		fprintf(stderr, "usage: load_test [users [frames [text|binary|"
+			"compact]]]\n");
+		return 1;
+	}
+
+	TCPServerSocket *server;
+	try {
+		server = new TCPServerSocket("127.0.0.1", 0);
+		server_port = server->getLocalPort();
+	} catch (SocketException &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	pthread_t reader;
+	if (pthread_create(&reader, NULL, readAll, server) != 0)
+		return 1;
+
+	NetSender *sender = new NetSender();
+	sender->setConnector(connectServer);
+	if (!sender->start(NULL, format))
+		return 1;
+	// The sender thread connects, and then holds coordinates until the
+	// MSG_RESUME this server never sends: the frames are timed from there
+	for (int i = 0; sender->failed(); i++) {
+		if (i == 500) {
+			fprintf(stderr, "FAILED: the sender didn't connect\n");
+			return 1;
+		}
+		usleep(10000);
+	}
+	usleep((RESUME_TIMEOUT + 100) * 1000);
+
+	SyntheticBackend sensor(users, 0, frames);
+	TrackingCore core;
+	if (!sensor.start(&core))
+		return 1;
+	core.setSensor(&sensor);
+	core.setSender(enqueue, sender);
+	core.setFullSkeleton(true);
+	core.setHandsTracking(true);
+	SkeletonSnapshot snapshot;
+	SensorUpdate u;
+	uint64_t start = monotonicMicros();
+	while (sensor.update(u)) {
+		if (u.new_depth)
+			core.stampFrame();
+		if (u.new_user)
+			core.processFrame(snapshot);
+		sender->publish(); // One batch per frame
+	}
+	uint64_t produced = monotonicMicros();
+	sender->stop(); // Until the server took everything
+	uint64_t end = monotonicMicros();
+	sensor.stop();
+	sender->printStats();
+	printf("\n");
+	unsigned long sent = sender->sent();
+	unsigned long coalesced = sender->coalesced();
+	unsigned long lost = sender->lost();
+	delete sender; // Closes the connection, the reader ends
+
+	pthread_join(reader, NULL);
+	delete server;
+
+	double seconds = (end - start) / 1000000.0;
+	unsigned long messages = core.dataId() - 1;
+	fprintf(stderr, "%d users, %lu frames in %.3f s (made in %.3f s): %.0f "
+		"frames/s, %lu messages (%.0f/s), %lu sent, %lu coalesced, %lu lost "
+		"(backlog), %lu bytes received (%.1f MB/s)\n", users, frames, seconds,
+			(produced - start) / 1000000.0, frames / seconds, messages,
+			messages / seconds, sent, coalesced, lost, n_received, n_received
+					/ seconds / 1000000);
+	if (n_received == 0) {
+		fprintf(stderr, "FAILED: nothing received\n");
+		return 1;
+	}
+	return 0;
+}
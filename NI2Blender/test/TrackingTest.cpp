@@ -0,0 +1,287 @@
+/*
+ * TrackingTest.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: fabio
+ */
+
+/*Runs TrackingCore on SyntheticBackend, without OpenNI, and checks what it
+ * sends against the synthetic script (see SyntheticBackend.h):
+ * - the events: both users calibrate, the session starts, and the first
+ *   user's circles, swipes and steady hold are reported in order, on time;
+ * - the hand coordinates: each one is where the script puts that hand in
+ *   the frame it comes from, projected like a Kinect depth map;
+ * - the skeletons: encoded with MessageEncoder (only the changed joints) and
+ *   decoded with MessageDecoder, every joint is back within the step that
+ *   lets the encoder leave it out, and after a lost skeleton the deltas are
+ *   ignored until the next keyframe.
+ * The report goes to stderr, the core prints every message to stdout.
+ * Returns 0 if every check passed.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <vector>
+#include "TrackingCore.h"
+#include "SyntheticBackend.h"
+
+#define USERS 2
+#define FRAMES 300 // 10 s
+#define FRAME_TIME (1.0 / SYNTHETIC_VIRTUAL_RATE)
+
+// Largest distance of a hand from the script (pixels, mm)
+#define HAND_TOLERANCE 0.05f
+
+static int failures = 0;
+
+// Reports a failure, format as printf
+static void check(bool ok, const char *format, ...) {
+	if (ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "FAILED: ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+	failures++;
+}
+
+static void collect(const Message &m, void *cookie) {
+	((std::vector<Message>*) cookie)->push_back(m);
+}
+
+static double secondsOf(const Message &m) {
+	return m.sensor_time / 1000000.0;
+}
+
+//-----------------------------------------------------------------------------
+// Events
+//-----------------------------------------------------------------------------
+
+struct ExpectedEvent {
+	MessageType type;
+	GestureType gesture;
+	int player;
+	double time; // s
+};
+
+// Calibrations 0.25 s apart from 0.5 s, the session a second after the
+// first one; its user's script starts when it calibrated (0.5 s)
+static const ExpectedEvent expected_events[] = {
+		{ MSG_NEW_USER_CALIBRATED, GESTURE_NONE, 1, 0.5 },
+		{ MSG_NEW_USER_CALIBRATED, GESTURE_NONE, 2, 0.75 },
+		{ MSG_SESSION_STARTED, GESTURE_NONE, 1, 1.5 },
+		{ MSG_GESTURE, GESTURE_CIRCLE, 1, 2.5 },
+		{ MSG_GESTURE, GESTURE_CIRCLE, 1, 4.5 },
+		{ MSG_GESTURE, GESTURE_SWIPE_LEFT, 1, 5.2 },
+		{ MSG_GESTURE, GESTURE_SWIPE_RIGHT, 1, 6.2 },
+		{ MSG_GESTURE, GESTURE_ON_STEADY, 1, 7.3 } };
+
+static void checkEvents(const std::vector<Message> &messages) {
+	int n = sizeof(expected_events) / sizeof(expected_events[0]);
+	int k = 0;
+	for (size_t i = 0; i < messages.size(); i++) {
+		const Message &m = messages[i];
+		if (!isReliableMessage(m.type))
+			continue;
+		if (k == n) {
+			check(false, "unexpected %s at %.3f s", messageTypeName(m.type),
+					secondsOf(m));
+			continue;
+		}
+		const ExpectedEvent &e = expected_events[k++];
+		check(m.type == e.type && m.gesture == e.gesture,
+				"event %d is %s (gesture %d), expected %s (gesture %d)", k,
+				messageTypeName(m.type), m.gesture, messageTypeName(e.type),
+				e.gesture);
+		check(m.player_id == e.player, "event %d has player %d, expected %d",
+				k, m.player_id, e.player);
+		check(fabs(secondsOf(m) - e.time) <= FRAME_TIME,
+				"event %d at %.3f s, expected %.3f s", k, secondsOf(m), e.time);
+	}
+	check(k == n, "%d events, expected %d", k, n);
+}
+
+//-----------------------------------------------------------------------------
+// Hand coordinates
+//-----------------------------------------------------------------------------
+
+// Where the script puts a hand of user i (0 based) at t, real world (mm),
+// written from the description in SyntheticBackend.h
+static void scriptHand(int i, double t, bool right, float p[3]) {
+	const double pi = 3.14159265358979323846;
+	float x = (i - (USERS - 1) / 2.0f) * 500 + 20 * (float) sin(2 * pi
+			* (t + i) / 4);
+	float z = 2200;
+	if (!right) {
+		p[0] = x - 240;
+		p[1] = -250;
+		p[2] = z;
+		return;
+	}
+	double s = fmod(t - (0.5 + i * 0.25) + i * 1.3 + 80, 8);
+	float hx, hy;
+	if (s < 4) { // Circles
+		hx = 200 * (float) cos(pi * s);
+		hy = 200 * (float) sin(pi * s);
+	} else if (s < 6) { // Swipes
+		bool left = s < 5;
+		double f = (s - (left ? 4 : 5)) / 0.7;
+		f = f > 1 ? 1 : f * f * (3 - 2 * f);
+		hx = left ? 200 - 500 * (float) f : -300 + 500 * (float) f;
+		hy = 0;
+	} else { // Steady
+		hx = 200;
+		hy = 0;
+	}
+	p[0] = x + 180 + 60 + hx;
+	p[1] = 230 - 150 + hy;
+	p[2] = z - 350;
+}
+
+static void project(const float p[3], float out[3]) {
+	double coeffX = 640 / (2 * tan(SYNTHETIC_HFOV / 2));
+	double coeffY = 480 / (2 * tan(SYNTHETIC_VFOV / 2));
+	out[0] = (float) (320 + coeffX * p[0] / p[2]);
+	out[1] = (float) (240 - coeffY * p[1] / p[2]);
+	out[2] = p[2];
+}
+
+static void checkHands(const std::vector<Message> &messages) {
+	int n[2] = { 0, 0 };
+	for (size_t i = 0; i < messages.size(); i++) {
+		const Message &m = messages[i];
+		if (m.type != MSG_HAND_COORDINATES)
+			continue;
+		bool right = m.r_hand == 1;
+		check(m.l_hand == (right ? 0 : 1), "hand message %d is neither hand",
+				m.data_id);
+		check(m.player_id >= 1 && m.player_id <= USERS,
+				"hand message %d has player %d", m.data_id, m.player_id);
+		if (m.player_id < 1 || m.player_id > USERS)
+			continue;
+		float real[3], expected[3];
+		scriptHand(m.player_id - 1, secondsOf(m), right, real);
+		project(real, expected);
+		for (int k = 0; k < 3; k++)
+			check(fabs(m.coordinates[k] - expected[k]) <= HAND_TOLERANCE
+					* (k == 2 ? 1 : expected[2] / 1000),
+					"%s hand of player %d at %.3f s: %c is %.3f, expected %.3f",
+					right ? "right" : "left", m.player_id, secondsOf(m),
+					"xyz"[k], m.coordinates[k], expected[k]);
+		n[right]++;
+	}
+	// The right hands move all the time, the left ones only sway
+	check(n[1] > 100, "%d right hand coordinates", n[1]);
+	check(n[0] > 0, "no left hand coordinates");
+}
+
+//-----------------------------------------------------------------------------
+// Skeleton deltas
+//-----------------------------------------------------------------------------
+
+// Every joint of decoded is where original is, or within the steps of
+// changedJoints() for the ones left out
+static bool sameSkeleton(const SkeletonJoints &decoded,
+		const SkeletonJoints &original) {
+	for (int i = 0; i < SKELETON_JOINTS; i++) {
+		if (fabs(decoded.x[i] - original.x[i]) > SKELETON_STEP_X
+				|| fabs(decoded.y[i] - original.y[i]) > SKELETON_STEP_Y
+				|| fabs(decoded.z[i] - original.z[i]) > SKELETON_STEP_Z
+				|| decoded.confidence[i] != original.confidence[i]
+				|| fabs(decoded.qw[i] - original.qw[i])
+						> SKELETON_STEP_ROTATION)
+			return false;
+	}
+	return true;
+}
+
+// lost: the skeletons of player 1 sent before the one that doesn't arrive
+// (-1 = none)
+static void checkSkeletons(const std::vector<Message> &messages,
+		WireFormat format, int lost) {
+	MessageEncoder encoder(format);
+	MessageDecoder decoder;
+	int skeletons = 0, deltas = 0, ignored = 0, sent = 0;
+	bool waiting = false; // For the keyframe after the lost one
+	for (size_t i = 0; i < messages.size(); i++) {
+		const Message &m = messages[i];
+		if (m.type != MSG_SKELETON)
+			continue;
+		char buffer[MAX_MESSAGE_SIZE];
+		int n = encoder.encode(m, buffer, sizeof(buffer));
+		check(n >= 0, "skeleton %d can't be encoded", m.data_id);
+		if (n <= 0)
+			continue; // No joint changed enough
+		skeletons++;
+		if (m.player_id == 1 && sent++ == lost) {
+			waiting = true;
+			continue;
+		}
+		Message d;
+		int used = decoder.decode(buffer, n, d);
+		check(used == n, "skeleton %d: %d of %d bytes decoded", m.data_id,
+				used, n);
+		if (waiting && m.player_id == 1) {
+			if (d.type == MSG_NONE) {
+				ignored++;
+				continue;
+			}
+			check(d.keyframe, "delta %d applied after a lost skeleton",
+					m.data_id);
+			waiting = false;
+		}
+		check(d.type == MSG_SKELETON, "skeleton %d decoded as %s", m.data_id,
+				messageTypeName(d.type));
+		if (d.type != MSG_SKELETON)
+			continue;
+		if (!d.keyframe)
+			deltas++;
+		check(d.joint_mask == SKELETON_ALL_JOINTS || !d.keyframe,
+				"keyframe %d without every joint", m.data_id);
+		check(sameSkeleton(d.skeleton, m.skeleton),
+				"skeleton %d of player %d decoded wrong", m.data_id, m.player_id);
+	}
+	check(deltas > skeletons / 2, "%d deltas of %d skeletons", deltas,
+			skeletons);
+	if (lost >= 0)
+		check(ignored > 0 && !waiting,
+				"lost skeleton: %d ignored, keyframe %s", ignored,
+				waiting ? "never came" : "came");
+}
+
+int main() {
+	std::vector<Message> messages;
+	SyntheticBackend sensor(USERS, 0, FRAMES);
+	TrackingCore core;
+	if (!sensor.start(&core))
+		return 1;
+	core.setSensor(&sensor);
+	core.setSender(collect, &messages);
+	core.setFullSkeleton(true);
+	core.setHandsTracking(true);
+	SkeletonSnapshot snapshot;
+	SensorUpdate u;
+	while (sensor.update(u)) {
+		if (u.new_depth)
+			core.stampFrame();
+		if (u.new_user)
+			core.processFrame(snapshot);
+	}
+	sensor.stop();
+
+	checkEvents(messages);
+	checkHands(messages);
+
+	checkSkeletons(messages, WIRE_FORMAT_BINARY, -1);
+	checkSkeletons(messages, WIRE_FORMAT_COMPACT, -1);
+	// A delta of player 1 between two keyframes gets lost
+	checkSkeletons(messages, WIRE_FORMAT_BINARY, SKELETON_KEYFRAME_INTERVAL
+			/ 2);
+
+	fprintf(stderr, "%lu messages, %d failures\n",
+			(unsigned long) messages.size(), failures);
+	return failures == 0 ? 0 : 1;
+}
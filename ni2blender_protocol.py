@@ -0,0 +1,352 @@
+# ni2blender_protocol.py
+#
+#  Created on: Oct 17, 2026
+#      Author: fabio
+#
+# Decoder of the messages sent by ni2blender, for the Blender scripts: the
+# binary (--binary) and compact (--compact) formats of NI2Blender/src/Protocol.h
+# and the old "#header|data_id|...#" text records. Only the struct module is
+# needed, so it runs inside Blender (load it as a text block with this name, or
+# put this directory in sys.path) or anywhere else.
+#
+#   decoder = Decoder()            # one for each connection (or UDP socket)
+#   for m in decoder.feed(data):   # data: bytes just read from the socket
+#       if m.type == MSG_HAND_COORDINATES:
+#           x, y, z = m.coordinates
+#
+# feed() keeps an incomplete message until the rest arrives. A compact delta
+# or a skeleton received after a lost one is dropped until the next keyframe
+# of its stream, like MessageDecoder in Protocol.cpp.
+
+import struct
+
+PROTOCOL_MAGIC = 0x424E
+PROTOCOL_VERSION = 3
+
+MSG_NONE = 0
+MSG_SESSION_STARTED = 1
+MSG_SESSION_ENDED = 2
+MSG_NEW_USER_CALIBRATED = 3
+MSG_CALIBRATED_USER_LOST = 4
+MSG_CALIBRATED_USER_EXIT = 5
+MSG_GESTURE = 6
+MSG_HAND_COORDINATES = 7
+MSG_HEAD_COORDINATES = 8
+MSG_CLIENT_EXIT = 9
+MSG_RESUME = 10
+MSG_PING = 11
+MSG_PONG = 12
+MSG_SKELETON = 13
+
+MESSAGE_NAMES = ("none", "session_started", "session_ended",
+                 "new_user_calibrated", "calibrated_user_lost",
+                 "calibrated_user_exit", "gesture", "hand_coordinates",
+                 "head_coordinates", "client_exit", "resume", "ping", "pong",
+                 "skeleton")
+
+GESTURE_NAMES = ("none", "circle", "no_circle", "swipe_up", "swipe_down",
+                 "swipe_left", "swipe_right", "on_wave", "on_push",
+                 "stabilized_push", "on_steady", "not_steady")
+
+# SkeletonJointIndex, the order of the joints in a skeleton
+JOINT_NAMES = ("head", "neck", "torso", "left_shoulder", "left_elbow",
+               "left_hand", "right_shoulder", "right_elbow", "right_hand",
+               "left_hip", "left_knee", "left_foot", "right_hip",
+               "right_knee", "right_foot")
+SKELETON_JOINTS = len(JOINT_NAMES)
+
+HEADER = struct.Struct('<HBBIbBHQQQ')
+COORDINATES = struct.Struct('<bbbxffff')
+GESTURE = struct.Struct('<Bxxxfff')
+SESSION = struct.Struct('<BBxx')
+SKELETON = struct.Struct('<HBB')
+JOINT = struct.Struct('<8f')
+
+COMPACT_KEYFRAME = 0xC1
+COMPACT_DELTA = 0xC2
+COMPACT_TIME = 0xC3
+COMPACT_HEADER = struct.Struct('<BBH')
+COMPACT_POINT = struct.Struct('<HHH')
+COMPACT_DELTA_POINT = struct.Struct('<Bbbb')
+COMPACT_TIME_RECORD = struct.Struct('<BxxxQQQ')
+COMPACT_XY_SCALE = 4.0
+COMPACT_Z_SCALE = 1.0
+COMPACT_STREAM_HEAD = 0
+COMPACT_STREAM_LEFT_HAND = 1
+COMPACT_STREAM_RIGHT_HAND = 2
+
+
+class ProtocolError(ValueError):
+    """The data doesn't start with a message of any format."""
+
+
+class Message(object):
+    """A decoded message, the fields of Message in Protocol.h. skeleton is a
+    list of SKELETON_JOINTS (x, y, z, confidence, qx, qy, qz, qw) tuples:
+    positions are projective (pixels, z in mm), confidence 0 if the joint
+    isn't tracked. Times are in microseconds."""
+
+    def __init__(self, type=MSG_NONE):
+        self.type = type
+        self.data_id = 0
+        self.player_id = 0
+        self.device_id = 0
+        self.hand_id = -1
+        self.l_hand = -1
+        self.r_hand = -1
+        self.coordinates = (0.0, 0.0, 0.0)
+        self.c_p1 = 0.0
+        self.gesture = 0
+        self.g_p1 = self.g_p2 = self.g_p3 = 0.0
+        self.in_session = False
+        self.calibrated = False
+        self.sensor_time = 0
+        self.capture_time = 0
+        self.send_time = 0
+        self.joint_mask = 0
+        self.keyframe = False
+        self.skeleton = None
+
+    @property
+    def name(self):
+        if 0 <= self.type < len(MESSAGE_NAMES):
+            return MESSAGE_NAMES[self.type]
+        return "unknown"
+
+    @property
+    def gesture_name(self):
+        if 0 <= self.gesture < len(GESTURE_NAMES):
+            return GESTURE_NAMES[self.gesture]
+        return "unknown"
+
+    def __repr__(self):
+        return "<%s %d player %d device %d>" % (self.name, self.data_id,
+                                                self.player_id, self.device_id)
+
+
+class _Stream(object):
+    """Last point or skeleton received on a stream."""
+
+    def __init__(self):
+        self.point = None  # x, y, z of a compact stream (quantized)
+        self.joints = None  # Skeleton
+        self.data_id = 0
+        self.valid = False
+
+
+class Decoder(object):
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        """Forget the streams, e.g. after connecting again."""
+        self.pending = b''
+        self.last_data_id = 0
+        self.last_time = (0, 0, 0)
+        self.points = {}  # Compact stream byte: _Stream
+        self.skeletons = {}  # (device_id, player_id): _Stream
+
+    def feed(self, data):
+        """Decodes what data completes, returns the list of messages."""
+        buffer = self.pending + data
+        messages = []
+        used = 0
+        while used < len(buffer):
+            n, m = self.decode(buffer, used)
+            if n == 0:
+                break
+            used += n
+            if m is not None:
+                messages.append(m)
+        self.pending = buffer[used:]
+        return messages
+
+    def decode(self, buffer, offset=0):
+        """Decodes one message of buffer at offset. Returns (bytes used,
+        message), (0, None) if it is incomplete and (n, None) for a record
+        that was lost or can't be applied."""
+        if offset >= len(buffer):
+            return 0, None
+        kind = bytearray(buffer[offset:offset + 1])[0]
+        if kind == COMPACT_TIME:
+            # Always followed by the compact record it belongs to
+            size = COMPACT_TIME_RECORD.size
+            if len(buffer) - offset < size:
+                return 0, None
+            before = self.last_time
+            self.last_time = COMPACT_TIME_RECORD.unpack_from(buffer,
+                                                             offset)[1:]
+            n, m = self.decode(buffer, offset + size)
+            if n == 0:
+                self.last_time = before  # Read again with the rest
+                return 0, None
+            return size + n, m
+        if kind == COMPACT_KEYFRAME or kind == COMPACT_DELTA:
+            return self._decode_compact(buffer, offset, kind)
+        if kind == ord('#'):
+            return self._decode_text(buffer, offset)
+        if kind == ord('0'):  # Exit flag of the text format, "0\0"
+            if len(buffer) - offset < 2:
+                return 0, None
+            return 2, Message(MSG_CLIENT_EXIT)
+        return self._decode_binary(buffer, offset)
+
+    def _decode_binary(self, buffer, offset):
+        if len(buffer) - offset < HEADER.size:
+            return 0, None
+        (magic, version, type, data_id, player_id, device_id, payload_len,
+         sensor_time, capture_time, send_time) = HEADER.unpack_from(buffer,
+                                                                    offset)
+        if magic != PROTOCOL_MAGIC or version != PROTOCOL_VERSION:
+            raise ProtocolError("not a message (magic %#x version %d)"
+                                % (magic, version))
+        total = HEADER.size + payload_len
+        if len(buffer) - offset < total:
+            return 0, None
+        m = Message(type)
+        m.data_id = data_id
+        m.player_id = player_id
+        m.device_id = device_id
+        m.sensor_time = sensor_time
+        m.capture_time = capture_time
+        m.send_time = send_time
+        payload = offset + HEADER.size
+        if type in (MSG_HAND_COORDINATES, MSG_HEAD_COORDINATES):
+            if payload_len < COORDINATES.size:
+                raise ProtocolError("short coordinates %d" % data_id)
+            (m.hand_id, m.l_hand, m.r_hand, x, y, z,
+             m.c_p1) = COORDINATES.unpack_from(buffer, payload)
+            m.coordinates = (x, y, z)
+        elif type == MSG_GESTURE:
+            if payload_len < GESTURE.size:
+                raise ProtocolError("short gesture %d" % data_id)
+            (m.gesture, m.g_p1, m.g_p2,
+             m.g_p3) = GESTURE.unpack_from(buffer, payload)
+        elif type == MSG_SKELETON:
+            if payload_len < SKELETON.size:
+                raise ProtocolError("short skeleton %d" % data_id)
+            mask, keyframe, ref = SKELETON.unpack_from(buffer, payload)
+            joints = {}
+            record = payload + SKELETON.size
+            for i in range(SKELETON_JOINTS):
+                if mask & (1 << i) == 0:
+                    continue
+                if record + JOINT.size > offset + total:
+                    raise ProtocolError("short skeleton %d" % data_id)
+                joints[i] = JOINT.unpack_from(buffer, record)
+                record += JOINT.size
+            m.joint_mask = mask & ((1 << SKELETON_JOINTS) - 1)
+            m.keyframe = keyframe != 0
+            self.last_data_id = data_id
+            if not self._apply_skeleton(m, joints, ref):
+                return total, None
+            return total, m
+        elif payload_len >= SESSION.size:
+            in_session, calibrated = SESSION.unpack_from(buffer, payload)
+            m.in_session = in_session != 0
+            m.calibrated = calibrated != 0
+        self.last_data_id = data_id
+        return total, m
+
+    # Fills in the joints the skeleton leaves out with the ones received
+    # before, False if it applies to a skeleton that was lost
+    def _apply_skeleton(self, m, joints, ref):
+        s = self.skeletons.setdefault((m.device_id, m.player_id), _Stream())
+        if m.keyframe:
+            s.joints = [joints.get(i, (0.0,) * 8)
+                        for i in range(SKELETON_JOINTS)]
+            s.valid = True
+        elif not s.valid or ref != s.data_id & 0xFF:
+            s.valid = False  # Lost one, wait for a keyframe
+            return False
+        else:
+            for i, joint in joints.items():
+                s.joints[i] = joint
+        s.data_id = m.data_id
+        m.skeleton = list(s.joints)
+        return True
+
+    def _decode_compact(self, buffer, offset, kind):
+        point = COMPACT_POINT if kind == COMPACT_KEYFRAME \
+            else COMPACT_DELTA_POINT
+        n = COMPACT_HEADER.size + point.size
+        if len(buffer) - offset < n:
+            return 0, None
+        _, stream, low_id = COMPACT_HEADER.unpack_from(buffer, offset)
+        values = point.unpack_from(buffer, offset + COMPACT_HEADER.size)
+        p = self.points.setdefault(stream, _Stream())
+
+        # Rebuild the 32 bit data_id from the closest full one
+        data_id = (self.last_data_id & ~0xFFFF) | low_id
+        if data_id < self.last_data_id - 0x8000:
+            data_id += 0x10000
+        elif data_id > self.last_data_id + 0x8000 and data_id >= 0x10000:
+            data_id -= 0x10000
+
+        if kind == COMPACT_KEYFRAME:
+            p.point = values
+        else:
+            ref, dx, dy, dz = values
+            if not p.valid or ref != p.data_id & 0xFF:
+                p.valid = False  # Lost a sample, wait for a keyframe
+                return n, None
+            x, y, z = p.point
+            p.point = ((x + dx) & 0xFFFF, (y + dy) & 0xFFFF,
+                       (z + dz) & 0xFFFF)
+        p.data_id = data_id
+        p.valid = True
+        self.last_data_id = data_id
+
+        which = stream & 3
+        m = Message(MSG_HEAD_COORDINATES if which == COMPACT_STREAM_HEAD
+                    else MSG_HAND_COORDINATES)
+        m.data_id = data_id
+        m.player_id = (stream >> 2) & 15
+        m.device_id = stream >> 6
+        m.hand_id = 0
+        m.l_hand = 1 if which == COMPACT_STREAM_LEFT_HAND else 0
+        m.r_hand = 1 if which == COMPACT_STREAM_RIGHT_HAND else 0
+        x, y, z = p.point
+        m.coordinates = (x / COMPACT_XY_SCALE, y / COMPACT_XY_SCALE,
+                         z / COMPACT_Z_SCALE)
+        m.sensor_time, m.capture_time, m.send_time = self.last_time
+        return n, m
+
+    # #header|data_id|player_id|hand_id,left,right|x,y,z,c_p1|
+    # gesture,g_p1,g_p2,g_p3|sensor,capture,send[|device_id]#, the fields
+    # after data_id may be left out
+    def _decode_text(self, buffer, offset):
+        end = buffer.find(b'#', offset + 1)
+        if end < 0:
+            return 0, None
+        fields = buffer[offset + 1:end].decode('ascii').split('|')
+        try:
+            m = Message(MESSAGE_NAMES.index(fields[0]))
+        except ValueError:
+            raise ProtocolError("unknown record %r" % fields[0])
+        try:
+            if len(fields) > 1:
+                m.data_id = int(fields[1])
+            if len(fields) > 2:
+                m.player_id = int(fields[2])
+            if len(fields) > 3:
+                m.hand_id, m.l_hand, m.r_hand = map(int, fields[3].split(','))
+            if len(fields) > 4:
+                values = list(map(float, fields[4].split(',')))
+                m.coordinates = tuple(values[:3])
+                m.c_p1 = values[3]
+            if len(fields) > 5:
+                gesture = fields[5].split(',')
+                if gesture[0] in GESTURE_NAMES:
+                    m.gesture = GESTURE_NAMES.index(gesture[0])
+                m.g_p1, m.g_p2, m.g_p3 = map(float, gesture[1:4])
+            if len(fields) > 6:
+                (m.sensor_time, m.capture_time,
+                 m.send_time) = map(int, fields[6].split(','))
+            if len(fields) > 7:
+                m.device_id = int(fields[7])
+        except (ValueError, IndexError):
+            raise ProtocolError("bad record %r" % buffer[offset:end + 1])
+        self.last_data_id = m.data_id
+        return end + 1 - offset, m